@@ -40,6 +40,7 @@ libarchive_src_files := libarchive/archive_acl.c \
 						libarchive/archive_getdate.c \
 						libarchive/archive_hmac.c \
 						libarchive/archive_match.c \
+						libarchive/archive_name_cache.c \
 						libarchive/archive_options.c \
 						libarchive/archive_pack_dev.c \
 						libarchive/archive_pathmatch.c \
@@ -91,8 +92,10 @@ libarchive_src_files := libarchive/archive_acl.c \
 						libarchive/archive_read_support_format_warc.c \
 						libarchive/archive_read_support_format_xar.c \
 						libarchive/archive_read_support_format_zip.c \
+						libarchive/archive_solid_cache.c \
 						libarchive/archive_string.c \
 						libarchive/archive_string_sprintf.c \
+						libarchive/archive_tar_index.c \
 						libarchive/archive_util.c \
 						libarchive/archive_version_details.c \
 						libarchive/archive_virtual.c \
@@ -137,6 +140,7 @@ libarchive_src_files := libarchive/archive_acl.c \
 						libarchive/archive_write_set_format_zip.c \
 						libarchive/archive_write_set_options.c \
 						libarchive/archive_write_set_passphrase.c \
+						libarchive/archive_zipcrypto.c \
 						libarchive/filter_fork_posix.c \
 						libarchive/xxhash.c
 
@@ -46,15 +46,9 @@
 #ifdef HAVE_FCNTL_H
 #include <fcntl.h>
 #endif
-#ifdef HAVE_GRP_H
-#include <grp.h>
-#endif
 #ifdef HAVE_LOCALE_H
 #include <locale.h>
 #endif
-#ifdef HAVE_PWD_H
-#include <pwd.h>
-#endif
 #ifdef HAVE_SIGNAL_H
 #include <signal.h>
 #endif
@@ -83,37 +77,19 @@
 #include "line_reader.h"
 #include "passphrase.h"
 
-/* Fixed size of uname/gname caches. */
-#define	name_cache_size 101
-
 #ifndef O_BINARY
 #define O_BINARY 0
 #endif
 
-struct name_cache {
-	int	probes;
-	int	hits;
-	size_t	size;
-	struct {
-		id_t id;
-		char *name;
-	} cache[name_cache_size];
-};
-
 static int	extract_data(struct archive *, struct archive *);
 const char *	cpio_i64toa(int64_t);
 static const char *cpio_rename(const char *name);
 static int	entry_to_archive(struct cpio *, struct archive_entry *);
 static int	file_to_archive(struct cpio *, const char *);
-static void	free_cache(struct name_cache *cache);
 static void	list_item_verbose(struct cpio *, struct archive_entry *);
 static __LA_NORETURN void	long_help(void);
 static const char *lookup_gname(struct cpio *, gid_t gid);
-static int	lookup_gname_helper(struct cpio *,
-		    const char **name, id_t gid);
 static const char *lookup_uname(struct cpio *, uid_t uid);
-static int	lookup_uname_helper(struct cpio *,
-		    const char **name, id_t uid);
 static __LA_NORETURN void	mode_in(struct cpio *);
 static __LA_NORETURN void	mode_list(struct cpio *);
 static void	mode_out(struct cpio *);
@@ -439,8 +415,7 @@ main(int argc, char *argv[])
 	}
 
 	archive_match_free(cpio->matching);
-	free_cache(cpio->gname_cache);
-	free_cache(cpio->uname_cache);
+	archive_read_free(cpio->name_lookup);
 	archive_read_close(cpio->archive_read_disk);
 	archive_read_free(cpio->archive_read_disk);
 	free(cpio->destdir);
@@ -1170,10 +1145,19 @@ list_item_verbose(struct cpio *cpio, struct archive_entry *entry)
 		uname = archive_entry_uname(entry);
 		if (uname == NULL)
 			uname = lookup_uname(cpio, (uid_t)archive_entry_uid(entry));
+		/* If lookup failed, format it as a number. */
+		if (uname == NULL) {
+			strcpy(uids, cpio_i64toa(archive_entry_uid(entry)));
+			uname = uids;
+		}
 		/* Use gname if it's present, else lookup name from gid. */
 		gname = archive_entry_gname(entry);
 		if (gname == NULL)
 			gname = lookup_gname(cpio, (uid_t)archive_entry_gid(entry));
+		if (gname == NULL) {
+			strcpy(gids, cpio_i64toa(archive_entry_gid(entry)));
+			gname = gids;
+		}
 	}
 
 	/* Print device number or file size. */
@@ -1342,123 +1326,35 @@ cpio_rename(const char *name)
 	return (ret);
 }
 
-static void
-free_cache(struct name_cache *cache)
-{
-	size_t i;
-
-	if (cache != NULL) {
-		for (i = 0; i < cache->size; i++)
-			free(cache->cache[i].name);
-		free(cache);
-	}
-}
-
 /*
- * Lookup uname/gname from uid/gid, return NULL if no match.
+ * Lookup uname/gname from uid/gid, return NULL if no match.  The
+ * lookups go through a private archive_read_disk object so that they
+ * share libarchive's process-wide name cache.
  */
-static const char *
-lookup_name(struct cpio *cpio, struct name_cache **name_cache_variable,
-    int (*lookup_fn)(struct cpio *, const char **, id_t), id_t id)
+static struct archive *
+name_lookup_handle(struct cpio *cpio)
 {
-	char asnum[16];
-	struct name_cache	*cache;
-	const char *name;
-	int slot;
-
-
-	if (*name_cache_variable == NULL) {
-		*name_cache_variable = calloc(1, sizeof(struct name_cache));
-		if (*name_cache_variable == NULL)
+	if (cpio->name_lookup == NULL) {
+		cpio->name_lookup = archive_read_disk_new();
+		if (cpio->name_lookup == NULL)
 			lafe_errc(1, ENOMEM, "No more memory");
-		(*name_cache_variable)->size = name_cache_size;
-	}
-
-	cache = *name_cache_variable;
-	cache->probes++;
-
-	slot = id % cache->size;
-	if (cache->cache[slot].name != NULL) {
-		if (cache->cache[slot].id == id) {
-			cache->hits++;
-			return (cache->cache[slot].name);
-		}
-		free(cache->cache[slot].name);
-		cache->cache[slot].name = NULL;
-	}
-
-	if (lookup_fn(cpio, &name, id)) {
-		/* If lookup failed, format it as a number. */
-		snprintf(asnum, sizeof(asnum), "%u", (unsigned)id);
-		name = asnum;
+		archive_read_disk_set_standard_lookup(cpio->name_lookup);
 	}
-
-	cache->cache[slot].name = strdup(name);
-	if (cache->cache[slot].name != NULL) {
-		cache->cache[slot].id = id;
-		return (cache->cache[slot].name);
-	}
-
-	/*
-	 * Conveniently, NULL marks an empty slot, so
-	 * if the strdup() fails, we've just failed to
-	 * cache it.  No recovery necessary.
-	 */
-	return (NULL);
+	return (cpio->name_lookup);
 }
 
 static const char *
 lookup_uname(struct cpio *cpio, uid_t uid)
 {
-	return (lookup_name(cpio, &cpio->uname_cache,
-		    &lookup_uname_helper, (id_t)uid));
-}
-
-static int
-lookup_uname_helper(struct cpio *cpio, const char **name, id_t id)
-{
-	struct passwd	*pwent;
-
-	(void)cpio; /* UNUSED */
-
-	errno = 0;
-	pwent = getpwuid((uid_t)id);
-	if (pwent == NULL) {
-		if (errno && errno != ENOENT)
-			lafe_warnc(errno, "getpwuid(%s) failed",
-			    cpio_i64toa((int64_t)id));
-		return 1;
-	}
-
-	*name = pwent->pw_name;
-	return 0;
+	return (archive_read_disk_uname(name_lookup_handle(cpio),
+	    (int64_t)uid));
 }
 
 static const char *
 lookup_gname(struct cpio *cpio, gid_t gid)
 {
-	return (lookup_name(cpio, &cpio->gname_cache,
-		    &lookup_gname_helper, (id_t)gid));
-}
-
-static int
-lookup_gname_helper(struct cpio *cpio, const char **name, id_t id)
-{
-	struct group	*grent;
-
-	(void)cpio; /* UNUSED */
-
-	errno = 0;
-	grent = getgrgid((gid_t)id);
-	if (grent == NULL) {
-		if (errno && errno != ENOENT)
-			lafe_warnc(errno, "getgrgid(%s) failed",
-			    cpio_i64toa((int64_t)id));
-		return 1;
-	}
-
-	*name = grent->gr_name;
-	return 0;
+	return (archive_read_disk_gname(name_lookup_handle(cpio),
+	    (int64_t)gid));
 }
 
 /*
@@ -84,8 +84,8 @@ struct cpio {
 	int		  return_value; /* Value returned by main() */
 	struct archive_entry_linkresolver *linkresolver;
 
-	struct name_cache *uname_cache;
-	struct name_cache *gname_cache;
+	/* archive_read_disk used only for uname/gname lookups. */
+	struct archive	 *name_lookup;
 
 	/* Work data. */
 	struct archive   *matching;
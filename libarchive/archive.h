@@ -593,6 +593,15 @@ __LA_DECL int	archive_read_has_encrypted_entries(struct archive *);
  */
 __LA_DECL int		 archive_read_format_capabilities(struct archive *);
 
+/*
+ * Seek a tar archive opened with the "tar:index" read option straight to
+ * the named member (or back to the first member if NULL) so that the
+ * next archive_read_next_header() returns it.  Returns ARCHIVE_WARN if
+ * the member is not in the index.
+ */
+__LA_DECL int		 archive_read_tar_seek_entry(struct archive *,
+				    const char *);
+
 /* Read data from the body of an entry.  Similar to read(2). */
 __LA_DECL la_ssize_t		 archive_read_data(struct archive *,
 				    void *, size_t);
@@ -644,6 +653,13 @@ __LA_DECL int archive_read_add_passphrase(struct archive *, const char *);
 __LA_DECL int archive_read_set_passphrase_callback(struct archive *,
 			    void *client_data, archive_passphrase_callback *);
 
+/*
+ * The process-wide cache of decoded solid blocks that read handles
+ * share through the 7zip and rar5 "solid-cache" format option.
+ */
+__LA_DECL int archive_solid_cache_set_limit(la_int64_t);
+__LA_DECL void archive_solid_cache_stats(la_int64_t *limit,
+			    la_int64_t *used, la_int64_t *hits);
 
 /*-
  * Convenience function to recreate the current entry (whose header
@@ -703,6 +719,9 @@ __LA_DECL int archive_read_set_passphrase_callback(struct archive *,
 #define	ARCHIVE_EXTRACT_CLEAR_NOCHANGE_FFLAGS	(0x20000)
 /* Default: Do not extract atomically (using rename) */
 #define	ARCHIVE_EXTRACT_SAFE_WRITES		(0x40000)
+/* Default: Do not sync files to stable storage before renaming them */
+/* This implies ARCHIVE_EXTRACT_SAFE_WRITES for regular files. */
+#define	ARCHIVE_EXTRACT_DURABLE			(0x80000)
 
 __LA_DECL int archive_read_extract(struct archive *, struct archive_entry *,
 		     int flags);
@@ -925,6 +944,10 @@ __LA_DECL int archive_write_disk_set_skip_file(struct archive *,
  * This accepts a bitmask of ARCHIVE_EXTRACT_XXX flags defined above. */
 __LA_DECL int		 archive_write_disk_set_options(struct archive *,
 		     int flags);
+/* With ARCHIVE_EXTRACT_DURABLE, sync and rename files in batches of up
+ * to `files' files or `bytes' bytes of file data. */
+__LA_DECL int archive_write_disk_set_durable_batch(struct archive *,
+    int files, la_int64_t bytes);
 /*
  * The lookup functions are given uname/uid (or gname/gid) pairs and
  * return a uid (gid) suitable for this system.  These are used for
@@ -983,6 +1006,9 @@ __LA_DECL const char *archive_read_disk_uname(struct archive *, la_int64_t);
 /* "Standard" implementation uses getpwuid_r, getgrgid_r and caches the
  * results for performance. */
 __LA_DECL int	archive_read_disk_set_standard_lookup(struct archive *);
+/* Number of entries and lifetime in seconds (0 = forever) of the
+ * process-wide cache shared by both sets of standard lookups. */
+__LA_DECL int	archive_name_cache_set_limits(size_t, int);
 /* You can install your own lookups if you like. */
 __LA_DECL int	archive_read_disk_set_gname_lookup(struct archive *,
     void * /* private_data */,
@@ -1030,6 +1056,8 @@ __LA_DECL int  archive_read_disk_set_atime_restored(struct archive *);
 #define	ARCHIVE_READDISK_NO_FFLAGS		(0x0040)
 /* Default: Sparse file information is read from disk. */
 #define	ARCHIVE_READDISK_NO_SPARSE		(0x0080)
+/* Default: Flush dirty data before mapping a sparse file with FIEMAP. */
+#define	ARCHIVE_READDISK_NO_SPARSE_SYNC		(0x0100)
 
 __LA_DECL int  archive_read_disk_set_behavior(struct archive *,
 		    int flags);
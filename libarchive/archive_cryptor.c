@@ -169,14 +169,14 @@ aes_ctr_init(archive_crypto_ctx *ctx, const uint8_t *key, size_t key_len)
 	ctx->key_len = key_len;
 	memcpy(ctx->key, key, key_len);
 	memset(ctx->nonce, 0, sizeof(ctx->nonce));
-	ctx->encr_pos = AES_BLOCK_SIZE;
+	ctx->encr_pos = ctx->encr_len = 0;
 	r = CCCryptorCreateWithMode(kCCEncrypt, kCCModeECB, kCCAlgorithmAES,
 	    ccNoPadding, NULL, key, key_len, NULL, 0, 0, 0, &ctx->ctx);
 	return (r == kCCSuccess)? 0: -1;
 }
 
 static int
-aes_ctr_encrypt_counter(archive_crypto_ctx *ctx)
+aes_ctr_encrypt_counter(archive_crypto_ctx *ctx, size_t len)
 {
 	CCCryptorRef ref = ctx->ctx;
 	CCCryptorStatus r;
@@ -184,8 +184,8 @@ aes_ctr_encrypt_counter(archive_crypto_ctx *ctx)
 	r = CCCryptorReset(ref, NULL);
 	if (r != kCCSuccess && r != kCCUnimplemented)
 		return -1;
-	r = CCCryptorUpdate(ref, ctx->nonce, AES_BLOCK_SIZE, ctx->encr_buf,
-	    AES_BLOCK_SIZE, NULL);
+	r = CCCryptorUpdate(ref, ctx->encr_buf, len, ctx->encr_buf,
+	    len, NULL);
 	return (r == kCCSuccess)? 0: -1;
 }
 
@@ -265,19 +265,19 @@ aes_ctr_init(archive_crypto_ctx *ctx, const uint8_t *key, size_t key_len)
 	ctx->hKey = hKey;
 	ctx->keyObj = keyObj;
 	ctx->keyObj_len = keyObj_len;
-	ctx->encr_pos = AES_BLOCK_SIZE;
+	ctx->encr_pos = ctx->encr_len = 0;
 
 	return 0;
 }
 
 static int
-aes_ctr_encrypt_counter(archive_crypto_ctx *ctx)
+aes_ctr_encrypt_counter(archive_crypto_ctx *ctx, size_t len)
 {
 	NTSTATUS status;
 	ULONG result;
 
-	status = BCryptEncrypt(ctx->hKey, (PUCHAR)ctx->nonce, AES_BLOCK_SIZE,
-		NULL, NULL, 0, (PUCHAR)ctx->encr_buf, AES_BLOCK_SIZE,
+	status = BCryptEncrypt(ctx->hKey, (PUCHAR)ctx->encr_buf, (ULONG)len,
+		NULL, NULL, 0, (PUCHAR)ctx->encr_buf, (ULONG)len,
 		&result, 0);
 	return BCRYPT_SUCCESS(status) ? 0 : -1;
 }
@@ -307,19 +307,24 @@ aes_ctr_init(archive_crypto_ctx *ctx, const uint8_t *key, size_t key_len)
 	ctx->key_len = key_len;
 	memcpy(ctx->key, key, key_len);
 	memset(ctx->nonce, 0, sizeof(ctx->nonce));
-	ctx->encr_pos = AES_BLOCK_SIZE;
+	ctx->encr_pos = ctx->encr_len = 0;
+	if (mbedtls_aes_setkey_enc(&ctx->ctx, ctx->key,
+	    ctx->key_len * 8) != 0)
+		return (-1);
 	return 0;
 }
 
 static int
-aes_ctr_encrypt_counter(archive_crypto_ctx *ctx)
+aes_ctr_encrypt_counter(archive_crypto_ctx *ctx, size_t len)
 {
-	if (mbedtls_aes_setkey_enc(&ctx->ctx, ctx->key,
-	    ctx->key_len * 8) != 0)
-		return (-1);
-	if (mbedtls_aes_crypt_ecb(&ctx->ctx, MBEDTLS_AES_ENCRYPT, ctx->nonce,
-	    ctx->encr_buf) != 0)
-		return (-1);
+	uint8_t *p;
+
+	for (p = ctx->encr_buf; len > 0; p += AES_BLOCK_SIZE,
+	    len -= AES_BLOCK_SIZE) {
+		if (mbedtls_aes_crypt_ecb(&ctx->ctx, MBEDTLS_AES_ENCRYPT,
+		    p, p) != 0)
+			return (-1);
+	}
 	return 0;
 }
 
@@ -339,33 +344,47 @@ aes_ctr_init(archive_crypto_ctx *ctx, const uint8_t *key, size_t key_len)
 	ctx->key_len = key_len;
 	memcpy(ctx->key, key, key_len);
 	memset(ctx->nonce, 0, sizeof(ctx->nonce));
-	ctx->encr_pos = AES_BLOCK_SIZE;
+	ctx->encr_pos = ctx->encr_len = 0;
 	memset(&ctx->ctx, 0, sizeof(ctx->ctx));
+#if NETTLE_VERSION_MAJOR < 3
+	aes_set_encrypt_key(&ctx->ctx, ctx->key_len, ctx->key);
+#else
+	switch(ctx->key_len) {
+	case AES128_KEY_SIZE:
+		aes128_set_encrypt_key(&ctx->ctx.c128, ctx->key);
+		break;
+	case AES192_KEY_SIZE:
+		aes192_set_encrypt_key(&ctx->ctx.c192, ctx->key);
+		break;
+	case AES256_KEY_SIZE:
+		aes256_set_encrypt_key(&ctx->ctx.c256, ctx->key);
+		break;
+	default:
+		return -1;
+		break;
+	}
+#endif
 	return 0;
 }
 
 static int
-aes_ctr_encrypt_counter(archive_crypto_ctx *ctx)
+aes_ctr_encrypt_counter(archive_crypto_ctx *ctx, size_t len)
 {
 #if NETTLE_VERSION_MAJOR < 3
-	aes_set_encrypt_key(&ctx->ctx, ctx->key_len, ctx->key);
-	aes_encrypt(&ctx->ctx, AES_BLOCK_SIZE, ctx->encr_buf, ctx->nonce);
+	aes_encrypt(&ctx->ctx, len, ctx->encr_buf, ctx->encr_buf);
 #else
 	switch(ctx->key_len) {
 	case AES128_KEY_SIZE:
-		aes128_set_encrypt_key(&ctx->ctx.c128, ctx->key);
-		aes128_encrypt(&ctx->ctx.c128, AES_BLOCK_SIZE, ctx->encr_buf,
-		    ctx->nonce);
+		aes128_encrypt(&ctx->ctx.c128, len, ctx->encr_buf,
+		    ctx->encr_buf);
 		break;
 	case AES192_KEY_SIZE:
-		aes192_set_encrypt_key(&ctx->ctx.c192, ctx->key);
-		aes192_encrypt(&ctx->ctx.c192, AES_BLOCK_SIZE, ctx->encr_buf,
-		    ctx->nonce);
+		aes192_encrypt(&ctx->ctx.c192, len, ctx->encr_buf,
+		    ctx->encr_buf);
 		break;
 	case AES256_KEY_SIZE:
-		aes256_set_encrypt_key(&ctx->ctx.c256, ctx->key);
-		aes256_encrypt(&ctx->ctx.c256, AES_BLOCK_SIZE, ctx->encr_buf,
-		    ctx->nonce);
+		aes256_encrypt(&ctx->ctx.c256, len, ctx->encr_buf,
+		    ctx->encr_buf);
 		break;
 	default:
 		return -1;
@@ -400,22 +419,24 @@ aes_ctr_init(archive_crypto_ctx *ctx, const uint8_t *key, size_t key_len)
 	ctx->key_len = key_len;
 	memcpy(ctx->key, key, key_len);
 	memset(ctx->nonce, 0, sizeof(ctx->nonce));
-	ctx->encr_pos = AES_BLOCK_SIZE;
+	ctx->encr_pos = ctx->encr_len = 0;
+	/* The key schedule is set up once; ECB keeps no chaining state. */
+	if (EVP_EncryptInit_ex(ctx->ctx, ctx->type, NULL, ctx->key,
+	    NULL) == 0)
+		return -1;
+	EVP_CIPHER_CTX_set_padding(ctx->ctx, 0);
 	return 0;
 }
 
 static int
-aes_ctr_encrypt_counter(archive_crypto_ctx *ctx)
+aes_ctr_encrypt_counter(archive_crypto_ctx *ctx, size_t len)
 {
 	int outl = 0;
 	int r;
 
-	r = EVP_EncryptInit_ex(ctx->ctx, ctx->type, NULL, ctx->key, NULL);
-	if (r == 0)
-		return -1;
-	r = EVP_EncryptUpdate(ctx->ctx, ctx->encr_buf, &outl, ctx->nonce,
-	    AES_BLOCK_SIZE);
-	if (r == 0 || outl != AES_BLOCK_SIZE)
+	r = EVP_EncryptUpdate(ctx->ctx, ctx->encr_buf, &outl, ctx->encr_buf,
+	    (int)len);
+	if (r == 0 || outl != (int)len)
 		return -1;
 	return 0;
 }
@@ -443,9 +464,10 @@ aes_ctr_init(archive_crypto_ctx *ctx, const uint8_t *key, size_t key_len)
 }
 
 static int
-aes_ctr_encrypt_counter(archive_crypto_ctx *ctx)
+aes_ctr_encrypt_counter(archive_crypto_ctx *ctx, size_t len)
 {
 	(void)ctx; /* UNUSED */
+	(void)len; /* UNUSED */
 	return -1;
 }
 
@@ -468,7 +490,7 @@ aes_ctr_update(archive_crypto_ctx *ctx, const uint8_t * const in,
 	(void)in_len; /* UNUSED */
 	(void)out; /* UNUSED */
 	(void)out_len; /* UNUSED */
-	aes_ctr_encrypt_counter(ctx); /* UNUSED */ /* Fix unused function warning */
+	aes_ctr_encrypt_counter(ctx, 0); /* UNUSED */ /* Fix unused function warning */
 	return -1;
 }
 
@@ -485,36 +507,68 @@ aes_ctr_increase_counter(archive_crypto_ctx *ctx)
 	}
 }
 
+/*
+ * Refill the keystream buffer with `blocks' consecutive counter values
+ * and encrypt them with a single call into the backend.
+ */
+static int
+aes_ctr_fill_keystream(archive_crypto_ctx *ctx, size_t blocks)
+{
+	uint8_t *p = ctx->encr_buf;
+	size_t i;
+
+	for (i = 0; i < blocks; i++, p += AES_BLOCK_SIZE) {
+		aes_ctr_increase_counter(ctx);
+		memcpy(p, ctx->nonce, AES_BLOCK_SIZE);
+	}
+	if (aes_ctr_encrypt_counter(ctx, blocks * AES_BLOCK_SIZE) != 0)
+		return -1;
+	ctx->encr_pos = 0;
+	ctx->encr_len = (unsigned)(blocks * AES_BLOCK_SIZE);
+	return 0;
+}
+
+static void
+aes_ctr_xor(uint8_t *out, const uint8_t *in, const uint8_t *ks, size_t n)
+{
+	uint64_t d[2], k[2];
+
+	for (; n >= sizeof(d); n -= sizeof(d)) {
+		memcpy(d, in, sizeof(d));
+		memcpy(k, ks, sizeof(k));
+		d[0] ^= k[0];
+		d[1] ^= k[1];
+		memcpy(out, d, sizeof(d));
+		in += sizeof(d);
+		ks += sizeof(k);
+		out += sizeof(d);
+	}
+	while (n-- > 0)
+		*out++ = *in++ ^ *ks++;
+}
+
 static int
 aes_ctr_update(archive_crypto_ctx *ctx, const uint8_t * const in,
     size_t in_len, uint8_t * const out, size_t *out_len)
 {
-	uint8_t *const ebuf = ctx->encr_buf;
-	unsigned pos = ctx->encr_pos;
-	unsigned max = (unsigned)((in_len < *out_len)? in_len: *out_len);
-	unsigned i;
-
-	for (i = 0; i < max; ) {
-		if (pos == AES_BLOCK_SIZE) {
-			aes_ctr_increase_counter(ctx);
-			if (aes_ctr_encrypt_counter(ctx) != 0)
+	size_t max = (in_len < *out_len)? in_len: *out_len;
+	size_t i, n, blocks;
+
+	for (i = 0; i < max; i += n) {
+		if (ctx->encr_pos == ctx->encr_len) {
+			blocks = (max - i + AES_BLOCK_SIZE - 1) /
+			    AES_BLOCK_SIZE;
+			if (blocks > AES_CTR_BLOCKS)
+				blocks = AES_CTR_BLOCKS;
+			if (aes_ctr_fill_keystream(ctx, blocks) != 0)
 				return -1;
-			while (max -i >= AES_BLOCK_SIZE) {
-				for (pos = 0; pos < AES_BLOCK_SIZE; pos++)
-					out[i+pos] = in[i+pos] ^ ebuf[pos];
-				i += AES_BLOCK_SIZE;
-				aes_ctr_increase_counter(ctx);
-				if (aes_ctr_encrypt_counter(ctx) != 0)
-					return -1;
-			}
-			pos = 0;
-			if (i >= max)
-				break;
 		}
-		out[i] = in[i] ^ ebuf[pos++];
-		i++;
+		n = ctx->encr_len - ctx->encr_pos;
+		if (n > max - i)
+			n = max - i;
+		aes_ctr_xor(out + i, in + i, ctx->encr_buf + ctx->encr_pos, n);
+		ctx->encr_pos += (unsigned)n;
 	}
-	ctx->encr_pos = pos;
 	*out_len = i;
 
 	return 0;
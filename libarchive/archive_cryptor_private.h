@@ -40,6 +40,12 @@
  */
 int __libarchive_cryptor_build_hack(void);
 
+/*
+ * Number of counter blocks turned into keystream per call into the AES
+ * backend; batching lets hardware AES keep several blocks in flight.
+ */
+#define AES_CTR_BLOCKS	32
+
 #ifdef __APPLE__
 # include <AvailabilityMacros.h>
 # if MAC_OS_X_VERSION_MAX_ALLOWED >= 1080
@@ -58,8 +64,9 @@ typedef struct {
 	uint8_t		key[AES_MAX_KEY_SIZE];
 	unsigned	key_len;
 	uint8_t		nonce[AES_BLOCK_SIZE];
-	uint8_t		encr_buf[AES_BLOCK_SIZE];
+	uint8_t		encr_buf[AES_BLOCK_SIZE * AES_CTR_BLOCKS];
 	unsigned	encr_pos;
+	unsigned	encr_len;
 } archive_crypto_ctx;
 
 #elif defined(_WIN32) && !defined(__CYGWIN__) && defined(HAVE_BCRYPT_H)
@@ -78,8 +85,9 @@ typedef struct {
 	PBYTE		keyObj;
 	DWORD		keyObj_len;
 	uint8_t		nonce[AES_BLOCK_SIZE];
-	uint8_t		encr_buf[AES_BLOCK_SIZE];
+	uint8_t		encr_buf[AES_BLOCK_SIZE * AES_CTR_BLOCKS];
 	unsigned	encr_pos;
+	unsigned	encr_len;
 } archive_crypto_ctx;
 
 #elif defined(HAVE_LIBMBEDCRYPTO) && defined(HAVE_MBEDTLS_AES_H)
@@ -95,8 +103,9 @@ typedef struct {
 	uint8_t		key[AES_MAX_KEY_SIZE];
 	unsigned	key_len;
 	uint8_t		nonce[AES_BLOCK_SIZE];
-	uint8_t		encr_buf[AES_BLOCK_SIZE];
+	uint8_t		encr_buf[AES_BLOCK_SIZE * AES_CTR_BLOCKS];
 	unsigned	encr_pos;
+	unsigned	encr_len;
 } archive_crypto_ctx;
 
 #elif defined(HAVE_LIBNETTLE) && defined(HAVE_NETTLE_AES_H)
@@ -119,8 +128,9 @@ typedef struct {
 	uint8_t		key[AES_MAX_KEY_SIZE];
 	unsigned	key_len;
 	uint8_t		nonce[AES_BLOCK_SIZE];
-	uint8_t		encr_buf[AES_BLOCK_SIZE];
+	uint8_t		encr_buf[AES_BLOCK_SIZE * AES_CTR_BLOCKS];
 	unsigned	encr_pos;
+	unsigned	encr_len;
 } archive_crypto_ctx;
 
 #elif defined(HAVE_LIBCRYPTO)
@@ -134,8 +144,9 @@ typedef struct {
 	uint8_t		key[AES_MAX_KEY_SIZE];
 	unsigned	key_len;
 	uint8_t		nonce[AES_BLOCK_SIZE];
-	uint8_t		encr_buf[AES_BLOCK_SIZE];
+	uint8_t		encr_buf[AES_BLOCK_SIZE * AES_CTR_BLOCKS];
 	unsigned	encr_pos;
+	unsigned	encr_len;
 } archive_crypto_ctx;
 
 #else
@@ -150,25 +150,59 @@ static size_t wcslen(const wchar_t *s)
  *
  ****************************************************************************/
 
+/*
+ * Readers clear the same entry for every header, so the string buffers,
+ * the stat buffer and the xattr/sparse list nodes are kept for reuse
+ * instead of being handed back to the heap; archive_entry_free() is
+ * what releases them.
+ */
 struct archive_entry *
 archive_entry_clear(struct archive_entry *entry)
 {
+	struct archive_mstring fflags_text, gname, hardlink, pathname;
+	struct archive_mstring sourcepath, symlink, uname;
+	struct ae_xattr *xattr_free;
+	struct ae_sparse *sparse_free;
+	void *st;
+
 	if (entry == NULL)
 		return (NULL);
-	archive_mstring_clean(&entry->ae_fflags_text);
-	archive_mstring_clean(&entry->ae_gname);
-	archive_mstring_clean(&entry->ae_hardlink);
-	archive_mstring_clean(&entry->ae_pathname);
-	archive_mstring_clean(&entry->ae_sourcepath);
-	archive_mstring_clean(&entry->ae_symlink);
-	archive_mstring_clean(&entry->ae_uname);
 	archive_entry_copy_mac_metadata(entry, NULL, 0);
 	archive_acl_clear(&entry->acl);
 	archive_entry_xattr_clear(entry);
 	archive_entry_sparse_clear(entry);
-	free(entry->stat);
-	entry->ae_symlink_type = AE_SYMLINK_TYPE_UNDEFINED;
+
+	archive_mstring_empty(&entry->ae_fflags_text);
+	archive_mstring_empty(&entry->ae_gname);
+	archive_mstring_empty(&entry->ae_hardlink);
+	archive_mstring_empty(&entry->ae_pathname);
+	archive_mstring_empty(&entry->ae_sourcepath);
+	archive_mstring_empty(&entry->ae_symlink);
+	archive_mstring_empty(&entry->ae_uname);
+	fflags_text = entry->ae_fflags_text;
+	gname = entry->ae_gname;
+	hardlink = entry->ae_hardlink;
+	pathname = entry->ae_pathname;
+	sourcepath = entry->ae_sourcepath;
+	symlink = entry->ae_symlink;
+	uname = entry->ae_uname;
+	xattr_free = entry->xattr_free;
+	sparse_free = entry->sparse_free;
+	st = entry->stat;
+
 	memset(entry, 0, sizeof(*entry));
+
+	entry->ae_fflags_text = fflags_text;
+	entry->ae_gname = gname;
+	entry->ae_hardlink = hardlink;
+	entry->ae_pathname = pathname;
+	entry->ae_sourcepath = sourcepath;
+	entry->ae_symlink = symlink;
+	entry->ae_uname = uname;
+	entry->xattr_free = xattr_free;
+	entry->sparse_free = sparse_free;
+	entry->stat = st;
+	entry->ae_symlink_type = AE_SYMLINK_TYPE_UNDEFINED;
 	return entry;
 }
 
@@ -250,7 +284,30 @@ archive_entry_clone(struct archive_entry *entry)
 void
 archive_entry_free(struct archive_entry *entry)
 {
+	struct ae_xattr *xp;
+	struct ae_sparse *sp;
+
+	if (entry == NULL)
+		return;
 	archive_entry_clear(entry);
+	archive_mstring_clean(&entry->ae_fflags_text);
+	archive_mstring_clean(&entry->ae_gname);
+	archive_mstring_clean(&entry->ae_hardlink);
+	archive_mstring_clean(&entry->ae_pathname);
+	archive_mstring_clean(&entry->ae_sourcepath);
+	archive_mstring_clean(&entry->ae_symlink);
+	archive_mstring_clean(&entry->ae_uname);
+	while ((xp = entry->xattr_free) != NULL) {
+		entry->xattr_free = xp->next;
+		free(xp->name);
+		free(xp->value);
+		free(xp);
+	}
+	while ((sp = entry->sparse_free) != NULL) {
+		entry->sparse_free = sp->next;
+		free(sp);
+	}
+	free(entry->stat);
 	free(entry);
 }
 
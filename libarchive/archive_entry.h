@@ -657,6 +657,9 @@ __LA_DECL int	archive_entry_sparse_next(struct archive_entry *,
  * nlinks value.  The hardlink cache uses this to track when all links
  * have been found.  If the nlinks value is zero, it will keep every
  * name in the cache indefinitely, which can use a lot of memory.
+ * Once the cache exceeds its memory limit (64 MiB by default, see
+ * archive_entry_linkresolver_set_memory_limit()), further names are
+ * kept in a temporary file instead.
  *
  * Note that archive_entry_size() is reset to zero if the file
  * body should not be written to the archive.  Pay attention!
@@ -706,6 +709,10 @@ struct archive_entry_linkresolver;
 __LA_DECL struct archive_entry_linkresolver *archive_entry_linkresolver_new(void);
 __LA_DECL void archive_entry_linkresolver_set_strategy(
 	struct archive_entry_linkresolver *, int /* format_code */);
+/* Bytes of memory the cache may use before names are moved to a
+ * temporary file; zero means no limit. */
+__LA_DECL void archive_entry_linkresolver_set_memory_limit(
+	struct archive_entry_linkresolver *, size_t);
 __LA_DECL void archive_entry_linkresolver_free(struct archive_entry_linkresolver *);
 __LA_DECL void archive_entry_linkify(struct archive_entry_linkresolver *,
     struct archive_entry **, struct archive_entry **);
@@ -31,6 +31,9 @@
 #ifdef HAVE_ERRNO_H
 #include <errno.h>
 #endif
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
 #include <stdio.h>
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
@@ -38,9 +41,15 @@
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #include "archive.h"
 #include "archive_entry.h"
+#include "archive_entry_private.h"
+#include "archive_private.h"
+#include "archive_string.h"
 
 /*
  * This is mostly a pretty straightforward hash table implementation.
@@ -55,6 +64,13 @@
  *   new cpio - New cpio only stores body with last link, match-ups
  *       are implicit.  This is actually quite tricky; see the notes
  *       below.
+ *
+ * The table uses open addressing with linear probing over an array of
+ * small fixed-size records; a pending link costs one record plus its
+ * pathname, and a clone of the first link while memory is plentiful.
+ * Once the table and what it holds exceed the memory limit, further
+ * pathnames and first links are appended to an anonymous temporary
+ * file and read back when they are needed.
  */
 
 /* Users pass us a format code, we translate that into a strategy here. */
@@ -65,28 +81,56 @@
 
 /* Initial size of link cache. */
 #define	links_cache_initial_size 1024
+/* Default memory limit before pathnames are spilled to disk. */
+#define	links_cache_memory_limit (64 * 1024 * 1024)
+
+/* Flags kept in the high bits of links_entry.mode. */
+#define	LINKS_ENTRY_USED	0x80000000U
+#define	LINKS_ENTRY_SPILLED	0x40000000U
+#define	LINKS_ENTRY_CANONICAL_SPILLED	0x20000000U
+#define	LINKS_ENTRY_FLAGS	(LINKS_ENTRY_USED | LINKS_ENTRY_SPILLED |\
+				 LINKS_ENTRY_CANONICAL_SPILLED)
 
 struct links_entry {
-	struct links_entry	*next;
-	struct links_entry	*previous;
-	struct archive_entry	*canonical;
+	int64_t			 ino;
+	dev_t			 dev;
+	/* Entry held back by the new cpio strategy. */
 	struct archive_entry	*entry;
-	size_t			 hash;
+	/* The first link, cloned while within the memory limit. */
+	union {
+		struct archive_entry *e;
+		int64_t		 offset;/* Offset in the spill file. */
+	} canonical;
+	union {
+		char		*s;	/* Pathname held in memory. */
+		int64_t		 offset;/* Offset in the spill file. */
+	} name;
+	unsigned int		 name_len;
 	unsigned int		 links; /* # links not yet seen */
+	unsigned int		 canonical_len; /* Size in the spill file. */
+	unsigned int		 mode;	/* File type and LINKS_ENTRY_* */
 };
 
 struct archive_entry_linkresolver {
-	struct links_entry	**buckets;
-	struct links_entry	 *spare;
+	struct links_entry	 *slots;
 	unsigned long		  number_entries;
-	size_t			  number_buckets;
+	size_t			  number_slots;
+	size_t			  scan;		/* next_entry() cursor */
+	int			  scan_mode;
 	int			  strategy;
+	/* Memory accounting and the pathname spill file. */
+	size_t			  memory_limit;
+	size_t			  memory_used;
+	int			  spill_fd;
+	int64_t			  spill_size;
+	struct archive_string	  spill_buff;
 };
 
 #define	NEXT_ENTRY_DEFERRED	1
 #define	NEXT_ENTRY_PARTIAL	2
-#define	NEXT_ENTRY_ALL		(NEXT_ENTRY_DEFERRED | NEXT_ENTRY_PARTIAL)
 
+static size_t hash_slot(struct archive_entry_linkresolver *, dev_t,
+		    int64_t);
 static struct links_entry *find_entry(struct archive_entry_linkresolver *,
 		    struct archive_entry *);
 static void grow_hash(struct archive_entry_linkresolver *);
@@ -94,6 +138,15 @@ static struct links_entry *insert_entry(struct archive_entry_linkresolver *,
 		    struct archive_entry *);
 static struct links_entry *next_entry(struct archive_entry_linkresolver *,
     int);
+static void remove_entry(struct archive_entry_linkresolver *,
+		    struct links_entry *);
+static const char *entry_name(struct archive_entry_linkresolver *,
+		    struct links_entry *);
+static size_t canonical_size(const struct links_entry *);
+static int spill_canonical(struct archive_entry_linkresolver *,
+		    struct links_entry *, struct archive_entry *);
+static struct archive_entry *read_canonical(
+		    struct archive_entry_linkresolver *, struct links_entry *);
 
 struct archive_entry_linkresolver *
 archive_entry_linkresolver_new(void)
@@ -108,12 +161,16 @@ archive_entry_linkresolver_new(void)
 	res = calloc(1, sizeof(struct archive_entry_linkresolver));
 	if (res == NULL)
 		return (NULL);
-	res->number_buckets = links_cache_initial_size;
-	res->buckets = calloc(res->number_buckets, sizeof(res->buckets[0]));
-	if (res->buckets == NULL) {
+	res->number_slots = links_cache_initial_size;
+	res->slots = calloc(res->number_slots, sizeof(res->slots[0]));
+	if (res->slots == NULL) {
 		free(res);
 		return (NULL);
 	}
+	res->memory_limit = links_cache_memory_limit;
+	res->memory_used = res->number_slots * sizeof(res->slots[0]);
+	res->spill_fd = -1;
+	archive_string_init(&res->spill_buff);
 	return (res);
 }
 
@@ -155,17 +212,36 @@ archive_entry_linkresolver_set_strategy(struct archive_entry_linkresolver *res,
 	}
 }
 
+void
+archive_entry_linkresolver_set_memory_limit(
+    struct archive_entry_linkresolver *res, size_t limit)
+{
+	res->memory_limit = limit;
+}
+
 void
 archive_entry_linkresolver_free(struct archive_entry_linkresolver *res)
 {
 	struct links_entry *le;
+	size_t i;
 
 	if (res == NULL)
 		return;
 
-	while ((le = next_entry(res, NEXT_ENTRY_ALL)) != NULL)
+	for (i = 0; i < res->number_slots; i++) {
+		le = &res->slots[i];
+		if ((le->mode & LINKS_ENTRY_USED) == 0)
+			continue;
 		archive_entry_free(le->entry);
-	free(res->buckets);
+		if ((le->mode & LINKS_ENTRY_CANONICAL_SPILLED) == 0)
+			archive_entry_free(le->canonical.e);
+		if ((le->mode & LINKS_ENTRY_SPILLED) == 0)
+			free(le->name.s);
+	}
+	if (res->spill_fd >= 0)
+		close(res->spill_fd);
+	archive_string_free(&res->spill_buff);
+	free(res->slots);
 	free(res);
 }
 
@@ -175,6 +251,7 @@ archive_entry_linkify(struct archive_entry_linkresolver *res,
 {
 	struct links_entry *le;
 	struct archive_entry *t;
+	const char *name;
 
 	*f = NULL; /* Default: Don't return a second entry. */
 
@@ -183,6 +260,7 @@ archive_entry_linkify(struct archive_entry_linkresolver *res,
 		if (le != NULL) {
 			*e = le->entry;
 			le->entry = NULL;
+			remove_entry(res, le);
 		}
 		return;
 	}
@@ -198,19 +276,27 @@ archive_entry_linkify(struct archive_entry_linkresolver *res,
 
 	switch (res->strategy) {
 	case ARCHIVE_ENTRY_LINKIFY_LIKE_TAR:
-		le = find_entry(res, *e);
-		if (le != NULL) {
-			archive_entry_unset_size(*e);
-			archive_entry_copy_hardlink(*e,
-			    archive_entry_pathname(le->canonical));
-		} else
-			insert_entry(res, *e);
-		return;
 	case ARCHIVE_ENTRY_LINKIFY_LIKE_MTREE:
 		le = find_entry(res, *e);
 		if (le != NULL) {
-			archive_entry_copy_hardlink(*e,
-			    archive_entry_pathname(le->canonical));
+			/*
+			 * If the first pathname cannot be read back, store
+			 * this link with its own body rather than failing.
+			 */
+			name = entry_name(res, le);
+			if (name != NULL) {
+				if (res->strategy ==
+				    ARCHIVE_ENTRY_LINKIFY_LIKE_TAR)
+					archive_entry_unset_size(*e);
+				archive_entry_copy_hardlink(*e, name);
+			}
+			/*
+			 * Release the record once all links have been
+			 * seen.  This saves memory and is necessary for
+			 * detecting missed links.
+			 */
+			if (le->links == 0)
+				remove_entry(res, le);
 		} else
 			insert_entry(res, *e);
 		return;
@@ -228,14 +314,17 @@ archive_entry_linkify(struct archive_entry_linkresolver *res,
 			*e = le->entry;
 			le->entry = t;
 			/* Make the old entry into a hardlink. */
-			archive_entry_unset_size(*e);
-			archive_entry_copy_hardlink(*e,
-			    archive_entry_pathname(le->canonical));
+			name = entry_name(res, le);
+			if (name != NULL) {
+				archive_entry_unset_size(*e);
+				archive_entry_copy_hardlink(*e, name);
+			}
 			/* If we ran out of links, return the
 			 * final entry as well. */
 			if (le->links == 0) {
 				*f = le->entry;
 				le->entry = NULL;
+				remove_entry(res, le);
 			}
 		} else {
 			/*
@@ -256,94 +345,490 @@ archive_entry_linkify(struct archive_entry_linkresolver *res,
 	return;
 }
 
+static size_t
+hash_slot(struct archive_entry_linkresolver *res, dev_t dev, int64_t ino)
+{
+	uint64_t h;
+
+	/* Inode numbers are often sequential; spread them out. */
+	h = ((uint64_t)ino ^ ((uint64_t)dev << 32 | (uint64_t)dev >> 32))
+	    * ARCHIVE_LITERAL_ULL(0x9E3779B97F4A7C15);
+	h ^= h >> 29;
+	return ((size_t)h & (res->number_slots - 1));
+}
+
 static struct links_entry *
 find_entry(struct archive_entry_linkresolver *res,
     struct archive_entry *entry)
 {
 	struct links_entry	*le;
-	size_t			 hash, bucket;
+	size_t			 slot, mask;
 	dev_t			 dev;
 	int64_t			 ino;
 
-	/* Free a held entry. */
-	if (res->spare != NULL) {
-		archive_entry_free(res->spare->canonical);
-		archive_entry_free(res->spare->entry);
-		free(res->spare);
-		res->spare = NULL;
-	}
-
 	dev = archive_entry_dev(entry);
 	ino = archive_entry_ino64(entry);
-	hash = (size_t)(dev ^ ino);
+	mask = res->number_slots - 1;
 
 	/* Try to locate this entry in the links cache. */
-	bucket = hash & (res->number_buckets - 1);
-	for (le = res->buckets[bucket]; le != NULL; le = le->next) {
-		if (le->hash == hash
-		    && dev == archive_entry_dev(le->canonical)
-		    && ino == archive_entry_ino64(le->canonical)) {
+	for (slot = hash_slot(res, dev, ino);; slot = (slot + 1) & mask) {
+		le = &res->slots[slot];
+		if ((le->mode & LINKS_ENTRY_USED) == 0)
+			return (NULL);
+		if (le->ino == ino && le->dev == dev) {
 			/*
-			 * Decrement link count each time and release
-			 * the entry if it hits zero.  This saves
-			 * memory and is necessary for detecting
-			 * missed links.
+			 * Decrement link count each time; the caller
+			 * releases the record when it hits zero.
 			 */
 			--le->links;
-			if (le->links > 0)
-				return (le);
-			/* Remove it from this hash bucket. */
-			if (le->previous != NULL)
-				le->previous->next = le->next;
-			if (le->next != NULL)
-				le->next->previous = le->previous;
-			if (res->buckets[bucket] == le)
-				res->buckets[bucket] = le->next;
-			res->number_entries--;
-			/* Defer freeing this entry. */
-			res->spare = le;
 			return (le);
 		}
 	}
-	return (NULL);
 }
 
 static struct links_entry *
 next_entry(struct archive_entry_linkresolver *res, int mode)
 {
 	struct links_entry	*le;
-	size_t			 bucket;
-
-	/* Free a held entry. */
-	if (res->spare != NULL) {
-		archive_entry_free(res->spare->canonical);
-		archive_entry_free(res->spare->entry);
-		free(res->spare);
-		res->spare = NULL;
+
+	/*
+	 * Resume where the last call left off.  Removing the returned
+	 * record only pulls records from later in its probe sequence
+	 * into the slot under the cursor, so nothing is skipped.
+	 */
+	if (mode != res->scan_mode) {
+		res->scan = 0;
+		res->scan_mode = mode;
+	}
+	for (; res->scan < res->number_slots; res->scan++) {
+		le = &res->slots[res->scan];
+		if ((le->mode & LINKS_ENTRY_USED) == 0)
+			continue;
+		if (le->entry != NULL &&
+		    (mode & NEXT_ENTRY_DEFERRED) == 0)
+			continue;
+		if (le->entry == NULL &&
+		    (mode & NEXT_ENTRY_PARTIAL) == 0)
+			continue;
+		return (le);
+	}
+	/* Nothing left; start from the top next time. */
+	res->scan = 0;
+	return (NULL);
+}
+
+static void
+remove_entry(struct archive_entry_linkresolver *res, struct links_entry *le)
+{
+	struct links_entry	*next;
+	size_t			 hole, slot, home, mask;
+
+	if ((le->mode & LINKS_ENTRY_SPILLED) == 0) {
+		free(le->name.s);
+		res->memory_used -= le->name_len + 1;
+	}
+	archive_entry_free(le->entry);
+	if ((le->mode & LINKS_ENTRY_CANONICAL_SPILLED) == 0 &&
+	    le->canonical.e != NULL) {
+		archive_entry_free(le->canonical.e);
+		res->memory_used -= canonical_size(le);
+	}
+
+	/*
+	 * Backward-shift deletion: pull later members of the probe
+	 * sequence into the hole so that lookups never need tombstones.
+	 */
+	mask = res->number_slots - 1;
+	hole = le - res->slots;
+	for (slot = (hole + 1) & mask;; slot = (slot + 1) & mask) {
+		next = &res->slots[slot];
+		if ((next->mode & LINKS_ENTRY_USED) == 0)
+			break;
+		home = hash_slot(res, next->dev, next->ino);
+		/* Leave records whose home lies in (hole, slot]. */
+		if (((slot - home) & mask) < ((slot - hole) & mask))
+			continue;
+		res->slots[hole] = *next;
+		hole = slot;
 	}
+	memset(&res->slots[hole], 0, sizeof(res->slots[hole]));
+	res->number_entries--;
+}
 
-	/* Look for next non-empty bucket in the links cache. */
-	for (bucket = 0; bucket < res->number_buckets; bucket++) {
-		for (le = res->buckets[bucket]; le != NULL; le = le->next) {
-			if (le->entry != NULL &&
-			    (mode & NEXT_ENTRY_DEFERRED) == 0)
+/*
+ * Rough memory cost of the clone of the first link; the pathname is
+ * usually held in two forms.
+ */
+static size_t
+canonical_size(const struct links_entry *le)
+{
+	return (sizeof(struct archive_entry) + 2 * (le->name_len + 1));
+}
+
+/*
+ * Append data to the spill file, creating it on first use, and return
+ * the offset it was written at.
+ */
+static int64_t
+spill_write(struct archive_entry_linkresolver *res, const void *buff,
+    size_t s)
+{
+	const char *p = buff;
+	int64_t offset;
+	ssize_t written;
+
+	if (res->spill_fd < 0) {
+		res->spill_fd = __archive_mktemp(NULL);
+		if (res->spill_fd < 0)
+			return (-1);
+	}
+	if (lseek(res->spill_fd, res->spill_size, SEEK_SET) < 0)
+		return (-1);
+	offset = res->spill_size;
+	while (s > 0) {
+		written = write(res->spill_fd, p, s);
+		if (written <= 0) {
+			if (written < 0 && errno == EINTR)
 				continue;
-			if (le->entry == NULL &&
-			    (mode & NEXT_ENTRY_PARTIAL) == 0)
+			return (-1);
+		}
+		p += written;
+		s -= written;
+		/* A failed write leaves this much garbage behind. */
+		res->spill_size += written;
+	}
+	return (offset);
+}
+
+/*
+ * Read data back from the spill file into spill_buff, followed by a
+ * NUL.  The data is valid until the next call.
+ */
+static const char *
+spill_read(struct archive_entry_linkresolver *res, int64_t offset, size_t s)
+{
+	char *p;
+	size_t left;
+	ssize_t bytes;
+
+	archive_string_empty(&res->spill_buff);
+	if (archive_string_ensure(&res->spill_buff, s + 1) == NULL)
+		return (NULL);
+	if (lseek(res->spill_fd, offset, SEEK_SET) < 0)
+		return (NULL);
+	p = res->spill_buff.s;
+	left = s;
+	while (left > 0) {
+		bytes = read(res->spill_fd, p, left);
+		if (bytes <= 0) {
+			if (bytes < 0 && errno == EINTR)
 				continue;
-			/* Remove it from this hash bucket. */
-			if (le->next != NULL)
-				le->next->previous = le->previous;
-			if (le->previous != NULL)
-				le->previous->next = le->next;
-			else
-				res->buckets[bucket] = le->next;
-			res->number_entries--;
-			/* Defer freeing this entry. */
-			res->spare = le;
-			return (le);
+			return (NULL);
 		}
+		p += bytes;
+		left -= bytes;
 	}
+	res->spill_buff.s[s] = '\0';
+	res->spill_buff.length = s;
+	return (res->spill_buff.s);
+}
+
+/*
+ * Append a pathname to the spill file.
+ */
+static int
+spill_name(struct archive_entry_linkresolver *res, struct links_entry *le,
+    const char *name)
+{
+	int64_t offset;
+
+	offset = spill_write(res, name, le->name_len);
+	if (offset < 0)
+		return (-1);
+	le->name.offset = offset;
+	le->mode |= LINKS_ENTRY_SPILLED;
+	return (0);
+}
+
+/*
+ * Return the pathname recorded for the first link.  Spilled names are
+ * read back into a buffer that is valid until the next call.
+ */
+static const char *
+entry_name(struct archive_entry_linkresolver *res, struct links_entry *le)
+{
+
+	if ((le->mode & LINKS_ENTRY_SPILLED) == 0)
+		return (le->name.s);
+	return (spill_read(res, le->name.offset, le->name_len));
+}
+
+/*
+ * A first link that does not fit in memory is written to the spill
+ * file field by field, with everything archive_entry_clone() copies,
+ * so that archive_entry_partial_links() can return it unchanged.
+ * Only this process reads the file back, so the fields are stored in
+ * their native form.
+ */
+static void
+put_data(struct archive_string *b, const void *p, size_t s)
+{
+	if (s > 0)
+		archive_array_append(b, p, s);
+}
+
+static void
+put_blob(struct archive_string *b, const void *p, size_t s)
+{
+	put_data(b, &s, sizeof(s));
+	put_data(b, p, s);
+}
+
+static void
+put_mstring(struct archive_string *b, struct archive_mstring *m)
+{
+	int set = m->aes_set & (AES_SET_MBS | AES_SET_UTF8 | AES_SET_WCS);
+
+	put_data(b, &set, sizeof(set));
+	if (set & AES_SET_MBS)
+		put_blob(b, m->aes_mbs.s, m->aes_mbs.length);
+	if (set & AES_SET_UTF8)
+		put_blob(b, m->aes_utf8.s, m->aes_utf8.length);
+	if (set & AES_SET_WCS)
+		put_blob(b, m->aes_wcs.s,
+		    m->aes_wcs.length * sizeof(wchar_t));
+}
+
+static int
+spill_canonical(struct archive_entry_linkresolver *res,
+    struct links_entry *le, struct archive_entry *entry)
+{
+	struct archive_string *b = &res->spill_buff;
+	struct archive_acl_entry *ap;
+	struct ae_xattr *xp;
+	struct ae_sparse *sp;
+	int64_t offset;
+	size_t n;
+
+	archive_string_empty(b);
+	put_data(b, &entry->archive, sizeof(entry->archive));
+	put_data(b, &entry->ae_stat, sizeof(entry->ae_stat));
+	put_data(b, &entry->ae_set, sizeof(entry->ae_set));
+	put_data(b, &entry->ae_fflags_set, sizeof(entry->ae_fflags_set));
+	put_data(b, &entry->ae_fflags_clear, sizeof(entry->ae_fflags_clear));
+	put_data(b, &entry->ae_symlink_type, sizeof(entry->ae_symlink_type));
+	put_data(b, &entry->encryption, sizeof(entry->encryption));
+	put_data(b, &entry->digest, sizeof(entry->digest));
+	put_mstring(b, &entry->ae_fflags_text);
+	put_mstring(b, &entry->ae_gname);
+	put_mstring(b, &entry->ae_hardlink);
+	put_mstring(b, &entry->ae_pathname);
+	put_mstring(b, &entry->ae_sourcepath);
+	put_mstring(b, &entry->ae_symlink);
+	put_mstring(b, &entry->ae_uname);
+
+	put_data(b, &entry->acl.mode, sizeof(entry->acl.mode));
+	for (n = 0, ap = entry->acl.acl_head; ap != NULL; ap = ap->next)
+		n++;
+	put_data(b, &n, sizeof(n));
+	for (ap = entry->acl.acl_head; ap != NULL; ap = ap->next) {
+		put_data(b, &ap->type, sizeof(ap->type));
+		put_data(b, &ap->tag, sizeof(ap->tag));
+		put_data(b, &ap->permset, sizeof(ap->permset));
+		put_data(b, &ap->id, sizeof(ap->id));
+		put_mstring(b, &ap->name);
+	}
+
+	put_blob(b, entry->mac_metadata, entry->mac_metadata_size);
+
+	for (n = 0, xp = entry->xattr_head; xp != NULL; xp = xp->next)
+		n++;
+	put_data(b, &n, sizeof(n));
+	for (xp = entry->xattr_head; xp != NULL; xp = xp->next) {
+		put_blob(b, xp->name, strlen(xp->name) + 1);
+		put_blob(b, xp->value, xp->size);
+	}
+
+	for (n = 0, sp = entry->sparse_head; sp != NULL; sp = sp->next)
+		n++;
+	put_data(b, &n, sizeof(n));
+	for (sp = entry->sparse_head; sp != NULL; sp = sp->next) {
+		put_data(b, &sp->offset, sizeof(sp->offset));
+		put_data(b, &sp->length, sizeof(sp->length));
+	}
+
+	if (b->length > UINT_MAX)
+		return (-1);
+	offset = spill_write(res, b->s, b->length);
+	if (offset < 0)
+		return (-1);
+	le->canonical.offset = offset;
+	le->canonical_len = (unsigned int)b->length;
+	le->mode |= LINKS_ENTRY_CANONICAL_SPILLED;
+	return (0);
+}
+
+struct spill_cursor {
+	const char	*p;
+	size_t		 left;
+};
+
+static const void *
+get_data(struct spill_cursor *c, size_t s)
+{
+	const void *p = c->p;
+
+	if (s > c->left)
+		return (NULL);
+	c->p += s;
+	c->left -= s;
+	return (p);
+}
+
+static int
+get_copy(struct spill_cursor *c, void *dst, size_t s)
+{
+	const void *p = get_data(c, s);
+
+	if (p == NULL)
+		return (-1);
+	memcpy(dst, p, s);
+	return (0);
+}
+
+static const void *
+get_blob(struct spill_cursor *c, size_t *s)
+{
+	if (get_copy(c, s, sizeof(*s)) != 0)
+		return (NULL);
+	if (*s == 0)
+		return ("");
+	return (get_data(c, *s));
+}
+
+static int
+get_mstring(struct spill_cursor *c, struct archive_mstring *m)
+{
+	const void *p;
+	size_t s;
+	int set;
+
+	if (get_copy(c, &set, sizeof(set)) != 0)
+		return (-1);
+	if (set & AES_SET_MBS) {
+		if ((p = get_blob(c, &s)) == NULL)
+			return (-1);
+		archive_strncpy(&m->aes_mbs, p, s);
+	}
+	if (set & AES_SET_UTF8) {
+		if ((p = get_blob(c, &s)) == NULL)
+			return (-1);
+		archive_strncpy(&m->aes_utf8, p, s);
+	}
+	if (set & AES_SET_WCS) {
+		/* The data is not necessarily aligned for wchar_t. */
+		if ((p = get_blob(c, &s)) == NULL ||
+		    archive_wstring_ensure(&m->aes_wcs,
+		    s / sizeof(wchar_t) + 1) == NULL)
+			return (-1);
+		memcpy(m->aes_wcs.s, p, s);
+		m->aes_wcs.length = s / sizeof(wchar_t);
+		m->aes_wcs.s[m->aes_wcs.length] = L'\0';
+	}
+	m->aes_set = set;
+	return (0);
+}
+
+static struct archive_entry *
+read_canonical(struct archive_entry_linkresolver *res, struct links_entry *le)
+{
+	struct spill_cursor c;
+	struct archive_entry *e;
+	struct archive_acl_entry *ap;
+	struct archive_mstring name;
+	struct archive *a;
+	const void *p, *v;
+	size_t n, s, vs;
+	int type, tag, permset, id, r;
+	int64_t offset, length;
+
+	memset(&name, 0, sizeof(name));
+	c.p = spill_read(res, le->canonical.offset, le->canonical_len);
+	c.left = le->canonical_len;
+	if (c.p == NULL || get_copy(&c, &a, sizeof(a)) != 0)
+		return (NULL);
+	if ((e = archive_entry_new2(a)) == NULL)
+		return (NULL);
+	if (get_copy(&c, &e->ae_stat, sizeof(e->ae_stat)) != 0 ||
+	    get_copy(&c, &e->ae_set, sizeof(e->ae_set)) != 0 ||
+	    get_copy(&c, &e->ae_fflags_set, sizeof(e->ae_fflags_set)) != 0 ||
+	    get_copy(&c, &e->ae_fflags_clear,
+	      sizeof(e->ae_fflags_clear)) != 0 ||
+	    get_copy(&c, &e->ae_symlink_type,
+	      sizeof(e->ae_symlink_type)) != 0 ||
+	    get_copy(&c, &e->encryption, sizeof(e->encryption)) != 0 ||
+	    get_copy(&c, &e->digest, sizeof(e->digest)) != 0 ||
+	    get_mstring(&c, &e->ae_fflags_text) != 0 ||
+	    get_mstring(&c, &e->ae_gname) != 0 ||
+	    get_mstring(&c, &e->ae_hardlink) != 0 ||
+	    get_mstring(&c, &e->ae_pathname) != 0 ||
+	    get_mstring(&c, &e->ae_sourcepath) != 0 ||
+	    get_mstring(&c, &e->ae_symlink) != 0 ||
+	    get_mstring(&c, &e->ae_uname) != 0)
+		goto fail;
+	e->stat_valid = 0;
+
+	if (get_copy(&c, &e->acl.mode, sizeof(e->acl.mode)) != 0 ||
+	    get_copy(&c, &n, sizeof(n)) != 0)
+		goto fail;
+	while (n-- > 0) {
+		if (get_copy(&c, &type, sizeof(type)) != 0 ||
+		    get_copy(&c, &tag, sizeof(tag)) != 0 ||
+		    get_copy(&c, &permset, sizeof(permset)) != 0 ||
+		    get_copy(&c, &id, sizeof(id)) != 0 ||
+		    archive_acl_add_entry(&e->acl, type, permset, tag, id,
+		      NULL) != ARCHIVE_OK)
+			goto fail;
+		/* The entry was added at the end of the list. */
+		for (ap = e->acl.acl_head; ap != NULL && ap->next != NULL;
+		    ap = ap->next)
+			continue;
+		if (ap == NULL || ap->type != type || ap->tag != tag ||
+		    ap->id != id)
+			ap = NULL;	/* Recorded in acl.mode instead. */
+		r = get_mstring(&c, ap != NULL ? &ap->name : &name);
+		archive_mstring_clean(&name);
+		if (r != 0)
+			goto fail;
+	}
+
+	if ((p = get_blob(&c, &s)) == NULL)
+		goto fail;
+	if (s > 0)
+		archive_entry_copy_mac_metadata(e, p, s);
+
+	if (get_copy(&c, &n, sizeof(n)) != 0)
+		goto fail;
+	while (n-- > 0) {
+		/* The name was stored with its NUL. */
+		if ((p = get_blob(&c, &s)) == NULL || s == 0 ||
+		    ((const char *)p)[s - 1] != '\0' ||
+		    (v = get_blob(&c, &vs)) == NULL)
+			goto fail;
+		archive_entry_xattr_add_entry(e, p, v, vs);
+	}
+
+	if (get_copy(&c, &n, sizeof(n)) != 0)
+		goto fail;
+	while (n-- > 0) {
+		if (get_copy(&c, &offset, sizeof(offset)) != 0 ||
+		    get_copy(&c, &length, sizeof(length)) != 0)
+			goto fail;
+		archive_entry_sparse_add_entry(e, offset, length);
+	}
+	return (e);
+fail:
+	archive_entry_free(e);
 	return (NULL);
 }
 
@@ -352,68 +837,114 @@ insert_entry(struct archive_entry_linkresolver *res,
     struct archive_entry *entry)
 {
 	struct links_entry *le;
-	size_t hash, bucket;
+	const char *name;
+	size_t slot, mask, len;
 
-	/* Add this entry to the links cache. */
-	le = calloc(1, sizeof(struct links_entry));
-	if (le == NULL)
+	/* Keep the load factor of the links cache below 3/4. */
+	if ((res->number_entries + 1) * 4 > res->number_slots * 3)
+		grow_hash(res);
+	if (res->number_entries + 1 >= res->number_slots)
 		return (NULL);
-	le->canonical = archive_entry_clone(entry);
 
-	/* If the links cache is getting too full, enlarge the hash table. */
-	if (res->number_entries > res->number_buckets * 2)
-		grow_hash(res);
+	name = archive_entry_pathname(entry);
+	if (name == NULL)
+		name = "";
+	len = strlen(name);
+	if (len > UINT_MAX - 1)
+		return (NULL);
 
-	hash = (size_t)(archive_entry_dev(entry) ^ archive_entry_ino64(entry));
-	bucket = hash & (res->number_buckets - 1);
+	mask = res->number_slots - 1;
+	slot = hash_slot(res, archive_entry_dev(entry),
+	    archive_entry_ino64(entry));
+	while (res->slots[slot].mode & LINKS_ENTRY_USED)
+		slot = (slot + 1) & mask;
+	le = &res->slots[slot];
+	le->ino = archive_entry_ino64(entry);
+	le->dev = archive_entry_dev(entry);
+	le->entry = NULL;
+	le->canonical.e = NULL;
+	le->name_len = (unsigned int)len;
+	le->links = archive_entry_nlink(entry) - 1;
+	le->mode = (archive_entry_mode(entry) & ~LINKS_ENTRY_FLAGS)
+	    | LINKS_ENTRY_USED;
+
+	/*
+	 * Hold the pathname in memory while within the limit; past it,
+	 * spill it to disk, falling back to memory if that fails.
+	 */
+	if (res->memory_limit == 0 ||
+	    res->memory_used + len + 1 <= res->memory_limit ||
+	    spill_name(res, le, name) != 0) {
+		le->name.s = malloc(len + 1);
+		if (le->name.s == NULL) {
+			memset(le, 0, sizeof(*le));
+			return (NULL);
+		}
+		memcpy(le->name.s, name, len + 1);
+		res->memory_used += len + 1;
+	}
 
-	/* If we could allocate the entry, record it. */
-	if (res->buckets[bucket] != NULL)
-		res->buckets[bucket]->previous = le;
+	/*
+	 * Also keep the whole first link so that
+	 * archive_entry_partial_links() can return it unchanged: in memory
+	 * while the resolver uses less than half of its limit, since the
+	 * pathnames needed to resolve links keep the other half, and in
+	 * the spill file past that.  A file whose first link cannot be
+	 * kept is not tracked.  New cpio holds back an entry of its own.
+	 */
+	if (res->strategy != ARCHIVE_ENTRY_LINKIFY_LIKE_NEW_CPIO &&
+	    (res->memory_limit == 0 || res->memory_used +
+	    canonical_size(le) <= res->memory_limit / 2 ||
+	    spill_canonical(res, le, entry) != 0)) {
+		le->canonical.e = archive_entry_clone(entry);
+		if (le->canonical.e == NULL) {
+			if ((le->mode & LINKS_ENTRY_SPILLED) == 0) {
+				free(le->name.s);
+				res->memory_used -= len + 1;
+			}
+			memset(le, 0, sizeof(*le));
+			return (NULL);
+		}
+		res->memory_used += canonical_size(le);
+	}
 	res->number_entries++;
-	le->next = res->buckets[bucket];
-	le->previous = NULL;
-	res->buckets[bucket] = le;
-	le->hash = hash;
-	le->links = archive_entry_nlink(entry) - 1;
+	/* The new record may land behind the next_entry() cursor. */
+	res->scan = 0;
 	return (le);
 }
 
 static void
 grow_hash(struct archive_entry_linkresolver *res)
 {
-	struct links_entry *le, **new_buckets;
-	size_t new_size;
-	size_t i, bucket;
-
-	/* Try to enlarge the bucket list. */
-	new_size = res->number_buckets * 2;
-	if (new_size < res->number_buckets)
+	struct links_entry *le, *new_slots;
+	size_t new_size, old_size;
+	size_t i, slot;
+
+	/* Try to enlarge the slot array. */
+	old_size = res->number_slots;
+	new_size = old_size * 2;
+	if (new_size < old_size ||
+	    new_size > SIZE_MAX / sizeof(struct links_entry))
 		return;
-	new_buckets = calloc(new_size, sizeof(struct links_entry *));
+	new_slots = calloc(new_size, sizeof(struct links_entry));
 
-	if (new_buckets == NULL)
+	if (new_slots == NULL)
 		return;
 
-	for (i = 0; i < res->number_buckets; i++) {
-		while (res->buckets[i] != NULL) {
-			/* Remove entry from old bucket. */
-			le = res->buckets[i];
-			res->buckets[i] = le->next;
-
-			/* Add entry to new bucket. */
-			bucket = le->hash & (new_size - 1);
-
-			if (new_buckets[bucket] != NULL)
-				new_buckets[bucket]->previous = le;
-			le->next = new_buckets[bucket];
-			le->previous = NULL;
-			new_buckets[bucket] = le;
-		}
+	res->number_slots = new_size;
+	for (i = 0; i < old_size; i++) {
+		le = &res->slots[i];
+		if ((le->mode & LINKS_ENTRY_USED) == 0)
+			continue;
+		slot = hash_slot(res, le->dev, le->ino);
+		while (new_slots[slot].mode & LINKS_ENTRY_USED)
+			slot = (slot + 1) & (new_size - 1);
+		new_slots[slot] = *le;
 	}
-	free(res->buckets);
-	res->buckets = new_buckets;
-	res->number_buckets = new_size;
+	free(res->slots);
+	res->slots = new_slots;
+	res->memory_used += (new_size - old_size) * sizeof(struct links_entry);
+	res->scan = 0;
 }
 
 struct archive_entry *
@@ -423,24 +954,22 @@ archive_entry_partial_links(struct archive_entry_linkresolver *res,
 	struct archive_entry	*e;
 	struct links_entry	*le;
 
-	/* Free a held entry. */
-	if (res->spare != NULL) {
-		archive_entry_free(res->spare->canonical);
-		archive_entry_free(res->spare->entry);
-		free(res->spare);
-		res->spare = NULL;
-	}
-
+	if (links != NULL)
+		*links = 0;
 	le = next_entry(res, NEXT_ENTRY_PARTIAL);
-	if (le != NULL) {
-		e = le->canonical;
-		if (links != NULL)
-			*links = le->links;
-		le->canonical = NULL;
+	if (le == NULL)
+		return (NULL);
+	if (le->mode & LINKS_ENTRY_CANONICAL_SPILLED) {
+		e = read_canonical(res, le);
+		if (e == NULL)
+			return (NULL);
 	} else {
-		e = NULL;
-		if (links != NULL)
-			*links = 0;
+		e = le->canonical.e;
+		le->canonical.e = NULL;
+		res->memory_used -= canonical_size(le);
 	}
+	if (links != NULL)
+		*links = le->links;
+	remove_entry(res, le);
 	return (e);
 }
@@ -39,6 +39,10 @@ struct ae_xattr {
 	char	*name;
 	void	*value;
 	size_t	size;
+
+	/* Allocated sizes of name and value, so that nodes can be reused. */
+	size_t	name_alloc;
+	size_t	value_alloc;
 };
 
 struct ae_sparse {
@@ -178,11 +182,13 @@ struct archive_entry {
 	/* extattr support. */
 	struct ae_xattr *xattr_head;
 	struct ae_xattr *xattr_p;
+	struct ae_xattr *xattr_free;	/* Nodes kept for reuse. */
 
 	/* sparse support. */
 	struct ae_sparse *sparse_head;
 	struct ae_sparse *sparse_tail;
 	struct ae_sparse *sparse_p;
+	struct ae_sparse *sparse_free;	/* Nodes kept for reuse. */
 
 	/* Miscellaneous. */
 	char		 strmode[12];
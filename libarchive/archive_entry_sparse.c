@@ -40,12 +40,15 @@ archive_entry_sparse_clear(struct archive_entry *entry)
 {
 	struct ae_sparse *sp;
 
+	/* Keep the nodes for the next entries. */
 	while (entry->sparse_head != NULL) {
 		sp = entry->sparse_head->next;
-		free(entry->sparse_head);
+		entry->sparse_head->next = entry->sparse_free;
+		entry->sparse_free = entry->sparse_head;
 		entry->sparse_head = sp;
 	}
 	entry->sparse_tail = NULL;
+	entry->sparse_p = NULL;
 }
 
 void
@@ -76,7 +79,9 @@ archive_entry_sparse_add_entry(struct archive_entry *entry,
 		}
 	}
 
-	if ((sp = (struct ae_sparse *)malloc(sizeof(*sp))) == NULL)
+	if ((sp = entry->sparse_free) != NULL)
+		entry->sparse_free = sp->next;
+	else if ((sp = (struct ae_sparse *)malloc(sizeof(*sp))) == NULL)
 		/* XXX Error XXX */
 		return;
 
@@ -73,15 +73,16 @@ archive_entry_xattr_clear(struct archive_entry *entry)
 {
 	struct ae_xattr	*xp;
 
+	/* Keep the nodes, with their buffers, for the next entries. */
 	while (entry->xattr_head != NULL) {
 		xp = entry->xattr_head->next;
-		free(entry->xattr_head->name);
-		free(entry->xattr_head->value);
-		free(entry->xattr_head);
+		entry->xattr_head->next = entry->xattr_free;
+		entry->xattr_free = entry->xattr_head;
 		entry->xattr_head = xp;
 	}
 
 	entry->xattr_head = NULL;
+	entry->xattr_p = NULL;
 }
 
 void
@@ -89,14 +90,27 @@ archive_entry_xattr_add_entry(struct archive_entry *entry,
 	const char *name, const void *value, size_t size)
 {
 	struct ae_xattr	*xp;
+	size_t name_len = strlen(name) + 1;
 
-	if ((xp = (struct ae_xattr *)malloc(sizeof(struct ae_xattr))) == NULL)
+	if ((xp = entry->xattr_free) != NULL)
+		entry->xattr_free = xp->next;
+	else if ((xp = (struct ae_xattr *)calloc(1, sizeof(*xp))) == NULL)
 		__archive_errx(1, "Out of memory");
 
-	if ((xp->name = strdup(name)) == NULL)
-		__archive_errx(1, "Out of memory");
+	if (name_len > xp->name_alloc) {
+		free(xp->name);
+		if ((xp->name = malloc(name_len)) == NULL)
+			__archive_errx(1, "Out of memory");
+		xp->name_alloc = name_len;
+	}
+	memcpy(xp->name, name, name_len);
 
-	if ((xp->value = malloc(size)) != NULL) {
+	if (size > xp->value_alloc || xp->value == NULL) {
+		free(xp->value);
+		xp->value = malloc(size);
+		xp->value_alloc = (xp->value != NULL) ? size : 0;
+	}
+	if (xp->value != NULL) {
 		memcpy(xp->value, value, size);
 		xp->size = size;
 	} else
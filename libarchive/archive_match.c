@@ -48,6 +48,12 @@ struct match {
 	struct match		*next;
 	int			 matches;
 	struct archive_mstring	 pattern;
+	/* Set up by match_list_compile(). */
+	struct match		*hash_next;	/* Literal hash chain. */
+	struct match		*glob_next;	/* Non-literal patterns. */
+	const void		*key;		/* Literal pattern text. */
+	size_t			 key_len;
+	unsigned		 key_hash;
 };
 
 struct match_list {
@@ -57,8 +63,26 @@ struct match_list {
 	int			 unmatched_count;
 	struct match		*unmatched_next;
 	int			 unmatched_eof;
+	/*
+	 * Once a list grows large, patterns without wildcards are
+	 * looked up in a hash table keyed by their text so that testing
+	 * a pathname does not have to walk every pattern.  The table is
+	 * built on first use in the form (MATCH_COMPILED_MBS or
+	 * MATCH_COMPILED_WCS) the pathnames come in, and is thrown away
+	 * whenever a pattern is added.
+	 */
+	int			 compiled;
+	struct match		**hash;
+	size_t			 hash_size;
+	size_t			 key_max;	/* Longest literal pattern. */
+	struct match		*globs;
 };
 
+#define MATCH_COMPILED_MBS	1
+#define MATCH_COMPILED_WCS	2
+/* Lists shorter than this are just scanned. */
+#define MATCH_HASH_MIN		16
+
 struct match_file {
 	struct archive_rb_node	 node;
 	struct match_file	*next;
@@ -154,8 +178,16 @@ static void	entry_list_add(struct entry_list *, struct match_file *);
 static void	entry_list_free(struct entry_list *);
 static void	entry_list_init(struct entry_list *);
 static int	error_nomem(struct archive_match *);
+static int	match_exclusion_literal(struct match_list *, int,
+		    const void *);
+static struct match *match_inclusion_literal(struct archive_match *, int,
+		    const void *, size_t, int);
 static void	match_list_add(struct match_list *, struct match *);
+static int	match_list_compile(struct archive_match *,
+		    struct match_list *, int);
 static void	match_list_free(struct match_list *);
+static struct match *match_list_lookup(struct match_list *, int,
+		    const void *, size_t, unsigned, struct match *);
 static void	match_list_init(struct match_list *);
 static int	match_list_unmatched_inclusions_next(struct archive_match *,
 		    struct match_list *, int, const void **);
@@ -174,6 +206,8 @@ static int	match_path_inclusion(struct archive_match *,
 static int	owner_excluded(struct archive_match *,
 		    struct archive_entry *);
 static int	path_excluded(struct archive_match *, int, const void *);
+static size_t	path_plain_length(int, const void *);
+static int	pattern_is_literal(int, const void *, size_t);
 static int	set_timefilter(struct archive_match *, int, time_t, long,
 		    time_t, long);
 static int	set_timefilter_pathname_mbs(struct archive_match *,
@@ -189,6 +223,19 @@ static int	validate_time_flag(struct archive *, int, const char *);
 
 #define get_date __archive_get_date
 
+/* Access to the i-th character of a narrow or wide string. */
+#define PCHAR(mbs, s, i)	((mbs) ?				\
+	(unsigned)(unsigned char)((const char *)(s))[i] :		\
+	(unsigned)((const wchar_t *)(s))[i])
+#define PADDR(mbs, s, i)	((mbs) ?				\
+	(const void *)((const char *)(s) + (i)) :			\
+	(const void *)((const wchar_t *)(s) + (i)))
+#define PSIZE(mbs)		((mbs) ? sizeof(char) : sizeof(wchar_t))
+
+/* FNV-1a over the characters of a literal pattern. */
+#define HASH_INIT		2166136261U
+#define HASH_STEP(h, c)		(((h) ^ (c)) * 16777619U)
+
 static const struct archive_rb_tree_ops rb_ops_mbs = {
 	cmp_node_mbs, cmp_key_mbs
 };
@@ -711,19 +758,41 @@ path_excluded(struct archive_match *a, int mbs, const void *pathname)
 {
 	struct match *match;
 	struct match *matched;
+	size_t len;
+	int incl_hash, excl_hash;
 	int r;
 
 	if (a == NULL)
 		return (0);
 
+	/*
+	 * Literal patterns are looked up in the hash tables, leaving
+	 * only the patterns with wildcards to be tried one by one.
+	 * Pathnames archive_pathmatch() would have to normalize ("./",
+	 * "//") go through the full lists instead.
+	 */
+	incl_hash = excl_hash = 0;
+	len = path_plain_length(mbs, pathname);
+	if (len != (size_t)-1) {
+		incl_hash = match_list_compile(a, &(a->inclusions), mbs);
+		if (incl_hash < 0)
+			return (incl_hash);
+		excl_hash = match_list_compile(a, &(a->exclusions), mbs);
+		if (excl_hash < 0)
+			return (excl_hash);
+	}
+
 	/* Mark off any unmatched inclusions. */
 	/* In particular, if a filename does appear in the archive and
 	 * is explicitly included and excluded, then we don't report
 	 * it as missing even though we don't extract it.
 	 */
 	matched = NULL;
-	for (match = a->inclusions.first; match != NULL;
-	    match = match->next){
+	if (incl_hash)
+		matched = match_inclusion_literal(a, mbs, pathname, len, 1);
+	for (match = incl_hash ? a->inclusions.globs : a->inclusions.first;
+	    match != NULL;
+	    match = incl_hash ? match->glob_next : match->next){
 		if (match->matches == 0 &&
 		    (r = match_path_inclusion(a, match, mbs, pathname)) != 0) {
 			if (r < 0)
@@ -735,8 +804,12 @@ path_excluded(struct archive_match *a, int mbs, const void *pathname)
 	}
 
 	/* Exclusions take priority */
-	for (match = a->exclusions.first; match != NULL;
-	    match = match->next){
+	if (excl_hash &&
+	    match_exclusion_literal(&(a->exclusions), mbs, pathname))
+		return (1);
+	for (match = excl_hash ? a->exclusions.globs : a->exclusions.first;
+	    match != NULL;
+	    match = excl_hash ? match->glob_next : match->next){
 		r = match_path_exclusion(a, match, mbs, pathname);
 		if (r)
 			return (r);
@@ -749,8 +822,12 @@ path_excluded(struct archive_match *a, int mbs, const void *pathname)
 
 
 	/* We didn't find an unmatched inclusion, check the remaining ones. */
-	for (match = a->inclusions.first; match != NULL;
-	    match = match->next){
+	if (incl_hash &&
+	    match_inclusion_literal(a, mbs, pathname, len, 0) != NULL)
+		return (0);
+	for (match = incl_hash ? a->inclusions.globs : a->inclusions.first;
+	    match != NULL;
+	    match = incl_hash ? match->glob_next : match->next){
 		/* We looked at previously-unmatched inclusions already. */
 		if (match->matches > 0 &&
 		    (r = match_path_inclusion(a, match, mbs, pathname)) != 0) {
@@ -769,6 +846,158 @@ path_excluded(struct archive_match *a, int mbs, const void *pathname)
 	return (0);
 }
 
+/*
+ * Return the length of a pathname that archive_pathmatch() would
+ * compare character by character against a literal pattern, or -1
+ * if it contains "//" or "." elements, which the matcher skips.
+ */
+static size_t
+path_plain_length(int mbs, const void *pn)
+{
+	size_t i;
+	unsigned c;
+
+	if (pn == NULL)
+		return ((size_t)-1);
+	if (PCHAR(mbs, pn, 0) == '.' && PCHAR(mbs, pn, 1) == '/')
+		return ((size_t)-1);
+	for (i = 0; (c = PCHAR(mbs, pn, i)) != '\0'; i++) {
+		if (c != '/')
+			continue;
+		c = PCHAR(mbs, pn, i + 1);
+		if (c == '/')
+			return ((size_t)-1);
+		if (c == '.' && (PCHAR(mbs, pn, i + 2) == '/' ||
+		    PCHAR(mbs, pn, i + 2) == '\0'))
+			return ((size_t)-1);
+	}
+	return (i);
+}
+
+/*
+ * A pattern is literal if archive_pathmatch() matches it only against
+ * the very same characters: no wildcards, escapes or anchors, and no
+ * "//" or "." elements.
+ */
+static int
+pattern_is_literal(int mbs, const void *p, size_t len)
+{
+	size_t i;
+	unsigned c;
+
+	if (len == 0)
+		return (0);
+	c = PCHAR(mbs, p, 0);
+	if (c == '^' || c == '/' || (c == '.' && len > 1 &&
+	    PCHAR(mbs, p, 1) == '/'))
+		return (0);
+	if (PCHAR(mbs, p, len - 1) == '$' || PCHAR(mbs, p, len - 1) == '/')
+		return (0);
+	for (i = 0; i < len; i++) {
+		switch (PCHAR(mbs, p, i)) {
+		case '*': case '?': case '[': case '\\':
+			return (0);
+		case '/':
+			c = PCHAR(mbs, p, i + 1);
+			if (c == '/')
+				return (0);
+			if (c == '.' && (i + 2 == len ||
+			    PCHAR(mbs, p, i + 2) == '/'))
+				return (0);
+			break;
+		}
+	}
+	return (1);
+}
+
+static struct match *
+match_list_lookup(struct match_list *list, int mbs, const void *s,
+    size_t len, unsigned hash, struct match *m)
+{
+	if (m == NULL)
+		m = list->hash[hash & (list->hash_size - 1)];
+	else
+		m = m->hash_next;
+	for (; m != NULL; m = m->hash_next) {
+		if (m->key_hash == hash && m->key_len == len &&
+		    memcmp(m->key, s, len * PSIZE(mbs)) == 0)
+			return (m);
+	}
+	return (NULL);
+}
+
+/*
+ * Exclusions are unanchored at both ends: a literal pattern excludes
+ * a pathname if it spells out any run of whole path elements.
+ */
+static int
+match_exclusion_literal(struct match_list *list, int mbs, const void *pn)
+{
+	size_t start, i;
+	unsigned c, h;
+
+	for (start = 0;;) {
+		h = HASH_INIT;
+		for (i = start;; i++) {
+			c = PCHAR(mbs, pn, i);
+			if ((c == '/' || c == '\0') && i > start &&
+			    match_list_lookup(list, mbs, PADDR(mbs, pn, start),
+			      i - start, h, NULL) != NULL)
+				return (1);
+			if (c == '\0' || i - start == list->key_max)
+				break;
+			h = HASH_STEP(h, c);
+		}
+		/* Try again from the next path element. */
+		for (i = start; (c = PCHAR(mbs, pn, i)) != '/'; i++) {
+			if (c == '\0')
+				return (0);
+		}
+		start = i + 1;
+	}
+}
+
+/*
+ * Inclusions are anchored at the start: a literal pattern includes
+ * the pathname itself ("dir" also matches "dir/") and, when recursion
+ * is enabled, everything below it.  The first pass marks off every
+ * matching pattern that has not matched before; the second pass
+ * stops at the first matching pattern that already has.
+ */
+static struct match *
+match_inclusion_literal(struct archive_match *a, int mbs, const void *pn,
+    size_t len, int unmatched)
+{
+	struct match_list *list = &(a->inclusions);
+	struct match *m, *found = NULL;
+	size_t i;
+	unsigned c, h;
+
+	if (len > 0 && PCHAR(mbs, pn, len - 1) == '/')
+		len--;
+	h = HASH_INIT;
+	for (i = 0; i <= len && i <= list->key_max; i++) {
+		c = PCHAR(mbs, pn, i);
+		if (i > 0 && (i == len || (c == '/' && a->recursive_include))) {
+			for (m = NULL; (m = match_list_lookup(list, mbs, pn, i,
+			    h, m)) != NULL;) {
+				if (!unmatched) {
+					if (m->matches > 0) {
+						m->matches++;
+						return (m);
+					}
+				} else if (m->matches == 0) {
+					list->unmatched_count--;
+					m->matches++;
+					found = m;
+				}
+			}
+		}
+		h = HASH_STEP(h, c);
+	}
+	return (found);
+}
+
 /*
  * This is a little odd, but it matches the default behavior of
  * gtar.  In particular, 'a*b' will match 'foo/a1111/222b/bar'
@@ -835,6 +1064,9 @@ match_list_init(struct match_list *list)
 	list->first = NULL;
 	list->last = &(list->first);
 	list->count = 0;
+	list->compiled = 0;
+	list->hash = NULL;
+	list->hash_size = 0;
 }
 
 static void
@@ -848,6 +1080,7 @@ match_list_free(struct match_list *list)
 		archive_mstring_clean(&(q->pattern));
 		free(q);
 	}
+	free(list->hash);
 }
 
 static void
@@ -857,6 +1090,80 @@ match_list_add(struct match_list *list, struct match *m)
 	list->last = &(m->next);
 	list->count++;
 	list->unmatched_count++;
+	list->compiled = 0;
+}
+
+/*
+ * Sort the patterns of a list into a hash table of literal patterns
+ * and a list of the remaining ones.  Returns 1 if the table can be
+ * used, 0 if the list is too short to bother.
+ */
+static int
+match_list_compile(struct archive_match *a, struct match_list *list,
+    int mbs)
+{
+	struct match *m, **last_glob;
+	const void *p;
+	size_t size, len, i;
+	unsigned h;
+	int r;
+
+	if (list->count < MATCH_HASH_MIN)
+		return (0);
+	if (list->compiled ==
+	    (mbs ? MATCH_COMPILED_MBS : MATCH_COMPILED_WCS))
+		return (1);
+
+	for (size = 64; size < (size_t)list->count * 2; size <<= 1)
+		;
+	if (size != list->hash_size) {
+		free(list->hash);
+		list->hash_size = 0;
+		list->hash = malloc(size * sizeof(*list->hash));
+		if (list->hash == NULL)
+			return (error_nomem(a));
+		list->hash_size = size;
+	}
+	memset(list->hash, 0, size * sizeof(*list->hash));
+	list->key_max = 0;
+	list->globs = NULL;
+	last_glob = &(list->globs);
+
+	for (m = list->first; m != NULL; m = m->next) {
+		m->hash_next = NULL;
+		m->glob_next = NULL;
+		if (mbs) {
+			const char *mp;
+			r = archive_mstring_get_mbs(&(a->archive),
+			    &(m->pattern), &mp);
+			p = mp;
+			len = (mp != NULL) ? strlen(mp) : 0;
+		} else {
+			const wchar_t *wp;
+			r = archive_mstring_get_wcs(&(a->archive),
+			    &(m->pattern), &wp);
+			p = wp;
+			len = (wp != NULL) ? wcslen(wp) : 0;
+		}
+		if (r != 0 || p == NULL || !pattern_is_literal(mbs, p, len)) {
+			/* Let match_path_*() deal with it. */
+			*last_glob = m;
+			last_glob = &(m->glob_next);
+			continue;
+		}
+		h = HASH_INIT;
+		for (i = 0; i < len; i++)
+			h = HASH_STEP(h, PCHAR(mbs, p, i));
+		m->key = p;
+		m->key_len = len;
+		m->key_hash = h;
+		m->hash_next = list->hash[h & (size - 1)];
+		list->hash[h & (size - 1)] = m;
+		if (len > list->key_max)
+			list->key_max = len;
+	}
+	list->compiled = mbs ? MATCH_COMPILED_MBS : MATCH_COMPILED_WCS;
+	return (1);
 }
 
 static int
@@ -0,0 +1,295 @@
+/*-
+ * Copyright (c) 2026 The libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "archive_platform.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#include <time.h>
+
+#include "archive.h"
+#include "archive_name_cache_private.h"
+#include "archive_private.h"
+
+/* Defaults; see archive_name_cache_set_limits(). */
+#define NAME_CACHE_DEFAULT_ENTRIES	4096
+#define NAME_CACHE_DEFAULT_TTL		600	/* seconds */
+#define NAME_CACHE_MIN_BUCKETS		64
+
+struct name_cache_entry {
+	struct name_cache_entry	*hnext;		/* Hash chain. */
+	struct name_cache_entry	*lru_prev;
+	struct name_cache_entry	*lru_next;
+	int64_t			 id;
+	time_t			 expires;
+	unsigned		 hash;
+	int			 kind;
+	int			 found;
+	char			*name;		/* Allocated with the entry. */
+};
+
+static struct {
+	struct name_cache_entry	**buckets;
+	size_t			  nbuckets;
+	/* lru_head is the most recently used entry. */
+	struct name_cache_entry	 *lru_head;
+	struct name_cache_entry	 *lru_tail;
+	size_t			  count;
+	size_t			  max_entries;
+	int			  ttl;
+} cache = {
+	NULL, 0, NULL, NULL, 0,
+	NAME_CACHE_DEFAULT_ENTRIES, NAME_CACHE_DEFAULT_TTL
+};
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t	name_cache_mtx = PTHREAD_MUTEX_INITIALIZER;
+#define	CACHE_LOCK()	pthread_mutex_lock(&name_cache_mtx)
+#define	CACHE_UNLOCK()	pthread_mutex_unlock(&name_cache_mtx)
+#else
+#define	CACHE_LOCK()
+#define	CACHE_UNLOCK()
+#endif
+
+/* Entries of these kinds are keyed by name, the others by id. */
+#define	KEYED_BY_NAME(kind)	((kind) == ARCHIVE_NAME_CACHE_UID || \
+				 (kind) == ARCHIVE_NAME_CACHE_GID)
+
+static unsigned
+id_hash(int kind, int64_t id)
+{
+	uint64_t h;
+
+	h = ((uint64_t)id ^ (uint64_t)kind << 56) *
+	    ARCHIVE_LITERAL_ULL(0x9E3779B97F4A7C15);
+	return ((unsigned)(h >> 32));
+}
+
+static unsigned
+name_hash(int kind, const char *p)
+{
+	/* 32-bit FNV-1a. */
+	unsigned h = 2166136261U ^ (unsigned)kind;
+
+	while (*p != '\0') {
+		h ^= (unsigned char)*p++;
+		h *= 16777619U;
+	}
+	return (h);
+}
+
+static void
+lru_unlink(struct name_cache_entry *e)
+{
+	if (e->lru_prev != NULL)
+		e->lru_prev->lru_next = e->lru_next;
+	else
+		cache.lru_head = e->lru_next;
+	if (e->lru_next != NULL)
+		e->lru_next->lru_prev = e->lru_prev;
+	else
+		cache.lru_tail = e->lru_prev;
+	e->lru_prev = e->lru_next = NULL;
+}
+
+static void
+lru_push_front(struct name_cache_entry *e)
+{
+	e->lru_prev = NULL;
+	e->lru_next = cache.lru_head;
+	if (cache.lru_head != NULL)
+		cache.lru_head->lru_prev = e;
+	else
+		cache.lru_tail = e;
+	cache.lru_head = e;
+}
+
+/* Must be called with the lock held. */
+static void
+cache_remove(struct name_cache_entry *e)
+{
+	struct name_cache_entry **pp;
+
+	pp = &cache.buckets[e->hash & (cache.nbuckets - 1)];
+	while (*pp != e)
+		pp = &(*pp)->hnext;
+	*pp = e->hnext;
+	lru_unlink(e);
+	cache.count--;
+	free(e);
+}
+
+static void
+cache_flush(void)
+{
+	while (cache.lru_tail != NULL)
+		cache_remove(cache.lru_tail);
+	free(cache.buckets);
+	cache.buckets = NULL;
+	cache.nbuckets = 0;
+}
+
+/*
+ * Find a live entry, dropping it if it has expired.  Must be called
+ * with the lock held.
+ */
+static struct name_cache_entry *
+cache_find(int kind, unsigned hash, int64_t id, const char *name)
+{
+	struct name_cache_entry *e;
+
+	if (cache.buckets == NULL)
+		return (NULL);
+	for (e = cache.buckets[hash & (cache.nbuckets - 1)]; e != NULL;
+	    e = e->hnext) {
+		if (e->hash != hash || e->kind != kind)
+			continue;
+		if (KEYED_BY_NAME(kind) ? strcmp(e->name, name) != 0 :
+		    e->id != id)
+			continue;
+		if (cache.ttl > 0 && time(NULL) >= e->expires) {
+			cache_remove(e);
+			return (NULL);
+		}
+		lru_unlink(e);
+		lru_push_front(e);
+		return (e);
+	}
+	return (NULL);
+}
+
+int
+__archive_name_cache_lookup_name(int kind, int64_t id,
+    struct archive_string *name)
+{
+	struct name_cache_entry *e;
+	int r = ARCHIVE_NAME_CACHE_MISS;
+
+	CACHE_LOCK();
+	e = cache_find(kind, id_hash(kind, id), id, NULL);
+	if (e != NULL) {
+		r = ARCHIVE_NAME_CACHE_NEGATIVE;
+		if (e->found) {
+			archive_strcpy(name, e->name);
+			r = ARCHIVE_NAME_CACHE_HIT;
+		}
+	}
+	CACHE_UNLOCK();
+	return (r);
+}
+
+int
+__archive_name_cache_lookup_id(int kind, const char *name, int64_t *id)
+{
+	struct name_cache_entry *e;
+	int r = ARCHIVE_NAME_CACHE_MISS;
+
+	CACHE_LOCK();
+	e = cache_find(kind, name_hash(kind, name), 0, name);
+	if (e != NULL) {
+		r = ARCHIVE_NAME_CACHE_NEGATIVE;
+		if (e->found) {
+			*id = e->id;
+			r = ARCHIVE_NAME_CACHE_HIT;
+		}
+	}
+	CACHE_UNLOCK();
+	return (r);
+}
+
+void
+__archive_name_cache_add(int kind, int64_t id, const char *name, int found)
+{
+	struct name_cache_entry *e, *old;
+	size_t len, n;
+	unsigned hash;
+
+	if (name == NULL)
+		name = "";
+	hash = KEYED_BY_NAME(kind) ? name_hash(kind, name) : id_hash(kind, id);
+	len = strlen(name);
+	e = malloc(sizeof(*e) + len + 1);
+	if (e == NULL)
+		return;
+	e->name = (char *)(e + 1);
+	memcpy(e->name, name, len + 1);
+	e->id = id;
+	e->hash = hash;
+	e->kind = kind;
+	e->found = found;
+
+	CACHE_LOCK();
+	if (cache.max_entries == 0) {
+		CACHE_UNLOCK();
+		free(e);
+		return;
+	}
+	if (cache.buckets == NULL) {
+		for (n = NAME_CACHE_MIN_BUCKETS;
+		    n < cache.max_entries && n < (SIZE_MAX >> 1); n <<= 1)
+			;
+		cache.buckets = calloc(n, sizeof(cache.buckets[0]));
+		if (cache.buckets == NULL) {
+			CACHE_UNLOCK();
+			free(e);
+			return;
+		}
+		cache.nbuckets = n;
+	}
+	/* Replace an older entry with the same key. */
+	old = cache_find(kind, hash, id, name);
+	if (old != NULL)
+		cache_remove(old);
+	while (cache.count >= cache.max_entries)
+		cache_remove(cache.lru_tail);
+	e->expires = time(NULL) + cache.ttl;
+	e->hnext = cache.buckets[hash & (cache.nbuckets - 1)];
+	cache.buckets[hash & (cache.nbuckets - 1)] = e;
+	lru_push_front(e);
+	cache.count++;
+	CACHE_UNLOCK();
+}
+
+int
+archive_name_cache_set_limits(size_t max_entries, int ttl)
+{
+	if (ttl < 0)
+		return (ARCHIVE_FAILED);
+	CACHE_LOCK();
+	/* The table is sized for the limit; start over. */
+	cache_flush();
+	cache.max_entries = max_entries;
+	cache.ttl = ttl;
+	CACHE_UNLOCK();
+	return (ARCHIVE_OK);
+}
@@ -0,0 +1,75 @@
+/*-
+ * Copyright (c) 2026 The libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef ARCHIVE_NAME_CACHE_PRIVATE_H_INCLUDED
+#define ARCHIVE_NAME_CACHE_PRIVATE_H_INCLUDED
+
+#ifndef __LIBARCHIVE_BUILD
+#error This header is only to be used internally to libarchive.
+#endif
+
+#include "archive_string.h"
+
+/*
+ * A process-wide cache of user and group name lookups.
+ *
+ * The standard lookup functions installed by
+ * archive_read_disk_set_standard_lookup() and
+ * archive_write_disk_set_standard_lookup() share this cache, so that
+ * every handle in the process benefits from a getpwuid()/getgrnam()
+ * call made by any other one.  Failed lookups are cached as well;
+ * with NSS backed by a directory service they tend to be the slowest.
+ * Entries expire after a configurable number of seconds.
+ */
+
+#define ARCHIVE_NAME_CACHE_UNAME	0	/* uid -> user name */
+#define ARCHIVE_NAME_CACHE_GNAME	1	/* gid -> group name */
+#define ARCHIVE_NAME_CACHE_UID		2	/* user name -> uid */
+#define ARCHIVE_NAME_CACHE_GID		3	/* group name -> gid */
+
+/* Return values of the lookup functions. */
+#define ARCHIVE_NAME_CACHE_MISS		(-1)
+#define ARCHIVE_NAME_CACHE_NEGATIVE	0	/* Cached "no such id/name". */
+#define ARCHIVE_NAME_CACHE_HIT		1
+
+/*
+ * Look up the name of `id'; on a hit the name is copied to `name',
+ * which stays valid however the cache changes afterwards.
+ */
+int	__archive_name_cache_lookup_name(int kind, int64_t id,
+	    struct archive_string *name);
+/* Look up the id of `name'. */
+int	__archive_name_cache_lookup_id(int kind, const char *name,
+	    int64_t *id);
+
+/*
+ * Record the result of a lookup; `found' is zero to remember that
+ * the id or name does not exist.
+ */
+void	__archive_name_cache_add(int kind, int64_t id, const char *name,
+	    int found);
+
+#endif /* ARCHIVE_NAME_CACHE_PRIVATE_H_INCLUDED */
@@ -302,7 +302,16 @@ archive_read_disk_entry_from_file(struct archive *_a,
 		if (r1 < r)
 			r = r1;
 	}
-	if ((a->flags & ARCHIVE_READDISK_NO_SPARSE) == 0) {
+	if ((a->flags & ARCHIVE_READDISK_NO_SPARSE) == 0
+#ifdef HAVE_STRUCT_STAT_ST_BLOCKS
+	    /*
+	     * A file that has a block allocated for every byte cannot
+	     * have holes; don't open it just to ask.
+	     */
+	    && (st == NULL || !S_ISREG(st->st_mode) ||
+		st->st_blocks < (st->st_size + 511) / 512)
+#endif
+	    ) {
 		r1 = setup_sparse(a, entry, &fd);
 		if (r1 < r)
 			r = r1;
@@ -840,7 +849,8 @@ setup_xattrs(struct archive_read_disk *a,
  * of logical file blocks.  We also need to be very careful to use
  * FIEMAP_FLAG_SYNC here, since there are reports that Linux sometimes
  * does not report allocations for newly-written data that hasn't
- * been synced to disk.
+ * been synced to disk.  ARCHIVE_READDISK_NO_SPARSE_SYNC skips the sync
+ * for callers that would rather not force a writeback of every file.
  *
  * It's important to return a minimal sparse file list because we want
  * to not trigger sparse file extensions if we don't have to, since
@@ -888,7 +898,10 @@ setup_sparse_fiemap(struct archive_read_disk *a,
 	fm = (struct fiemap *)buff;
 	fm->fm_start = 0;
 	fm->fm_length = ~0ULL;;
-	fm->fm_flags = FIEMAP_FLAG_SYNC;
+	if (a->flags & ARCHIVE_READDISK_NO_SPARSE_SYNC)
+		fm->fm_flags = 0;
+	else
+		fm->fm_flags = FIEMAP_FLAG_SYNC;
 	fm->fm_extent_count = count;
 	do_fiemap = 1;
 	size = archive_entry_size(entry);
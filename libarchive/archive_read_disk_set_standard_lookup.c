@@ -45,6 +45,7 @@
 #endif
 
 #include "archive.h"
+#include "archive_name_cache_private.h"
 
 #if defined(_WIN32) && !defined(__CYGWIN__)
 int
@@ -54,21 +55,13 @@ archive_read_disk_set_standard_lookup(struct archive *a)
 	return (ARCHIVE_FATAL);
 }
 #else /* ! (_WIN32 && !__CYGWIN__) */
-#define	name_cache_size 127
-
-static const char * const NO_NAME = "(noname)";
-
 struct name_cache {
 	struct archive *archive;
+	int	kind;
 	char   *buff;
 	size_t  buff_size;
-	int	probes;
-	int	hits;
-	size_t	size;
-	struct {
-		id_t id;
-		const char *name;
-	} cache[name_cache_size];
+	/* The last name returned; private to this handle. */
+	struct archive_string name;
 };
 
 static const char *	lookup_gname(void *, int64_t);
@@ -79,12 +72,15 @@ static const char *	lookup_uname_helper(struct name_cache *, id_t uid);
 
 /*
  * Installs functions that use getpwuid()/getgrgid()---along with
- * a simple cache to accelerate such lookups---into the archive_read_disk
+ * a cache to accelerate such lookups---into the archive_read_disk
  * object.  This is in a separate file because getpwuid()/getgrgid()
  * can pull in a LOT of library code (including NIS/LDAP functions, which
  * pull in DNS resolvers, etc).  This can easily top 500kB, which makes
  * it inappropriate for some space-constrained applications.
  *
+ * The cache itself is shared by every handle in the process; see
+ * archive_name_cache.c.
+ *
  * Applications that are size-sensitive may want to just use the
  * real default functions (defined in archive_read_disk.c) that just
  * use the uid/gid without the lookup.  Or define your own custom functions
@@ -93,8 +89,8 @@ static const char *	lookup_uname_helper(struct name_cache *, id_t uid);
 int
 archive_read_disk_set_standard_lookup(struct archive *a)
 {
-	struct name_cache *ucache = malloc(sizeof(struct name_cache));
-	struct name_cache *gcache = malloc(sizeof(struct name_cache));
+	struct name_cache *ucache = calloc(1, sizeof(struct name_cache));
+	struct name_cache *gcache = calloc(1, sizeof(struct name_cache));
 
 	if (ucache == NULL || gcache == NULL) {
 		archive_set_error(a, ENOMEM,
@@ -104,12 +100,10 @@ archive_read_disk_set_standard_lookup(struct archive *a)
 		return (ARCHIVE_FATAL);
 	}
 
-	memset(ucache, 0, sizeof(*ucache));
 	ucache->archive = a;
-	ucache->size = name_cache_size;
-	memset(gcache, 0, sizeof(*gcache));
+	ucache->kind = ARCHIVE_NAME_CACHE_UNAME;
 	gcache->archive = a;
-	gcache->size = name_cache_size;
+	gcache->kind = ARCHIVE_NAME_CACHE_GNAME;
 
 	archive_read_disk_set_gname_lookup(a, gcache, lookup_gname, cleanup);
 	archive_read_disk_set_uname_lookup(a, ucache, lookup_uname, cleanup);
@@ -121,56 +115,38 @@ static void
 cleanup(void *data)
 {
 	struct name_cache *cache = (struct name_cache *)data;
-	size_t i;
 
 	if (cache != NULL) {
-		for (i = 0; i < cache->size; i++) {
-			if (cache->cache[i].name != NULL &&
-			    cache->cache[i].name != NO_NAME)
-				free((void *)(uintptr_t)cache->cache[i].name);
-		}
+		archive_string_free(&cache->name);
 		free(cache->buff);
 		free(cache);
 	}
 }
 
 /*
- * Lookup uid/gid from uname/gname, return NULL if no match.
+ * Lookup uname/gname from uid/gid, return NULL if no match.
  */
 static const char *
 lookup_name(struct name_cache *cache,
     const char * (*lookup_fn)(struct name_cache *, id_t), id_t id)
 {
 	const char *name;
-	int slot;
-
 
-	cache->probes++;
-
-	slot = id % cache->size;
-	if (cache->cache[slot].name != NULL) {
-		if (cache->cache[slot].id == id) {
-			cache->hits++;
-			if (cache->cache[slot].name == NO_NAME)
-				return (NULL);
-			return (cache->cache[slot].name);
-		}
-		if (cache->cache[slot].name != NO_NAME)
-			free((void *)(uintptr_t)cache->cache[slot].name);
-		cache->cache[slot].name = NULL;
+	switch (__archive_name_cache_lookup_name(cache->kind, id,
+	    &cache->name)) {
+	case ARCHIVE_NAME_CACHE_HIT:
+		return (cache->name.s);
+	case ARCHIVE_NAME_CACHE_NEGATIVE:
+		return (NULL);
 	}
 
 	name = (lookup_fn)(cache, id);
-	if (name == NULL) {
-		/* Cache and return the negative response. */
-		cache->cache[slot].name = NO_NAME;
-		cache->cache[slot].id = id;
+	/* Cache negative responses as well. */
+	__archive_name_cache_add(cache->kind, id, name, name != NULL);
+	if (name == NULL)
 		return (NULL);
-	}
-
-	cache->cache[slot].name = name;
-	cache->cache[slot].id = id;
-	return (cache->cache[slot].name);
+	archive_strcpy(&cache->name, name);
+	return (cache->name.s);
 }
 
 static const char *
@@ -224,7 +200,7 @@ lookup_uname_helper(struct name_cache *cache, id_t id)
 	if (result == NULL)
 		return (NULL);
 
-	return strdup(result->pw_name);
+	return (result->pw_name);
 }
 #else
 static const char *
@@ -238,7 +214,7 @@ lookup_uname_helper(struct name_cache *cache, id_t id)
 	if (result == NULL)
 		return (NULL);
 
-	return strdup(result->pw_name);
+	return (result->pw_name);
 }
 #endif
 
@@ -291,7 +267,7 @@ lookup_gname_helper(struct name_cache *cache, id_t id)
 	if (result == NULL)
 		return (NULL);
 
-	return strdup(result->gr_name);
+	return (result->gr_name);
 }
 #else
 static const char *
@@ -305,7 +281,7 @@ lookup_gname_helper(struct name_cache *cache, id_t id)
 	if (result == NULL)
 		return (NULL);
 
-	return strdup(result->gr_name);
+	return (result->gr_name);
 }
 #endif
 
@@ -90,12 +90,17 @@ archive_read_open_fd(struct archive *a, int fd, size_t block_size)
 	 * that supports lseek().  On FreeBSD, only regular files and
 	 * raw disk devices support lseek() and there's no portable
 	 * way to determine if a device is a raw disk device, so we
-	 * only enable this optimization for regular files.
+	 * only enable this optimization for regular files and, on
+	 * Linux, where all block devices can seek, for block devices.
 	 */
 	if (S_ISREG(st.st_mode)) {
 		archive_read_extract_set_skip_file(a, st.st_dev, st.st_ino);
 		mine->use_lseek = 1;
 	}
+#if defined(__linux__)
+	else if (S_ISBLK(st.st_mode))
+		mine->use_lseek = 1;
+#endif
 #if defined(__CYGWIN__) || defined(_WIN32)
 	setmode(mine->fd, O_BINARY);
 #endif
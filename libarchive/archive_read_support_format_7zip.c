@@ -28,6 +28,9 @@
 #ifdef HAVE_ERRNO_H
 #include <errno.h>
 #endif
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
@@ -45,11 +48,13 @@
 #endif
 
 #include "archive.h"
+#include "archive_digest_private.h"
 #include "archive_entry.h"
 #include "archive_entry_locale.h"
 #include "archive_ppmd7_private.h"
 #include "archive_private.h"
 #include "archive_read_private.h"
+#include "archive_solid_cache_private.h"
 #include "archive_endian.h"
 
 #ifndef HAVE_ZLIB_H
@@ -365,6 +370,18 @@ struct _7zip {
 
 	/* Custom value that is non-zero if this archive contains encrypted entries. */
 	int			 has_encrypted_entries;
+
+	/*
+	 * Decoded folders shared with other read handles through the
+	 * solid cache; the "solid-cache" option sets the size of the
+	 * largest folder this handle caches, zero disabling it.
+	 */
+	size_t			 solid_cache;
+	struct archive_solid_cache_entry *folder_cache;
+	unsigned char		*folder_cache_buff;
+	const unsigned char	*folder_cache_pointer;
+	size_t			 folder_cache_remaining;
+	int			 folder_cache_filling;
 };
 
 /* Maximum entry size. This limitation prevents reading intentional
@@ -376,6 +393,8 @@ static int	archive_read_format_7zip_has_encrypted_entries(struct archive_read *)
 static int	archive_read_support_format_7zip_capabilities(struct archive_read *a);
 static int	archive_read_format_7zip_bid(struct archive_read *, int);
 static int	archive_read_format_7zip_cleanup(struct archive_read *);
+static int	archive_read_format_7zip_options(struct archive_read *,
+		    const char *, const char *);
 static int	archive_read_format_7zip_read_data(struct archive_read *,
 		    const void **, size_t *, int64_t *);
 static int	archive_read_format_7zip_read_data_skip(struct archive_read *);
@@ -389,6 +408,10 @@ static int	decompress(struct archive_read *, struct _7zip *,
 		    void *, size_t *, const void *, size_t *);
 static ssize_t	extract_pack_stream(struct archive_read *, size_t);
 static void	fileTimeToUtc(uint64_t, time_t *, long *);
+static int	folder_cache_key(struct archive_read *,
+		    const struct _7z_folder *, struct archive_solid_cache_key *);
+static int	folder_cache_valid(const struct _7z_folder *, uint64_t,
+		    const unsigned char *, size_t);
 static uint64_t folder_uncompressed_size(struct _7z_folder *);
 static void	free_CodersInfo(struct _7z_coders_info *);
 static void	free_Digest(struct _7z_digests *);
@@ -405,6 +428,7 @@ static int	init_decompression(struct archive_read *, struct _7zip *,
 		    const struct _7z_coder *, const struct _7z_coder *);
 static int	parse_7zip_uint64(struct archive_read *, uint64_t *);
 static int	read_Bools(struct archive_read *, unsigned char *, size_t);
+static int	read_cached_folder(struct archive_read *, uint64_t);
 static int	read_CodersInfo(struct archive_read *,
 		    struct _7z_coders_info *);
 static int	read_Digests(struct archive_read *, struct _7z_digests *,
@@ -465,7 +489,7 @@ archive_read_support_format_7zip(struct archive *_a)
 	    zip,
 	    "7zip",
 	    archive_read_format_7zip_bid,
-	    NULL,
+	    archive_read_format_7zip_options,
 	    archive_read_format_7zip_read_header,
 	    archive_read_format_7zip_read_data,
 	    archive_read_format_7zip_read_data_skip,
@@ -500,6 +524,36 @@ archive_read_format_7zip_has_encrypted_entries(struct archive_read *_a)
 	return ARCHIVE_READ_FORMAT_ENCRYPTION_DONT_KNOW;
 }
 
+static int
+archive_read_format_7zip_options(struct archive_read *a,
+    const char *key, const char *val)
+{
+	struct _7zip *zip = (struct _7zip *)a->format->data;
+	size_t limit;
+
+	if (strcmp(key, "solid-cache") == 0) {
+		/* Only this handle is affected; the size of the cache
+		 * shared by all of them is set with
+		 * archive_solid_cache_set_limit(). */
+		if (val == NULL || val[0] == 0) {
+			zip->solid_cache = 0;
+			return (ARCHIVE_OK);
+		}
+		if (__archive_solid_cache_parse_size(val, &limit) != 0) {
+			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+			    "7zip: invalid solid-cache size `%s'", val);
+			return (ARCHIVE_FAILED);
+		}
+		zip->solid_cache = limit;
+		return (ARCHIVE_OK);
+	}
+
+	/* Note: The "warn" return is just to inform the options
+	 * supervisor that we didn't handle it.  It will generate
+	 * a suitable error if no one used this option. */
+	return (ARCHIVE_WARN);
+}
+
 static int
 archive_read_format_7zip_bid(struct archive_read *a, int best_bid)
 {
@@ -957,6 +1011,8 @@ archive_read_format_7zip_cleanup(struct archive_read *a)
 	struct _7zip *zip;
 
 	zip = (struct _7zip *)(a->format->data);
+	__archive_solid_cache_release(zip->folder_cache);
+	free(zip->folder_cache_buff);
 	free_StreamsInfo(&(zip->si));
 	free(zip->entries);
 	free(zip->entry_names);
@@ -3376,6 +3432,23 @@ read_stream(struct archive_read *a, const void **buff, size_t size,
 	uint64_t skip_bytes = 0;
 	ssize_t r;
 
+	if (zip->folder_cache_pointer != NULL) {
+		/* Serve the current folder from the solid cache. */
+		if (zip->folder_cache_remaining > 0) {
+			if (size > zip->folder_cache_remaining)
+				size = zip->folder_cache_remaining;
+			*buff = zip->folder_cache_pointer;
+			zip->folder_cache_pointer += size;
+			zip->folder_cache_remaining -= size;
+			return ((ssize_t)size);
+		}
+		__archive_solid_cache_release(zip->folder_cache);
+		free(zip->folder_cache_buff);
+		zip->folder_cache = NULL;
+		zip->folder_cache_buff = NULL;
+		zip->folder_cache_pointer = NULL;
+	}
+
 	if (zip->uncompressed_buffer_bytes_remaining == 0) {
 		if (zip->pack_stream_inbytes_remaining > 0) {
 			r = extract_pack_stream(a, 0);
@@ -3396,7 +3469,7 @@ read_stream(struct archive_read *a, const void **buff, size_t size,
 	 * Current pack stream has been consumed.
 	 */
 	if (zip->pack_stream_remaining == 0) {
-		if (zip->header_is_being_read) {
+		if (zip->header_is_being_read || zip->folder_cache_filling) {
 			/* Invalid sequence. This might happen when
 			 * reading a malformed archive. */
 			archive_set_error(&(a->archive),
@@ -3423,6 +3496,15 @@ read_stream(struct archive_read *a, const void **buff, size_t size,
 			*buff = NULL;
 			return (0);
 		}
+		if (zip->solid_cache) {
+			r = read_cached_folder(a, skip_bytes);
+			if (r < 0)
+				return (r);
+			if (r > 0) {
+				zip->folder_index++;
+				return (read_stream(a, buff, size, minimum));
+			}
+		}
 		r = setup_decode_folder(a,
 			&(zip->si.ci.folders[zip->folder_index]), 0);
 		if (r != ARCHIVE_OK)
@@ -3478,6 +3560,227 @@ read_stream(struct archive_read *a, const void **buff, size_t size,
 	return (get_uncompressed_data(a, buff, size, minimum));
 }
 
+static void
+sha256_update_u64(archive_sha256_ctx *ctx, uint64_t v)
+{
+	unsigned char b[8];
+
+	archive_le64enc(b, v);
+	archive_sha256_update(ctx, b, sizeof(b));
+}
+
+/*
+ * Compute the solid cache key of a folder: a SHA-256 digest of its coder
+ * definitions and of its packed streams, which are read and consumed to
+ * do so.  Returns ARCHIVE_FAILED if no digest is available.
+ */
+static int
+folder_cache_key(struct archive_read *a, const struct _7z_folder *folder,
+    struct archive_solid_cache_key *key)
+{
+	struct _7zip *zip = (struct _7zip *)a->format->data;
+	archive_sha256_ctx ctx;
+	const struct _7z_coder *coder;
+	const void *p;
+	uint64_t i, j, pack_index, remaining;
+	int64_t pack_offset;
+	ssize_t bytes;
+
+	if (archive_sha256_init(&ctx) != ARCHIVE_OK)
+		return (ARCHIVE_FAILED);
+	if (zip->pack_stream_bytes_unconsumed)
+		read_consume(a);
+
+	sha256_update_u64(&ctx, folder->numCoders);
+	for (i = 0; i < folder->numCoders; i++) {
+		coder = &(folder->coders[i]);
+		sha256_update_u64(&ctx, coder->codec);
+		sha256_update_u64(&ctx, coder->numInStreams);
+		sha256_update_u64(&ctx, coder->numOutStreams);
+		sha256_update_u64(&ctx, coder->propertiesSize);
+		if (coder->propertiesSize > 0)
+			archive_sha256_update(&ctx, coder->properties,
+			    (size_t)coder->propertiesSize);
+	}
+	sha256_update_u64(&ctx, folder->numBindPairs);
+	for (i = 0; i < folder->numBindPairs; i++) {
+		sha256_update_u64(&ctx, folder->bindPairs[i].inIndex);
+		sha256_update_u64(&ctx, folder->bindPairs[i].outIndex);
+	}
+	sha256_update_u64(&ctx, folder->numPackedStreams);
+	for (i = 0; i < folder->numPackedStreams; i++)
+		sha256_update_u64(&ctx, folder->packedStreams[i]);
+	for (i = 0; i < folder->numOutStreams; i++)
+		sha256_update_u64(&ctx, folder->unPackSize[i]);
+
+	for (i = 0; i < folder->numPackedStreams; i++) {
+		pack_index = folder->packIndex + i;
+		remaining = zip->si.pi.sizes[pack_index];
+		sha256_update_u64(&ctx, remaining);
+		pack_offset = zip->si.pi.positions[pack_index];
+		if (zip->stream_offset != pack_offset) {
+			if (0 > __archive_read_seek(a,
+			    pack_offset + zip->seek_base, SEEK_SET))
+				goto fatal;
+			zip->stream_offset = pack_offset;
+		}
+		for (j = 0; j < remaining; j += bytes) {
+			p = __archive_read_ahead(a, 1, &bytes);
+			if (p == NULL) {
+				archive_set_error(&a->archive,
+				    ARCHIVE_ERRNO_FILE_FORMAT,
+				    "Truncated 7-Zip file body");
+				goto fatal;
+			}
+			if ((uint64_t)bytes > remaining - j)
+				bytes = (ssize_t)(remaining - j);
+			archive_sha256_update(&ctx, p, bytes);
+			__archive_read_consume(a, bytes);
+			zip->stream_offset += bytes;
+		}
+	}
+
+	memset(key, 0, sizeof(*key));
+	key->format = ARCHIVE_SOLID_CACHE_7ZIP;
+	archive_sha256_final(&ctx, key->digest);
+	return (ARCHIVE_OK);
+fatal:
+	archive_sha256_final(&ctx, key->digest);
+	return (ARCHIVE_FATAL);
+}
+
+/*
+ * Check decoded folder data before it is served or cached.
+ */
+static int
+folder_cache_valid(const struct _7z_folder *folder, uint64_t folder_size,
+    const unsigned char *data, size_t size)
+{
+	uint32_t crc = 0;
+	size_t n;
+
+	if (size != folder_size)
+		return (0);
+	if (!folder->digest_defined)
+		return (1);
+	while (size > 0) {
+		n = size > UINT_MAX ? UINT_MAX : size;
+		crc = crc32(crc, data, (unsigned)n);
+		data += n;
+		size -= n;
+	}
+	return (crc == folder->digest);
+}
+
+/*
+ * Look up the folder about to be decoded in the solid cache, decoding
+ * and inserting the whole folder on a miss.  On success the folder is
+ * served from the cache, positioned `skip_bytes' into its data, and 1 is
+ * returned.  Returns 0 if the folder should be decoded as usual.
+ */
+static int
+read_cached_folder(struct archive_read *a, uint64_t skip_bytes)
+{
+	struct _7zip *zip = (struct _7zip *)a->format->data;
+	struct _7z_folder *folder = &(zip->si.ci.folders[zip->folder_index]);
+	struct archive_solid_cache_key key;
+	struct archive_solid_cache_entry *ce;
+	unsigned char *data;
+	uint64_t folder_size;
+	size_t filled, cached_size;
+	ssize_t bytes;
+	const void *p;
+	int r;
+
+	folder_size = folder_uncompressed_size(folder);
+	if (folder_size == 0 || folder_size > zip->solid_cache ||
+	    folder_size > __archive_solid_cache_limit())
+		return (0);
+	/* The key is computed from the packed streams; on a miss they
+	 * have to be read again to decode them. */
+	if (!a->filter->can_seek)
+		return (0);
+
+	r = folder_cache_key(a, folder, &key);
+	if (r != ARCHIVE_OK)
+		return (r == ARCHIVE_FATAL ? ARCHIVE_FATAL : 0);
+
+	ce = __archive_solid_cache_get(&key);
+	if (ce != NULL) {
+		data = __archive_solid_cache_data(ce, &cached_size);
+		if (!folder_cache_valid(folder, folder_size, data,
+		    cached_size)) {
+			__archive_solid_cache_release(ce);
+			ce = NULL;
+		}
+	}
+	if (ce == NULL) {
+		data = malloc((size_t)folder_size);
+		if (data == NULL)
+			return (0);
+		r = setup_decode_folder(a, folder, 0);
+		if (r == ARCHIVE_OK)
+			r = seek_pack(a);
+		if (r == ARCHIVE_OK)
+			r = (int)extract_pack_stream(a, 0);
+		if (r < 0) {
+			free(data);
+			return (ARCHIVE_FATAL);
+		}
+		zip->folder_cache_filling = 1;
+		for (filled = 0; filled < folder_size; filled += bytes) {
+			bytes = read_stream(a, &p,
+			    (size_t)(folder_size - filled), 0);
+			if (bytes <= 0)
+				break;
+			memcpy(data + filled, p, bytes);
+			if (zip->pack_stream_bytes_unconsumed)
+				read_consume(a);
+		}
+		zip->folder_cache_filling = 0;
+		if (filled < folder_size) {
+			free(data);
+			if (bytes == 0)
+				archive_set_error(&a->archive,
+				    ARCHIVE_ERRNO_FILE_FORMAT,
+				    "Truncated 7-Zip file body");
+			return (ARCHIVE_FATAL);
+		}
+		/* Do not cache a folder that fails its CRC; the entry
+		 * CRC checks will report the damage. */
+		if (folder_cache_valid(folder, folder_size, data,
+		    (size_t)folder_size))
+			ce = __archive_solid_cache_put(&key, data,
+			    (size_t)folder_size, free);
+		if (ce == NULL) {
+			/* The cache refused it; serve our own copy. */
+			zip->folder_cache_buff = data;
+		}
+	}
+
+	zip->folder_cache = ce;
+	if (ce != NULL)
+		zip->folder_cache_pointer = __archive_solid_cache_data(ce,
+		    &cached_size);
+	else {
+		zip->folder_cache_pointer = zip->folder_cache_buff;
+		cached_size = (size_t)folder_size;
+	}
+	if (skip_bytes > cached_size) {
+		archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
+		    "Truncated 7-Zip file body");
+		return (ARCHIVE_FATAL);
+	}
+	zip->folder_cache_pointer += skip_bytes;
+	zip->folder_cache_remaining = cached_size - (size_t)skip_bytes;
+	/* Nothing is left to decode for this folder. */
+	zip->pack_stream_remaining = 0;
+	zip->pack_stream_inbytes_remaining = 0;
+	zip->folder_outbytes_remaining = 0;
+	zip->uncompressed_buffer_bytes_remaining = 0;
+	return (1);
+}
+
 static int
 setup_decode_folder(struct archive_read *a, struct _7z_folder *folder,
     int header)
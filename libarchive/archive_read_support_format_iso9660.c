@@ -256,24 +256,28 @@ struct content {
 	struct content	*next;
 };
 
-/* In-memory storage for a directory record. */
+/*
+ * In-memory storage for a directory record.
+ *
+ * An image can have millions of these pending at once, so the members
+ * are ordered to avoid padding and the flags are bit-fields.  A record
+ * is released as soon as it has been returned to the client and none
+ * of its children are left; see release_file().
+ */
 struct file_info {
 	struct file_info	*use_next;
+	struct file_info	**use_prev;
 	struct file_info	*parent;
 	struct file_info	*next;
 	struct file_info	*re_next;
 	int		 subdirs;
+	int		 refcount;	/* Own use plus live children.	*/
 	uint64_t	 key;		/* Heap Key.			*/
 	uint64_t	 offset;	/* Offset on disk.		*/
 	uint64_t	 size;		/* File size in bytes.		*/
 	uint32_t	 ce_offset;	/* Offset of CE.		*/
 	uint32_t	 ce_size;	/* Size of CE.			*/
-	char		 rr_moved;	/* Flag to rr_moved.		*/
-	char		 rr_moved_has_re_only;
-	char		 re;		/* Having RRIP "RE" extension.	*/
-	char		 re_descendant;
 	uint64_t	 cl_offset;	/* Having RRIP "CL" extension.	*/
-	int		 birthtime_is_set;
 	time_t		 birthtime;	/* File created time.		*/
 	time_t		 mtime;		/* File last modified time.	*/
 	time_t		 atime;		/* File last accessed time.	*/
@@ -282,20 +286,25 @@ struct file_info {
 	mode_t		 mode;
 	uid_t		 uid;
 	gid_t		 gid;
-	int64_t		 number;
 	int		 nlinks;
+	int64_t		 number;
 	struct archive_string name; /* Pathname */
 	unsigned char	*utf16be_name;
 	size_t		 utf16be_bytes;
-	char		 name_continues; /* Non-zero if name continues */
 	struct archive_string symlink;
-	char		 symlink_continues; /* Non-zero if link continues */
-	/* Set 1 if this file compressed by paged zlib(zisofs) */
-	int		 pz;
-	int		 pz_log2_bs; /* Log2 of block size */
 	uint64_t	 pz_uncompressed_size;
+	unsigned char	 pz_log2_bs; /* Log2 of block size */
+	unsigned	 rr_moved:1;	/* Flag to rr_moved.		*/
+	unsigned	 rr_moved_has_re_only:1;
+	unsigned	 re:1;		/* Having RRIP "RE" extension.	*/
+	unsigned	 re_descendant:1;
+	unsigned	 birthtime_is_set:1;
+	unsigned	 name_continues:1; /* Non-zero if name continues */
+	unsigned	 symlink_continues:1; /* Non-zero if link continues */
+	/* Set 1 if this file compressed by paged zlib(zisofs) */
+	unsigned	 pz:1;
 	/* Set 1 if this file is multi extent. */
-	int		 multi_extent;
+	unsigned	 multi_extent:1;
 	struct {
 		struct content	*first;
 		struct content	**last;
@@ -339,6 +348,8 @@ struct iso9660 {
 	struct archive_string previous_pathname;
 
 	struct file_info		*use_files;
+	/* The file returned by the last read_header. */
+	struct file_info		*entry_file;
 	struct heap_queue		 pending_files;
 	struct {
 		struct file_info	*first;
@@ -425,6 +436,7 @@ static void	parse_rockridge_TF1(struct file_info *,
 static void	parse_rockridge_ZF1(struct file_info *,
 		    const unsigned char *, int);
 static void	register_file(struct iso9660 *, struct file_info *);
+static void	release_file(struct file_info *);
 static void	release_files(struct iso9660 *);
 static unsigned	toi(const void *p, int n);
 static inline void re_add_entry(struct iso9660 *, struct file_info *);
@@ -1059,6 +1071,8 @@ read_children(struct archive_read *a, struct file_info *parent)
 					multi->size += child->size;
 					if (!child->multi_extent)
 						multi = NULL;
+					/* Only its extent was needed. */
+					release_file(child);
 				}
 			} else
 				if (add_entry(a, iso9660, child) != ARCHIVE_OK)
@@ -1184,11 +1198,19 @@ archive_read_format_iso9660_read_header(struct archive_read *a,
 			return (r);
 	}
 
+	/* The previous entry is no longer needed. */
+	if (iso9660->entry_file != NULL) {
+		iso9660->entry_content = NULL;
+		release_file(iso9660->entry_file);
+		iso9660->entry_file = NULL;
+	}
+
 	file = NULL;/* Eliminate a warning. */
 	/* Get the next entry that appears after the current offset. */
 	r = next_entry_seek(a, iso9660, &file);
 	if (r != ARCHIVE_OK)
 		return (r);
+	iso9660->entry_file = file;
 
 	if (iso9660->seenJoliet) {
 		/*
@@ -1980,6 +2002,8 @@ parse_file_info(struct archive_read *a, struct file_info *parent,
 		    (strcmp(file->name.s, "rr_moved") == 0 ||
 		     strcmp(file->name.s, ".rr_moved") == 0)) {
 			iso9660->rr_moved = file;
+			/* Kept until the end; it may be exposed last. */
+			file->refcount++;
 			file->rr_moved = 1;
 			file->rr_moved_has_re_only = 1;
 			file->re = 0;
@@ -2320,6 +2344,9 @@ register_CE(struct archive_read *a, int32_t location,
 		heap->allocated = new_size;
 	}
 
+	/* The file has to stay until its "CE" data is read. */
+	file->refcount++;
+
 	/*
 	 * Start with hole at end, walk it up tree to find insertion point.
 	 */
@@ -2418,6 +2445,7 @@ read_CE(struct archive_read *a, struct iso9660 *iso9660)
 			end = p + file->ce_size;
 			next_CE(heap);
 			r = parse_rockridge(a, file, p, end);
+			release_file(file);
 			if (r != ARCHIVE_OK)
 				return (ARCHIVE_FATAL);
 		} while (heap->cnt &&
@@ -2654,31 +2682,66 @@ register_file(struct iso9660 *iso9660, struct file_info *file)
 {
 
 	file->use_next = iso9660->use_files;
+	if (file->use_next != NULL)
+		file->use_next->use_prev = &(file->use_next);
+	file->use_prev = &(iso9660->use_files);
 	iso9660->use_files = file;
+	/* The reference for the file itself is dropped once it has been
+	 * returned to the client. */
+	file->refcount++;
+	if (file->parent != NULL)
+		file->parent->refcount++;
 }
 
 static void
-release_files(struct iso9660 *iso9660)
+free_file(struct file_info *file)
 {
 	struct content *con, *connext;
+
+	archive_string_free(&file->name);
+	archive_string_free(&file->symlink);
+	free(file->utf16be_name);
+	con = file->contents.first;
+	while (con != NULL) {
+		connext = con->next;
+		free(con);
+		con = connext;
+	}
+	free(file);
+}
+
+/*
+ * Drop a reference to a file, freeing it, and then its ancestors,
+ * as their last references go away.
+ */
+static void
+release_file(struct file_info *file)
+{
+	struct file_info *parent;
+
+	while (file != NULL && --file->refcount == 0) {
+		parent = file->parent;
+		*file->use_prev = file->use_next;
+		if (file->use_next != NULL)
+			file->use_next->use_prev = file->use_prev;
+		free_file(file);
+		file = parent;
+	}
+}
+
+static void
+release_files(struct iso9660 *iso9660)
+{
 	struct file_info *file;
 
 	file = iso9660->use_files;
 	while (file != NULL) {
 		struct file_info *next = file->use_next;
 
-		archive_string_free(&file->name);
-		archive_string_free(&file->symlink);
-		free(file->utf16be_name);
-		con = file->contents.first;
-		while (con != NULL) {
-			connext = con->next;
-			free(con);
-			con = connext;
-		}
-		free(file);
+		free_file(file);
 		file = next;
 	}
+	iso9660->use_files = NULL;
 }
 
 static int
@@ -2762,7 +2825,7 @@ next_cache_entry(struct archive_read *a, struct iso9660 *iso9660,
 		}
 
 		if (file->cl_offset) {
-			struct file_info *first_re = NULL;
+			struct file_info *first_re = NULL, *cl = file;
 			int nexted_re = 0;
 
 			/*
@@ -2775,6 +2838,8 @@ next_cache_entry(struct archive_read *a, struct iso9660 *iso9660,
 					first_re = re;
 				if (re->offset == file->cl_offset) {
 					re->parent->subdirs--;
+					file->parent->refcount++;
+					release_file(re->parent);
 					re->parent = file->parent;
 					re->re = 0;
 					if (re->parent->re_descendant) {
@@ -2803,6 +2868,10 @@ next_cache_entry(struct archive_read *a, struct iso9660 *iso9660,
 				} else
 					re_add_entry(iso9660, re);
 			}
+			/* The "CL" entry itself is not exposed once it has
+			 * been connected with its "RE" dir. */
+			if (nexted_re || file != cl)
+				release_file(cl);
 			if (nexted_re) {
 				/*
 				 * Do not expose this at this time
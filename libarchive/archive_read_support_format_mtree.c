@@ -86,16 +86,34 @@ struct mtree_option {
 	char *value;
 };
 
+/*
+ * The global options in effect for an entry.  Entries share one
+ * snapshot until a /set or /unset line changes the global options.
+ */
+struct mtree_global {
+	struct mtree_option *options;
+	unsigned int refs;
+};
+
 struct mtree_entry {
 	struct archive_rb_node rbnode;
 	struct mtree_entry *next_dup;
 	struct mtree_entry *next;
-	struct mtree_option *options;
+	struct mtree_global *global;
+	/* Keywords from the entry's own line, parsed when it is returned. */
+	char *options;
 	char *name;
 	char full;
 	char used;
 };
 
+/* A keyword within the options of an entry. */
+struct mtree_keyword {
+	const char *value;
+	size_t len;
+	size_t key_len;
+};
+
 struct mtree {
 	struct archive_string	 line;
 	size_t			 buffsize;
@@ -105,8 +123,17 @@ struct mtree {
 	int			 archive_format;
 	const char		*archive_format_name;
 	struct mtree_entry	*entries;
+	struct mtree_entry	*last_entry;
 	struct mtree_entry	*this_entry;
-	struct archive_rb_tree	 entry_rbtree;
+	struct mtree_option	*global;
+	struct mtree_global	*global_snapshot;
+	uintmax_t		 line_count;
+	int			 is_form_d;
+	/* Set once the whole specification has been read. */
+	char			 read_all;
+	struct mtree_keyword	*keywords;
+	size_t			 keywords_size;
+	struct archive_string	 keyword;
 	struct archive_string	 current_dir;
 	struct archive_string	 contents_name;
 
@@ -127,7 +154,7 @@ static void	parse_escapes(char *, struct mtree_entry *);
 static int	parse_line(struct archive_read *, struct archive_entry *,
 		    struct mtree *, struct mtree_entry *, int *);
 static int	parse_keyword(struct archive_read *, struct mtree *,
-		    struct archive_entry *, struct mtree_option *, int *);
+		    struct archive_entry *, const char *, size_t, int *);
 static int	read_data(struct archive_read *a,
 		    const void **buff, size_t *size, int64_t *offset);
 static ssize_t	readline(struct archive_read *, struct mtree *, char **, ssize_t);
@@ -242,6 +269,22 @@ free_options(struct mtree_option *head)
 	}
 }
 
+static void
+release_global(struct mtree_global *global)
+{
+	if (global != NULL && --global->refs == 0) {
+		free_options(global->options);
+		free(global);
+	}
+}
+
+static void
+free_entry(struct mtree_entry *entry)
+{
+	release_global(entry->global);
+	free(entry);
+}
+
 static int
 mtree_cmp_node(const struct archive_rb_node *n1,
     const struct archive_rb_node *n2)
@@ -303,11 +346,13 @@ cleanup(struct archive_read *a)
 	p = mtree->entries;
 	while (p != NULL) {
 		q = p->next;
-		free(p->name);
-		free_options(p->options);
-		free(p);
+		free_entry(p);
 		p = q;
 	}
+	free_options(mtree->global);
+	release_global(mtree->global_snapshot);
+	free(mtree->keywords);
+	archive_string_free(&mtree->keyword);
 	archive_string_free(&mtree->line);
 	archive_string_free(&mtree->current_dir);
 	archive_string_free(&mtree->contents_name);
@@ -801,12 +846,16 @@ detect_form(struct archive_read *a, int *is_form_d)
  * The extended mtree format permits multiple lines specifying
  * attributes for each file.  For those entries, only the last line
  * is actually used.  Practically speaking, that means we have
- * to read the entire mtree file into memory up front.
+ * to read the rest of the mtree file into memory before returning
+ * a "full" entry, since a later line may still amend it.  "Relative"
+ * entries are never merged, so they are returned as soon as they
+ * have been read.
  *
  * The parsing is done in two steps.  First, it is decided if a line
  * changes the global defaults and if it is, processed accordingly.
- * Otherwise, the options of the line are merged with the current
- * global options.
+ * Otherwise, the line is recorded as an entry together with the
+ * current global options; its keywords are merged with those when
+ * the entry is returned.
  */
 static int
 add_option(struct archive_read *a, struct mtree_option **global,
@@ -916,33 +965,16 @@ process_global_unset(struct archive_read *a,
 
 static int
 process_add_entry(struct archive_read *a, struct mtree *mtree,
-    struct mtree_option **global, const char *line, ssize_t line_len,
-    struct mtree_entry **last_entry, int is_form_d)
+    const char *line, ssize_t line_len)
 {
 	struct mtree_entry *entry;
+	struct mtree_global *global;
 	struct mtree_option *iter;
-	const char *next, *eq, *name, *end;
-	size_t name_len, len;
-	int r, i;
-
-	if ((entry = malloc(sizeof(*entry))) == NULL) {
-		archive_set_error(&a->archive, errno, "Can't allocate memory");
-		return (ARCHIVE_FATAL);
-	}
-	entry->next = NULL;
-	entry->options = NULL;
-	entry->name = NULL;
-	entry->used = 0;
-	entry->full = 0;
-
-	/* Add this entry to list. */
-	if (*last_entry == NULL)
-		mtree->entries = entry;
-	else
-		(*last_entry)->next = entry;
-	*last_entry = entry;
+	const char *name, *options;
+	size_t name_len, options_len;
+	int i;
 
-	if (is_form_d) {
+	if (mtree->is_form_d) {
 		/* Filename is last item on line. */
 		/* Adjust line_len to trim trailing whitespace */
 		while (line_len > 0) {
@@ -967,27 +999,70 @@ process_add_entry(struct archive_read *a, struct mtree *mtree,
 			}
 		}
 		name_len = line + line_len - name;
-		end = name;
+		options = line;
+		options_len = name - line;
 	} else {
 		/* Filename is first item on line */
 		name_len = strcspn(line, " \t\r\n");
 		name = line;
-		line += name_len;
-		end = line + line_len;
+		options = line + name_len;
+		options_len = line_len - name_len;
 	}
-	/* name/name_len is the name within the line. */
-	/* line..end brackets the entire line except the name */
 
-	if ((entry->name = malloc(name_len + 1)) == NULL) {
+	/* Entries share the global options until they next change. */
+	global = mtree->global_snapshot;
+	if (global == NULL) {
+		if ((global = malloc(sizeof(*global))) == NULL) {
+			archive_set_error(&a->archive, errno,
+			    "Can't allocate memory");
+			return (ARCHIVE_FATAL);
+		}
+		global->options = NULL;
+		global->refs = 1;
+		mtree->global_snapshot = global;
+		/*
+		 * mtree->global lists the newest option first; prepending
+		 * reverses it, so that the options are applied in the
+		 * order they were set and the last of two aliases such as
+		 * "sha256" and "sha256digest" wins.
+		 */
+		for (iter = mtree->global; iter != NULL; iter = iter->next) {
+			if (add_option(a, &global->options, iter->value,
+			    strlen(iter->value)) != ARCHIVE_OK)
+				return (ARCHIVE_FATAL);
+		}
+	}
+
+	/* The entry, its name and its options share one allocation. */
+	entry = malloc(sizeof(*entry) + name_len + options_len + 2);
+	if (entry == NULL) {
 		archive_set_error(&a->archive, errno, "Can't allocate memory");
 		return (ARCHIVE_FATAL);
 	}
-
+	entry->next = NULL;
+	entry->next_dup = NULL;
+	entry->used = 0;
+	entry->full = 0;
+	entry->global = global;
+	global->refs++;
+	entry->name = (char *)(entry + 1);
 	memcpy(entry->name, name, name_len);
 	entry->name[name_len] = '\0';
+	entry->options = entry->name + name_len + 1;
+	memcpy(entry->options, options, options_len);
+	entry->options[options_len] = '\0';
+
+	/* Add this entry to list. */
+	if (mtree->last_entry == NULL)
+		mtree->entries = entry;
+	else
+		mtree->last_entry->next = entry;
+	mtree->last_entry = entry;
+	if (mtree->this_entry == NULL)
+		mtree->this_entry = entry;
+
 	parse_escapes(entry->name, entry);
 
-	entry->next_dup = NULL;
 	if (entry->full) {
 		if (!__archive_rb_tree_insert_node(&mtree->rbtree, &entry->rbnode)) {
 			struct mtree_entry *alt;
@@ -1000,66 +1075,30 @@ process_add_entry(struct archive_read *a, struct mtree *mtree,
 			}
 		}
 	}
-
-	for (iter = *global; iter != NULL; iter = iter->next) {
-		r = add_option(a, &entry->options, iter->value,
-		    strlen(iter->value));
-		if (r != ARCHIVE_OK)
-			return (r);
-	}
-
-	for (;;) {
-		next = line + strspn(line, " \t\r\n");
-		if (*next == '\0')
-			return (ARCHIVE_OK);
-		if (next >= end)
-			return (ARCHIVE_OK);
-		line = next;
-		next = line + strcspn(line, " \t\r\n");
-		eq = strchr(line, '=');
-		if (eq == NULL || eq > next)
-			len = next - line;
-		else
-			len = eq - line;
-
-		remove_option(&entry->options, line, len);
-		r = add_option(a, &entry->options, line, next - line);
-		if (r != ARCHIVE_OK)
-			return (r);
-		line = next;
-	}
+	return (ARCHIVE_OK);
 }
 
+/*
+ * Read lines of the specification until a new entry has been added
+ * or, if `read_all' is set, until the end of the specification.
+ */
 static int
-read_mtree(struct archive_read *a, struct mtree *mtree)
+read_mtree(struct archive_read *a, struct mtree *mtree, int read_all)
 {
 	ssize_t len;
-	uintmax_t counter;
 	char *p, *s;
-	struct mtree_option *global;
-	struct mtree_entry *last_entry;
-	int r, is_form_d;
-
-	mtree->archive_format = ARCHIVE_FORMAT_MTREE;
-	mtree->archive_format_name = "mtree";
-
-	global = NULL;
-	last_entry = NULL;
-
-	(void)detect_form(a, &is_form_d);
+	int r;
 
-	for (counter = 1; ; ++counter) {
+	for (;;) {
 		r = ARCHIVE_OK;
 		len = readline(a, mtree, &p, 65536);
 		if (len == 0) {
-			mtree->this_entry = mtree->entries;
-			free_options(global);
+			mtree->read_all = 1;
 			return (ARCHIVE_OK);
 		}
-		if (len < 0) {
-			free_options(global);
+		if (len < 0)
 			return ((int)len);
-		}
+		mtree->line_count++;
 		/* Leading whitespace is never significant, ignore it. */
 		while (*p == ' ' || *p == '\t') {
 			++p;
@@ -1080,39 +1119,42 @@ read_mtree(struct archive_read *a, struct mtree *mtree)
 		if (r != ARCHIVE_OK)
 			break;
 		if (*p != '/') {
-			r = process_add_entry(a, mtree, &global, p, len,
-			    &last_entry, is_form_d);
+			r = process_add_entry(a, mtree, p, len);
+			if (r == ARCHIVE_OK && !read_all)
+				return (ARCHIVE_OK);
 		} else if (len > 4 && strncmp(p, "/set", 4) == 0) {
 			if (p[4] != ' ' && p[4] != '\t')
 				break;
-			r = process_global_set(a, &global, p);
+			release_global(mtree->global_snapshot);
+			mtree->global_snapshot = NULL;
+			r = process_global_set(a, &mtree->global, p);
 		} else if (len > 6 && strncmp(p, "/unset", 6) == 0) {
 			if (p[6] != ' ' && p[6] != '\t')
 				break;
-			r = process_global_unset(a, &global, p);
+			release_global(mtree->global_snapshot);
+			mtree->global_snapshot = NULL;
+			r = process_global_unset(a, &mtree->global, p);
 		} else
 			break;
 
-		if (r != ARCHIVE_OK) {
-			free_options(global);
+		if (r != ARCHIVE_OK)
 			return r;
-		}
 	}
 
 	archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
-	    "Can't parse line %ju", counter);
-	free_options(global);
+	    "Can't parse line %ju", mtree->line_count);
 	return (ARCHIVE_FATAL);
 }
 
 /*
- * Read in the entire mtree file into memory on the first request.
- * Then use the next unused file to satisfy each header request.
+ * Read the mtree file as entries are requested, and use the next
+ * unused entry to satisfy each header request.
  */
 static int
 read_header(struct archive_read *a, struct archive_entry *entry)
 {
 	struct mtree *mtree;
+	struct mtree_entry *mentry;
 	char *p;
 	int r, use_next;
 
@@ -1123,23 +1165,35 @@ read_header(struct archive_read *a, struct archive_entry *entry)
 		mtree->fd = -1;
 	}
 
-	if (mtree->entries == NULL) {
+	if (mtree->resolver == NULL) {
 		mtree->resolver = archive_entry_linkresolver_new();
 		if (mtree->resolver == NULL)
 			return ARCHIVE_FATAL;
 		archive_entry_linkresolver_set_strategy(mtree->resolver,
 		    ARCHIVE_FORMAT_MTREE);
-		r = read_mtree(a, mtree);
-		if (r != ARCHIVE_OK)
-			return (r);
+		mtree->archive_format = ARCHIVE_FORMAT_MTREE;
+		mtree->archive_format_name = "mtree";
+		(void)detect_form(a, &mtree->is_form_d);
 	}
 
 	a->archive.archive_format = mtree->archive_format;
 	a->archive.archive_format_name = mtree->archive_format_name;
 
 	for (;;) {
-		if (mtree->this_entry == NULL)
-			return (ARCHIVE_EOF);
+		if (mtree->this_entry == NULL) {
+			if (mtree->read_all)
+				return (ARCHIVE_EOF);
+			r = read_mtree(a, mtree, 0);
+			if (r != ARCHIVE_OK)
+				return (r);
+			continue;
+		}
+		/* Later lines may still contribute to a "full" entry. */
+		if (mtree->this_entry->full && !mtree->read_all) {
+			r = read_mtree(a, mtree, 1);
+			if (r != ARCHIVE_OK)
+				return (r);
+		}
 		if (strcmp(mtree->this_entry->name, "..") == 0) {
 			mtree->this_entry->used = 1;
 			if (archive_strlen(&mtree->current_dir) > 0) {
@@ -1161,7 +1215,18 @@ read_header(struct archive_read *a, struct archive_entry *entry)
 			if (use_next == 0)
 				return (r);
 		}
-		mtree->this_entry = mtree->this_entry->next;
+		mentry = mtree->this_entry;
+		mtree->this_entry = mentry->next;
+		/*
+		 * Nothing refers to a used "relative" entry, so release
+		 * it unless an earlier "full" entry still holds the list.
+		 */
+		if (mentry == mtree->entries && !mentry->full) {
+			mtree->entries = mentry->next;
+			if (mtree->last_entry == mentry)
+				mtree->last_entry = NULL;
+			free_entry(mentry);
+		}
 	}
 }
 
@@ -1414,17 +1479,83 @@ parse_file(struct archive_read *a, struct archive_entry *entry,
 }
 
 /*
- * Each line contains a sequence of keywords.
+ * Returns true if the keyword `value' of length `len' is overridden
+ * by a later keyword whose name is `key'.
+ */
+static int
+keyword_overridden(const char *value, size_t len, const char *key,
+    size_t key_len)
+{
+	return (len >= key_len && memcmp(value, key, key_len) == 0 &&
+	    (len == key_len || value[key_len] == '='));
+}
+
+/*
+ * Each line contains a sequence of keywords.  A keyword overrides an
+ * earlier keyword of the same name as well as the global option of
+ * that name; the most recent keyword is applied first.
  */
 static int
 parse_line(struct archive_read *a, struct archive_entry *entry,
     struct mtree *mtree, struct mtree_entry *mp, int *parsed_kws)
 {
+	struct mtree_keyword *kw;
 	struct mtree_option *iter;
+	const char *p, *next, *eq;
+	size_t i, j, n;
 	int r = ARCHIVE_OK, r1;
 
-	for (iter = mp->options; iter != NULL; iter = iter->next) {
-		r1 = parse_keyword(a, mtree, entry, iter, parsed_kws);
+	n = 0;
+	for (p = mp->options;; p = next) {
+		p += strspn(p, " \t\r\n");
+		if (*p == '\0')
+			break;
+		next = p + strcspn(p, " \t\r\n");
+		if (n == mtree->keywords_size) {
+			size_t new_size = n == 0 ? 16 : n * 2;
+
+			kw = realloc(mtree->keywords, new_size * sizeof(*kw));
+			if (kw == NULL) {
+				archive_set_error(&a->archive, ENOMEM,
+				    "Can't allocate memory");
+				return (ARCHIVE_FATAL);
+			}
+			mtree->keywords = kw;
+			mtree->keywords_size = new_size;
+		}
+		kw = &mtree->keywords[n++];
+		kw->value = p;
+		kw->len = next - p;
+		eq = memchr(p, '=', kw->len);
+		kw->key_len = eq == NULL ? kw->len : (size_t)(eq - p);
+	}
+	kw = mtree->keywords;
+
+	for (i = n; i-- > 0;) {
+		for (j = i + 1; j < n; j++) {
+			if (keyword_overridden(kw[i].value, kw[i].len,
+			    kw[j].value, kw[j].key_len))
+				break;
+		}
+		if (j < n)
+			continue;
+		r1 = parse_keyword(a, mtree, entry, kw[i].value, kw[i].len,
+		    parsed_kws);
+		if (r1 < r)
+			r = r1;
+	}
+	for (iter = mp->global->options; iter != NULL; iter = iter->next) {
+		size_t len = strlen(iter->value);
+
+		for (j = 0; j < n; j++) {
+			if (keyword_overridden(iter->value, len,
+			    kw[j].value, kw[j].key_len))
+				break;
+		}
+		if (j < n)
+			continue;
+		r1 = parse_keyword(a, mtree, entry, iter->value, len,
+		    parsed_kws);
 		if (r1 < r)
 			r = r1;
 	}
@@ -1594,39 +1725,129 @@ parse_digest(struct archive_read *a, struct archive_entry *entry,
 	return archive_entry_set_digest(entry, type, digest_buf);
 }
 
+/*
+ * Keywords recognized by parse_keyword().  They are looked up with a
+ * perfect hash: for every name in mtree_keywords, KEYWORD_SLOT() of
+ * its hash selects a distinct entry of mtree_keyword_slots, which
+ * holds its index.  Adding a keyword requires regenerating the slot
+ * table, and possibly choosing another multiplier, so that the hash
+ * stays free of collisions.
+ */
+enum mtree_kw {
+	MTREE_KW_NONE,
+	MTREE_KW_CKSUM,
+	MTREE_KW_CONTENT,
+	MTREE_KW_CONTENTS,
+	MTREE_KW_DEVICE,
+	MTREE_KW_FLAGS,
+	MTREE_KW_GID,
+	MTREE_KW_GNAME,
+	MTREE_KW_IGNORE,
+	MTREE_KW_INODE,
+	MTREE_KW_LINK,
+	MTREE_KW_MD5,
+	MTREE_KW_MD5DIGEST,
+	MTREE_KW_MODE,
+	MTREE_KW_NLINK,
+	MTREE_KW_NOCHANGE,
+	MTREE_KW_OPTIONAL,
+	MTREE_KW_RESDEVICE,
+	MTREE_KW_RMD160,
+	MTREE_KW_RMD160DIGEST,
+	MTREE_KW_SHA1,
+	MTREE_KW_SHA1DIGEST,
+	MTREE_KW_SHA256,
+	MTREE_KW_SHA256DIGEST,
+	MTREE_KW_SHA384,
+	MTREE_KW_SHA384DIGEST,
+	MTREE_KW_SHA512,
+	MTREE_KW_SHA512DIGEST,
+	MTREE_KW_SIZE,
+	MTREE_KW_TAGS,
+	MTREE_KW_TIME,
+	MTREE_KW_TYPE,
+	MTREE_KW_UID,
+	MTREE_KW_UNAME
+};
+
+static const char * const mtree_keywords[] = {
+	NULL, "cksum", "content", "contents", "device", "flags", "gid",
+	"gname", "ignore", "inode", "link", "md5", "md5digest", "mode",
+	"nlink", "nochange", "optional", "resdevice", "rmd160",
+	"rmd160digest", "sha1", "sha1digest", "sha256", "sha256digest",
+	"sha384", "sha384digest", "sha512", "sha512digest", "size", "tags",
+	"time", "type", "uid", "uname"
+};
+
+#define	KEYWORD_HASH_MULT	31
+#define	KEYWORD_SLOT(h)		(((h) >> 5) & 127)
+
+static const unsigned char mtree_keyword_slots[128] = {
+	28,  0,  0,  0,  0,  0, 19, 26,  0,  0,  0,  0,  0,  0,  0,  9,
+	 0,  0,  0,  0,  0,  0, 30,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	29,  0, 32,  2,  0,  0,  0,  0,  0,  0,  0, 11,  0,  0,  0,  0,
+	 0, 22,  0,  0,  0,  0,  0,  0,  0, 27,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0, 33,  0,  0,  1, 20,  0,  0, 14,  0, 13, 25,  0,
+	 0,  0, 24,  0,  0, 23,  0,  0,  3,  0,  0, 16,  0,  0,  0,  0,
+	 0,  0,  0,  0, 18, 15, 12,  0,  0,  0,  0,  0,  0,  0,  8,  0,
+	 0,  0,  4,  0,  5,  0,  0, 17, 21, 31,  0,  7,  0,  0,  6, 10,
+};
+
+static enum mtree_kw
+lookup_keyword(const char *key, size_t len)
+{
+	const char *name;
+	uint32_t h;
+	size_t i;
+	int kw;
+
+	h = 0;
+	for (i = 0; i < len; i++)
+		h = h * KEYWORD_HASH_MULT + (unsigned char)key[i];
+	kw = mtree_keyword_slots[KEYWORD_SLOT(h)];
+	name = mtree_keywords[kw];
+	if (kw == MTREE_KW_NONE || strncmp(name, key, len) != 0 ||
+	    name[len] != '\0')
+		return (MTREE_KW_NONE);
+	return ((enum mtree_kw)kw);
+}
+
 /*
  * Parse a single keyword and its value.
  */
 static int
 parse_keyword(struct archive_read *a, struct mtree *mtree,
-    struct archive_entry *entry, struct mtree_option *opt, int *parsed_kws)
+    struct archive_entry *entry, const char *opt, size_t len,
+    int *parsed_kws)
 {
 	char *val, *key;
 
-	key = opt->value;
+	/* The value is split and unescaped in place; work on a copy. */
+	archive_strncpy(&mtree->keyword, opt, len);
+	key = mtree->keyword.s;
 
 	if (*key == '\0')
 		return (ARCHIVE_OK);
 
-	if (strcmp(key, "nochange") == 0) {
-		*parsed_kws |= MTREE_HAS_NOCHANGE;
-		return (ARCHIVE_OK);
-	}
-	if (strcmp(key, "optional") == 0) {
-		*parsed_kws |= MTREE_HAS_OPTIONAL;
-		return (ARCHIVE_OK);
-	}
-	if (strcmp(key, "ignore") == 0) {
-		/*
-		 * The mtree processing is not recursive, so
-		 * recursion will only happen for explicitly listed
-		 * entries.
-		 */
-		return (ARCHIVE_OK);
-	}
-
 	val = strchr(key, '=');
 	if (val == NULL) {
+		switch (lookup_keyword(key, strlen(key))) {
+		case MTREE_KW_NOCHANGE:
+			*parsed_kws |= MTREE_HAS_NOCHANGE;
+			return (ARCHIVE_OK);
+		case MTREE_KW_OPTIONAL:
+			*parsed_kws |= MTREE_HAS_OPTIONAL;
+			return (ARCHIVE_OK);
+		case MTREE_KW_IGNORE:
+			/*
+			 * The mtree processing is not recursive, so
+			 * recursion will only happen for explicitly listed
+			 * entries.
+			 */
+			return (ARCHIVE_OK);
+		default:
+			break;
+		}
 		archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
 		    "Malformed attribute \"%s\" (%d)", key, key[0]);
 		return (ARCHIVE_WARN);
@@ -1635,21 +1856,18 @@ parse_keyword(struct archive_read *a, struct mtree *mtree,
 	*val = '\0';
 	++val;
 
-	switch (key[0]) {
-	case 'c':
-		if (strcmp(key, "content") == 0
-		    || strcmp(key, "contents") == 0) {
-			parse_escapes(val, NULL);
-			archive_strcpy(&mtree->contents_name, val);
-			return (ARCHIVE_OK);
-		}
-		if (strcmp(key, "cksum") == 0)
-			return (ARCHIVE_OK);
-		break;
-	case 'd':
-		if (strcmp(key, "device") == 0) {
-			/* stat(2) st_rdev field, e.g. the major/minor IDs
-			 * of a char/block special file */
+	switch (lookup_keyword(key, val - 1 - key)) {
+	case MTREE_KW_CONTENT:
+	case MTREE_KW_CONTENTS:
+		parse_escapes(val, NULL);
+		archive_strcpy(&mtree->contents_name, val);
+		return (ARCHIVE_OK);
+	case MTREE_KW_CKSUM:
+		return (ARCHIVE_OK);
+	case MTREE_KW_DEVICE:
+		/* stat(2) st_rdev field, e.g. the major/minor IDs
+		 * of a char/block special file */
+		{
 			int r;
 			dev_t dev;
 
@@ -1659,68 +1877,47 @@ parse_keyword(struct archive_read *a, struct mtree *mtree,
 				archive_entry_set_rdev(entry, dev);
 			return r;
 		}
-		break;
-	case 'f':
-		if (strcmp(key, "flags") == 0) {
-			*parsed_kws |= MTREE_HAS_FFLAGS;
-			archive_entry_copy_fflags_text(entry, val);
-			return (ARCHIVE_OK);
-		}
-		break;
-	case 'g':
-		if (strcmp(key, "gid") == 0) {
-			*parsed_kws |= MTREE_HAS_GID;
-			archive_entry_set_gid(entry, mtree_atol(&val, 10));
-			return (ARCHIVE_OK);
-		}
-		if (strcmp(key, "gname") == 0) {
-			*parsed_kws |= MTREE_HAS_GNAME;
-			archive_entry_copy_gname(entry, val);
-			return (ARCHIVE_OK);
-		}
-		break;
-	case 'i':
-		if (strcmp(key, "inode") == 0) {
-			archive_entry_set_ino(entry, mtree_atol(&val, 10));
-			return (ARCHIVE_OK);
-		}
-		break;
-	case 'l':
-		if (strcmp(key, "link") == 0) {
-			parse_escapes(val, NULL);
-			archive_entry_copy_symlink(entry, val);
-			return (ARCHIVE_OK);
-		}
-		break;
-	case 'm':
-		if (strcmp(key, "md5") == 0 || strcmp(key, "md5digest") == 0) {
-			return parse_digest(a, entry, val,
-			    ARCHIVE_ENTRY_DIGEST_MD5);
-		}
-		if (strcmp(key, "mode") == 0) {
-			if (val[0] < '0' || val[0] > '7') {
-				archive_set_error(&a->archive,
-				    ARCHIVE_ERRNO_FILE_FORMAT,
-				    "Symbolic or non-octal mode \"%s\" unsupported", val);
-				return (ARCHIVE_WARN);
-			}
-			*parsed_kws |= MTREE_HAS_PERM;
-			archive_entry_set_perm(entry, (mode_t)mtree_atol(&val, 8));
-			return (ARCHIVE_OK);
-		}
-		break;
-	case 'n':
-		if (strcmp(key, "nlink") == 0) {
-			*parsed_kws |= MTREE_HAS_NLINK;
-			archive_entry_set_nlink(entry,
-				(unsigned int)mtree_atol(&val, 10));
-			return (ARCHIVE_OK);
+	case MTREE_KW_FLAGS:
+		*parsed_kws |= MTREE_HAS_FFLAGS;
+		archive_entry_copy_fflags_text(entry, val);
+		return (ARCHIVE_OK);
+	case MTREE_KW_GID:
+		*parsed_kws |= MTREE_HAS_GID;
+		archive_entry_set_gid(entry, mtree_atol(&val, 10));
+		return (ARCHIVE_OK);
+	case MTREE_KW_GNAME:
+		*parsed_kws |= MTREE_HAS_GNAME;
+		archive_entry_copy_gname(entry, val);
+		return (ARCHIVE_OK);
+	case MTREE_KW_INODE:
+		archive_entry_set_ino(entry, mtree_atol(&val, 10));
+		return (ARCHIVE_OK);
+	case MTREE_KW_LINK:
+		parse_escapes(val, NULL);
+		archive_entry_copy_symlink(entry, val);
+		return (ARCHIVE_OK);
+	case MTREE_KW_MD5:
+	case MTREE_KW_MD5DIGEST:
+		return parse_digest(a, entry, val, ARCHIVE_ENTRY_DIGEST_MD5);
+	case MTREE_KW_MODE:
+		if (val[0] < '0' || val[0] > '7') {
+			archive_set_error(&a->archive,
+			    ARCHIVE_ERRNO_FILE_FORMAT,
+			    "Symbolic or non-octal mode \"%s\" unsupported", val);
+			return (ARCHIVE_WARN);
 		}
-		break;
-	case 'r':
-		if (strcmp(key, "resdevice") == 0) {
-			/* stat(2) st_dev field, e.g. the device ID where the
-			 * inode resides */
+		*parsed_kws |= MTREE_HAS_PERM;
+		archive_entry_set_perm(entry, (mode_t)mtree_atol(&val, 8));
+		return (ARCHIVE_OK);
+	case MTREE_KW_NLINK:
+		*parsed_kws |= MTREE_HAS_NLINK;
+		archive_entry_set_nlink(entry,
+			(unsigned int)mtree_atol(&val, 10));
+		return (ARCHIVE_OK);
+	case MTREE_KW_RESDEVICE:
+		/* stat(2) st_dev field, e.g. the device ID where the
+		 * inode resides */
+		{
 			int r;
 			dev_t dev;
 
@@ -1729,48 +1926,38 @@ parse_keyword(struct archive_read *a, struct mtree *mtree,
 				archive_entry_set_dev(entry, dev);
 			return r;
 		}
-		if (strcmp(key, "rmd160") == 0 ||
-		    strcmp(key, "rmd160digest") == 0) {
-			return parse_digest(a, entry, val,
-			    ARCHIVE_ENTRY_DIGEST_RMD160);
-		}
-		break;
-	case 's':
-		if (strcmp(key, "sha1") == 0 ||
-		    strcmp(key, "sha1digest") == 0) {
-			return parse_digest(a, entry, val,
-			    ARCHIVE_ENTRY_DIGEST_SHA1);
-		}
-		if (strcmp(key, "sha256") == 0 ||
-		    strcmp(key, "sha256digest") == 0) {
-			return parse_digest(a, entry, val,
-			    ARCHIVE_ENTRY_DIGEST_SHA256);
-		}
-		if (strcmp(key, "sha384") == 0 ||
-		    strcmp(key, "sha384digest") == 0) {
-			return parse_digest(a, entry, val,
-			    ARCHIVE_ENTRY_DIGEST_SHA384);
-		}
-		if (strcmp(key, "sha512") == 0 ||
-		    strcmp(key, "sha512digest") == 0) {
-			return parse_digest(a, entry, val,
-			    ARCHIVE_ENTRY_DIGEST_SHA512);
-		}
-		if (strcmp(key, "size") == 0) {
-			archive_entry_set_size(entry, mtree_atol(&val, 10));
-			return (ARCHIVE_OK);
-		}
-		break;
-	case 't':
-		if (strcmp(key, "tags") == 0) {
-			/*
-			 * Comma delimited list of tags.
-			 * Ignore the tags for now, but the interface
-			 * should be extended to allow inclusion/exclusion.
-			 */
-			return (ARCHIVE_OK);
-		}
-		if (strcmp(key, "time") == 0) {
+	case MTREE_KW_RMD160:
+	case MTREE_KW_RMD160DIGEST:
+		return parse_digest(a, entry, val,
+		    ARCHIVE_ENTRY_DIGEST_RMD160);
+	case MTREE_KW_SHA1:
+	case MTREE_KW_SHA1DIGEST:
+		return parse_digest(a, entry, val,
+		    ARCHIVE_ENTRY_DIGEST_SHA1);
+	case MTREE_KW_SHA256:
+	case MTREE_KW_SHA256DIGEST:
+		return parse_digest(a, entry, val,
+		    ARCHIVE_ENTRY_DIGEST_SHA256);
+	case MTREE_KW_SHA384:
+	case MTREE_KW_SHA384DIGEST:
+		return parse_digest(a, entry, val,
+		    ARCHIVE_ENTRY_DIGEST_SHA384);
+	case MTREE_KW_SHA512:
+	case MTREE_KW_SHA512DIGEST:
+		return parse_digest(a, entry, val,
+		    ARCHIVE_ENTRY_DIGEST_SHA512);
+	case MTREE_KW_SIZE:
+		archive_entry_set_size(entry, mtree_atol(&val, 10));
+		return (ARCHIVE_OK);
+	case MTREE_KW_TAGS:
+		/*
+		 * Comma delimited list of tags.
+		 * Ignore the tags for now, but the interface
+		 * should be extended to allow inclusion/exclusion.
+		 */
+		return (ARCHIVE_OK);
+	case MTREE_KW_TIME:
+		{
 			int64_t m;
 			int64_t my_time_t_max = get_time_t_max();
 			int64_t my_time_t_min = get_time_t_min();
@@ -1796,77 +1983,71 @@ parse_keyword(struct archive_read *a, struct mtree *mtree,
 			archive_entry_set_mtime(entry, (time_t)m, ns);
 			return (ARCHIVE_OK);
 		}
-		if (strcmp(key, "type") == 0) {
-			switch (val[0]) {
-			case 'b':
-				if (strcmp(val, "block") == 0) {
-					*parsed_kws |= MTREE_HAS_TYPE;
-					archive_entry_set_filetype(entry,
-						AE_IFBLK);
-					return (ARCHIVE_OK);
-				}
-				break;
-			case 'c':
-				if (strcmp(val, "char") == 0) {
-					*parsed_kws |= MTREE_HAS_TYPE;
-					archive_entry_set_filetype(entry,
-						AE_IFCHR);
-					return (ARCHIVE_OK);
-				}
-				break;
-			case 'd':
-				if (strcmp(val, "dir") == 0) {
-					*parsed_kws |= MTREE_HAS_TYPE;
-					archive_entry_set_filetype(entry,
-						AE_IFDIR);
-					return (ARCHIVE_OK);
-				}
-				break;
-			case 'f':
-				if (strcmp(val, "fifo") == 0) {
-					*parsed_kws |= MTREE_HAS_TYPE;
-					archive_entry_set_filetype(entry,
-						AE_IFIFO);
-					return (ARCHIVE_OK);
-				}
-				if (strcmp(val, "file") == 0) {
-					*parsed_kws |= MTREE_HAS_TYPE;
-					archive_entry_set_filetype(entry,
-						AE_IFREG);
-					return (ARCHIVE_OK);
-				}
-				break;
-			case 'l':
-				if (strcmp(val, "link") == 0) {
-					*parsed_kws |= MTREE_HAS_TYPE;
-					archive_entry_set_filetype(entry,
-						AE_IFLNK);
-					return (ARCHIVE_OK);
-				}
-				break;
-			default:
-				break;
+	case MTREE_KW_TYPE:
+		switch (val[0]) {
+		case 'b':
+			if (strcmp(val, "block") == 0) {
+				*parsed_kws |= MTREE_HAS_TYPE;
+				archive_entry_set_filetype(entry,
+					AE_IFBLK);
+				return (ARCHIVE_OK);
 			}
-			archive_set_error(&a->archive,
-			    ARCHIVE_ERRNO_FILE_FORMAT,
-			    "Unrecognized file type \"%s\"; "
-			    "assuming \"file\"", val);
-			archive_entry_set_filetype(entry, AE_IFREG);
-			return (ARCHIVE_WARN);
-		}
-		break;
-	case 'u':
-		if (strcmp(key, "uid") == 0) {
-			*parsed_kws |= MTREE_HAS_UID;
-			archive_entry_set_uid(entry, mtree_atol(&val, 10));
-			return (ARCHIVE_OK);
-		}
-		if (strcmp(key, "uname") == 0) {
-			*parsed_kws |= MTREE_HAS_UNAME;
-			archive_entry_copy_uname(entry, val);
-			return (ARCHIVE_OK);
+			break;
+		case 'c':
+			if (strcmp(val, "char") == 0) {
+				*parsed_kws |= MTREE_HAS_TYPE;
+				archive_entry_set_filetype(entry,
+					AE_IFCHR);
+				return (ARCHIVE_OK);
+			}
+			break;
+		case 'd':
+			if (strcmp(val, "dir") == 0) {
+				*parsed_kws |= MTREE_HAS_TYPE;
+				archive_entry_set_filetype(entry,
+					AE_IFDIR);
+				return (ARCHIVE_OK);
+			}
+			break;
+		case 'f':
+			if (strcmp(val, "fifo") == 0) {
+				*parsed_kws |= MTREE_HAS_TYPE;
+				archive_entry_set_filetype(entry,
+					AE_IFIFO);
+				return (ARCHIVE_OK);
+			}
+			if (strcmp(val, "file") == 0) {
+				*parsed_kws |= MTREE_HAS_TYPE;
+				archive_entry_set_filetype(entry,
+					AE_IFREG);
+				return (ARCHIVE_OK);
+			}
+			break;
+		case 'l':
+			if (strcmp(val, "link") == 0) {
+				*parsed_kws |= MTREE_HAS_TYPE;
+				archive_entry_set_filetype(entry,
+					AE_IFLNK);
+				return (ARCHIVE_OK);
+			}
+			break;
+		default:
+			break;
 		}
-		break;
+		archive_set_error(&a->archive,
+		    ARCHIVE_ERRNO_FILE_FORMAT,
+		    "Unrecognized file type \"%s\"; "
+		    "assuming \"file\"", val);
+		archive_entry_set_filetype(entry, AE_IFREG);
+		return (ARCHIVE_WARN);
+	case MTREE_KW_UID:
+		*parsed_kws |= MTREE_HAS_UID;
+		archive_entry_set_uid(entry, mtree_atol(&val, 10));
+		return (ARCHIVE_OK);
+	case MTREE_KW_UNAME:
+		*parsed_kws |= MTREE_HAS_UNAME;
+		archive_entry_copy_uname(entry, val);
+		return (ARCHIVE_OK);
 	default:
 		break;
 	}
@@ -2128,6 +2309,10 @@ readline(struct archive_read *a, struct mtree *mtree, char **start,
 		mtree->line.s[total_size] = '\0';
 
 		for (u = mtree->line.s + find_off; *u; ++u) {
+			/* Skip ahead to the next character of interest. */
+			u += strcspn(u, "\n#\\");
+			if (u[0] == '\0')
+				break;
 			if (u[0] == '\n') {
 				/* Ends with unescaped newline. */
 				*start = mtree->line.s;
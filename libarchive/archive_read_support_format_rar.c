@@ -3608,6 +3608,37 @@ execute_filter_delta(struct rar_filter *filter, struct rar_virtual_machine *vm)
   return 1;
 }
 
+/*
+ * Returns the offset of the first 0xE8 byte (or 0xE8/0xE9 byte if e9also
+ * is set) in mem[from, to), or `to' if there is none.
+ */
+static uint32_t
+find_e8(const uint8_t *mem, uint32_t from, uint32_t to, int e9also)
+{
+  const uint64_t ones = UINT64_C(0x0101010101010101);
+  const uint8_t *p;
+  uint64_t v;
+
+  if (from >= to)
+    return to;
+  if (!e9also)
+  {
+    p = memchr(mem + from, 0xE8, to - from);
+    return p != NULL ? (uint32_t)(p - mem) : to;
+  }
+  /* 0xE8 and 0xE9 only differ in the lowest bit; test 8 bytes at once. */
+  for (; to - from >= 8; from += 8)
+  {
+    memcpy(&v, mem + from, sizeof(v));
+    v = (v & (ones * 0xFE)) ^ (ones * 0xE8);
+    if (((v - ones) & ~v & (ones * 0x80)) != 0)
+      break;
+  }
+  while (from < to && (mem[from] & 0xFE) != 0xE8)
+    from++;
+  return from;
+}
+
 static int
 execute_filter_e8(struct rar_filter *filter, struct rar_virtual_machine *vm, size_t pos, int e9also)
 {
@@ -3618,18 +3649,15 @@ execute_filter_e8(struct rar_filter *filter, struct rar_virtual_machine *vm, siz
   if (length > PROGRAM_WORK_SIZE || length < 4)
     return 0;
 
-  for (i = 0; i <= length - 5; i++)
+  for (i = find_e8(vm->memory, 0, length - 4, e9also); i < length - 4;
+       i = find_e8(vm->memory, i + 5, length - 4, e9also))
   {
-    if (vm->memory[i] == 0xE8 || (e9also && vm->memory[i] == 0xE9))
-    {
-      uint32_t currpos = (uint32_t)pos + i + 1;
-      int32_t address = (int32_t)vm_read_32(vm, i + 1);
-      if (address < 0 && currpos >= (uint32_t)-address)
-        vm_write_32(vm, i + 1, address + filesize);
-      else if (address >= 0 && (uint32_t)address < filesize)
-        vm_write_32(vm, i + 1, address - currpos);
-      i += 4;
-    }
+    uint32_t currpos = (uint32_t)pos + i + 1;
+    int32_t address = (int32_t)vm_read_32(vm, i + 1);
+    if (address < 0 && currpos >= (uint32_t)-address)
+      vm_write_32(vm, i + 1, address + filesize);
+    else if (address >= 0 && (uint32_t)address < filesize)
+      vm_write_32(vm, i + 1, address - currpos);
   }
 
   filter->filteredblockaddress = 0;
@@ -42,10 +42,12 @@
 #include "archive_crc32.h"
 #endif
 
+#include "archive_digest_private.h"
 #include "archive_entry.h"
 #include "archive_entry_locale.h"
 #include "archive_ppmd7_private.h"
 #include "archive_entry_private.h"
+#include "archive_solid_cache_private.h"
 
 #ifdef HAVE_BLAKE2_H
 #include <blake2.h>
@@ -192,6 +194,13 @@ struct decode_table {
 	uint8_t quick_len[1 << 10];
 	uint16_t quick_num[1 << 10];
 	uint16_t decode_num[306];
+
+	/* Literal pairs: when the first `quick_bits` bits of the input hold
+	 * two complete literal codes, `pair_len` is the number of bits used
+	 * by both of them and `pair_sym` is the second literal (the first one
+	 * is in `quick_num`). Only built for the literal/length table. */
+	uint8_t pair_len[1 << 10];
+	uint8_t pair_sym[1 << 10];
 };
 
 struct comp_state {
@@ -250,6 +259,11 @@ struct comp_state {
 	struct decode_table rd;      /* repeating distances */
 #define HUFF_TABLE_SIZE (HUFF_NC + HUFF_DC + HUFF_RC + HUFF_LDC)
 
+	/* Number of block bytes that have to be left after the current
+	 * position to decode one whole literal or match (at most 10 bytes)
+	 * with the unchecked bit reader. */
+#define FAST_DECODE_MARGIN 32
+
 	/* Circular deque for storing filters. */
 	struct cdeque filters;
 	int64_t last_block_start;    /* Used for sanity checking. */
@@ -308,6 +322,52 @@ struct multivolume {
 	uint8_t* push_buf;
 };
 
+/* Decoder state shared with other read handles through the solid cache.
+ *
+ * A snapshot describes the decoder state right after a member of a solid
+ * stream has been unpacked. Since the window buffer only changes in the
+ * region written by the member, most snapshots are deltas holding just
+ * those bytes on top of the snapshot of the previous member; a full copy
+ * of the window is taken for large members and every SOLID_SNAPSHOT_DEPTH
+ * members, so that restoring a snapshot stays cheap. */
+#define SOLID_SNAPSHOT_DEPTH 64
+
+struct solid_snapshot {
+	struct archive_solid_cache_entry* parent;
+	unsigned int depth;
+	ssize_t window_size;
+	int64_t start;               /* Solid offset of data[0] for deltas. */
+	size_t size;                 /* Number of bytes in `data`. */
+	int64_t end;                 /* Solid offset after this member. */
+	int dist_cache[4];
+	int last_len;
+	struct decode_table bd, ld, dd, ldd, rd;
+	uint8_t* data;
+};
+
+struct solid_cache {
+	int enabled;
+
+	/* Size of the largest snapshot this handle stores, as set by the
+	 * "solid-cache" option. */
+	size_t limit;
+
+	/* SHA-256 chained over the header and the packed data of every
+	 * member read so far; it identifies the solid stream prefix that
+	 * has been unpacked. The current member is accumulated in `member`
+	 * while `hashing` is set. */
+	uint8_t chain[ARCHIVE_SOLID_CACHE_DIGEST_SIZE];
+	uint8_t header[ARCHIVE_SOLID_CACHE_DIGEST_SIZE];
+	int hashing;
+	archive_sha256_ctx member;
+
+	/* Snapshot of the state after the last unpacked member. */
+	struct archive_solid_cache_entry* last;
+
+	/* Snapshot that needs to be loaded before unpacking anything. */
+	struct archive_solid_cache_entry* pending;
+};
+
 /* Main context structure. */
 struct rar5 {
 	int header_initialized;
@@ -352,6 +412,9 @@ struct rar5 {
 	/* The header of currently processed RARv5 block. Used in main
 	 * decompression logic loop. */
 	struct compressed_block_header last_block_hdr;
+
+	/* Sharing of solid stream state between read handles. */
+	struct solid_cache scache;
 };
 
 /* Forward function declarations. */
@@ -361,6 +424,11 @@ static int verify_global_checksums(struct archive_read* a);
 static int rar5_read_data_skip(struct archive_read *a);
 static int push_data_ready(struct archive_read* a, struct rar5* rar,
 	const uint8_t* buf, size_t size, int64_t offset);
+static void solid_cache_hash_header(struct rar5* rar, const uint8_t* p,
+	size_t size);
+static void solid_cache_begin_member(struct rar5* rar);
+static void solid_cache_hash(struct rar5* rar, const uint8_t* p,
+	size_t size);
 
 /* CDE_xxx = Circular Double Ended (Queue) return values. */
 enum CDE_RETURN_VALUES {
@@ -515,10 +583,7 @@ static void circular_memcpy(uint8_t* dst, uint8_t* window, const uint64_t mask,
 }
 
 static uint32_t read_filter_data(struct rar5* rar, uint32_t offset) {
-	uint8_t linear_buf[4];
-	circular_memcpy(linear_buf, rar->cstate.window_buf,
-	    rar->cstate.window_mask, offset, offset + 4);
-	return archive_le32dec(linear_buf);
+	return archive_le32dec(&rar->cstate.filtered_buf[offset]);
 }
 
 static void write_filter_data(struct rar5* rar, uint32_t offset,
@@ -541,22 +606,33 @@ static struct filter_info* add_new_filter(struct rar5* rar) {
 }
 
 static int run_delta_filter(struct rar5* rar, struct filter_info* flt) {
-	int i;
+	const uint8_t* window = rar->cstate.window_buf;
+	const uint64_t mask = rar->cstate.window_mask;
+	const ssize_t start = (rar->cstate.solid_offset + flt->block_start) &
+	    mask;
+	const ssize_t span = rar5_min(flt->block_length,
+	    (ssize_t) (mask + 1 - start));
+	const uint8_t* src = &window[start];
+	const uint8_t* src_end = src + span;
 	ssize_t dest_pos, src_pos = 0;
+	int i;
 
+	/* The source bytes are read in order; the window only has to be
+	 * wrapped when `src` reaches the end of a contiguous span. */
 	for(i = 0; i < flt->channels; i++) {
 		uint8_t prev_byte = 0;
 		for(dest_pos = i;
 				dest_pos < flt->block_length;
 				dest_pos += flt->channels)
 		{
-			uint8_t byte;
-
-			byte = rar->cstate.window_buf[
-			    (rar->cstate.solid_offset + flt->block_start +
-			    src_pos) & rar->cstate.window_mask];
+			if(src == src_end) {
+				src = window;
+				src_end = window + rar5_min(
+				    flt->block_length - src_pos,
+				    (ssize_t) (mask + 1));
+			}
 
-			prev_byte -= byte;
+			prev_byte -= *src++;
 			rar->cstate.filtered_buf[dest_pos] = prev_byte;
 			src_pos++;
 		}
@@ -565,6 +641,40 @@ static int run_delta_filter(struct rar5* rar, struct filter_info* flt) {
 	return ARCHIVE_OK;
 }
 
+/* Returns the position of the first 0xE8 byte (or 0xE8/0xE9 byte, if
+ * `extended` is set) in buf[from, to), or `to` if there is none. */
+static ssize_t find_e8e9(const uint8_t* buf, ssize_t from, ssize_t to,
+    int extended)
+{
+	const uint64_t ones = UINT64_C(0x0101010101010101);
+
+	if(from >= to)
+		return to;
+
+	if(!extended) {
+		const uint8_t* e8 = memchr(&buf[from], 0xE8, to - from);
+		return e8 ? e8 - buf : to;
+	}
+
+	/* 0xE8 and 0xE9 only differ in the lowest bit. Check 8 bytes at
+	 * a time whether any of them is 0xE8 once that bit is cleared. */
+	while(from + 8 <= to) {
+		uint64_t v;
+
+		memcpy(&v, &buf[from], sizeof(v));
+		v = (v & (ones * 0xFE)) ^ (ones * 0xE8);
+		if(((v - ones) & ~v & (ones * 0x80)) != 0)
+			break;
+
+		from += 8;
+	}
+
+	while(from < to && (buf[from] & 0xFE) != 0xE8)
+		from++;
+
+	return from;
+}
+
 static int run_e8e9_filter(struct rar5* rar, struct filter_info* flt,
 		int extended)
 {
@@ -576,23 +686,24 @@ static int run_e8e9_filter(struct rar5* rar, struct filter_info* flt,
 	    rar->cstate.solid_offset + flt->block_start,
 	    rar->cstate.solid_offset + flt->block_start + flt->block_length);
 
+	/* The block is scanned in its linear copy. Every patched address is
+	 * skipped right after it has been written, so the scan only ever
+	 * looks at bytes that still hold the original data. */
 	for(i = 0; i < flt->block_length - 4;) {
-		uint8_t b = rar->cstate.window_buf[
-		    (rar->cstate.solid_offset + flt->block_start +
-		    i++) & rar->cstate.window_mask];
-
 		/*
 		 * 0xE8 = x86's call <relative_addr_uint32> (function call)
 		 * 0xE9 = x86's jmp <relative_addr_uint32> (unconditional jump)
 		 */
-		if(b == 0xE8 || (extended && b == 0xE9)) {
+		i = find_e8e9(rar->cstate.filtered_buf, i,
+		    flt->block_length - 4, extended);
 
+		if(i < flt->block_length - 4) {
 			uint32_t addr;
-			uint32_t offset = (i + flt->block_start) % file_size;
+			uint32_t offset;
 
-			addr = read_filter_data(rar,
-			    (uint32_t)(rar->cstate.solid_offset +
-			    flt->block_start + i) & rar->cstate.window_mask);
+			i++;
+			offset = (i + flt->block_start) % file_size;
+			addr = read_filter_data(rar, (uint32_t)i);
 
 			if(addr & 0x80000000) {
 				if(((addr + offset) & 0x80000000) == 0) {
@@ -623,16 +734,13 @@ static int run_arm_filter(struct rar5* rar, struct filter_info* flt) {
 	    rar->cstate.solid_offset + flt->block_start,
 	    rar->cstate.solid_offset + flt->block_start + flt->block_length);
 
+	/* Each iteration only reads and rewrites its own 4 bytes, so the
+	 * linear copy can be scanned directly. */
 	for(i = 0; i < flt->block_length - 3; i += 4) {
-		uint8_t* b = &rar->cstate.window_buf[
-		    (rar->cstate.solid_offset +
-		    flt->block_start + i + 3) & rar->cstate.window_mask];
-
-		if(*b == 0xEB) {
+		if(rar->cstate.filtered_buf[i + 3] == 0xEB) {
 			/* 0xEB = ARM's BL (branch + link) instruction. */
-			offset = read_filter_data(rar,
-			    (rar->cstate.solid_offset + flt->block_start + i) &
-			     (uint32_t)rar->cstate.window_mask) & 0x00ffffff;
+			offset = read_filter_data(rar, (uint32_t)i) &
+			    0x00ffffff;
 
 			offset -= (uint32_t) ((i + flt->block_start) / 4);
 			offset = (offset & 0x00ffffff) | 0xeb000000;
@@ -1050,6 +1158,14 @@ static int read_bits_16(struct archive_read* a, struct rar5* rar,
 	return ARCHIVE_OK;
 }
 
+/* Unchecked version of read_bits_32(), used by the decoder's fast path.
+ * The caller has to make sure that at least 8 bytes of the block are
+ * available at the current byte position. */
+static inline uint32_t peek_bits_32(const struct rar5* rar, const uint8_t* p) {
+	const uint64_t bits = archive_be64dec(&p[rar->bits.in_addr]);
+	return (uint32_t) ((bits << rar->bits.bit_addr) >> 32);
+}
+
 static void skip_bits(struct rar5* rar, int bits) {
 	const int new_bits = rar->bits.bit_addr + bits;
 	rar->bits.in_addr += new_bits >> 3;
@@ -1175,13 +1291,31 @@ static int rar5_bid(struct archive_read* a, int best_bid) {
 
 static int rar5_options(struct archive_read *a, const char *key,
     const char *val) {
-	(void) a;
-	(void) key;
-	(void) val;
+	struct rar5* rar = get_context(a);
+	size_t limit;
+
+	if(strcmp(key, "solid-cache") == 0) {
+		/* Only this handle is affected; the size of the cache
+		 * shared by all of them is set with
+		 * archive_solid_cache_set_limit(). */
+		if(val == NULL || val[0] == 0) {
+			rar->scache.enabled = 0;
+			return ARCHIVE_OK;
+		}
+
+		if(__archive_solid_cache_parse_size(val, &limit) != 0) {
+			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+			    "rar5: invalid solid-cache size `%s'", val);
+			return ARCHIVE_FAILED;
+		}
+
+		rar->scache.limit = limit;
+		rar->scache.enabled = (limit > 0);
+		return ARCHIVE_OK;
+	}
 
-	/* No options supported in this version. Return the ARCHIVE_WARN code
-	 * to signal the options supervisor that the unpacker didn't handle
-	 * setting this option. */
+	/* Return the ARCHIVE_WARN code to signal the options supervisor that
+	 * the unpacker didn't handle setting this option. */
 
 	return ARCHIVE_WARN;
 }
@@ -2230,6 +2364,9 @@ static int process_base_block(struct archive_read* a,
 		return ARCHIVE_FATAL;
 	}
 
+	if(rar->scache.enabled)
+		solid_cache_hash_header(rar, p, hdr_size);
+
 	/* If the checksum is OK, we proceed with parsing. */
 	if(ARCHIVE_OK != consume(a, hdr_size_len)) {
 		return ARCHIVE_EOF;
@@ -2260,9 +2397,15 @@ static int process_base_block(struct archive_read* a,
 
 			return ret;
 		case HEAD_SERVICE:
+			if(rar->scache.enabled)
+				solid_cache_begin_member(rar);
+
 			ret = process_head_service(a, rar, entry, header_flags);
 			return ret;
 		case HEAD_FILE:
+			if(rar->scache.enabled)
+				solid_cache_begin_member(rar);
+
 			ret = process_head_file(a, rar, entry, header_flags);
 			return ret;
 		case HEAD_CRYPT:
@@ -2488,6 +2631,44 @@ static void update_crc(struct rar5* rar, const uint8_t* p, size_t to_read) {
 	}
 }
 
+/* Fills `pair_len` and `pair_sym` of the literal/length table. A pair is
+ * only recorded if decode_number() would return exactly the same two
+ * literals for every possible value of the bits following them. */
+static void create_pair_table(struct decode_table* table) {
+	const int qbits = table->quick_bits;
+	const int qmask = (1 << qbits) - 1;
+	const int32_t quick_limit = table->decode_len[qbits];
+	int code;
+
+	for(code = 0; code <= qmask; code++) {
+		const int len1 = table->quick_len[code];
+		int base, last, len2;
+
+		table->pair_len[code] = 0;
+		table->pair_sym[code] = 0;
+
+		if((code << (16 - qbits)) >= quick_limit || len1 >= qbits ||
+		    table->quick_num[code] >= 256)
+			continue;
+
+		/* The second code starts `len1` bits later; its lowest
+		 * `len1` bits are not known yet. */
+		base = (code << len1) & qmask;
+		last = base + (1 << len1) - 1;
+		len2 = table->quick_len[base];
+
+		/* quick_len[] is non-decreasing, so equal values at both ends
+		 * of the range mean the whole range decodes the same way. */
+		if((last << (16 - qbits)) >= quick_limit ||
+		    table->quick_len[last] != len2 || len2 > qbits - len1 ||
+		    table->quick_num[base] >= 256)
+			continue;
+
+		table->pair_len[code] = (uint8_t) (len1 + len2);
+		table->pair_sym[code] = (uint8_t) table->quick_num[base];
+	}
+}
+
 static int create_decode_tables(uint8_t* bit_length,
     struct decode_table* table, int size)
 {
@@ -2552,28 +2733,26 @@ static int create_decode_tables(uint8_t* bit_length,
 		}
 	}
 
+	if(size == HUFF_NC)
+		create_pair_table(table);
+
 	return ARCHIVE_OK;
 }
 
-static int decode_number(struct archive_read* a, struct decode_table* table,
-    const uint8_t* p, uint16_t* num)
+/* Decodes one symbol from the 16 bits starting at the current bit
+ * position, and advances the bit position past the symbol's code. */
+static inline uint16_t decode_bitfield(struct rar5* rar,
+    const struct decode_table* table, uint16_t bitfield)
 {
-	int i, bits, dist, ret;
-	uint16_t bitfield;
+	int i, bits, dist;
 	uint32_t pos;
-	struct rar5* rar = get_context(a);
-
-	if(ARCHIVE_OK != (ret = read_bits_16(a, rar, p, &bitfield))) {
-		return ret;
-	}
 
 	bitfield &= 0xfffe;
 
 	if(bitfield < table->decode_len[table->quick_bits]) {
 		int code = bitfield >> (16 - table->quick_bits);
 		skip_bits(rar, table->quick_len[code]);
-		*num = table->quick_num[code];
-		return ARCHIVE_OK;
+		return table->quick_num[code];
 	}
 
 	bits = 15;
@@ -2594,10 +2773,37 @@ static int decode_number(struct archive_read* a, struct decode_table* table,
 	if(pos >= table->size)
 		pos = 0;
 
-	*num = table->decode_num[pos];
+	return table->decode_num[pos];
+}
+
+static int decode_number(struct archive_read* a, struct decode_table* table,
+    const uint8_t* p, uint16_t* num)
+{
+	int ret;
+	uint16_t bitfield;
+	struct rar5* rar = get_context(a);
+
+	if(ARCHIVE_OK != (ret = read_bits_16(a, rar, p, &bitfield))) {
+		return ret;
+	}
+
+	*num = decode_bitfield(rar, table, bitfield);
 	return ARCHIVE_OK;
 }
 
+/* Same as decode_number(), but skips the bounds check when `fast` says
+ * the block has enough data left for the whole symbol. */
+static inline int decode_symbol(struct archive_read* a, struct rar5* rar,
+    struct decode_table* table, const uint8_t* p, int fast, uint16_t* num)
+{
+	if(fast) {
+		*num = decode_bitfield(rar, table, peek_bits_32(rar, p) >> 16);
+		return ARCHIVE_OK;
+	}
+
+	return decode_number(a, table, p, num);
+}
+
 /* Reads and parses Huffman tables from the beginning of the block. */
 static int parse_tables(struct archive_read* a, struct rar5* rar,
     const uint8_t* p)
@@ -2981,23 +3187,52 @@ static int copy_string(struct archive_read* a, int len, int dist) {
 	const uint64_t cmask = rar->cstate.window_mask;
 	const uint64_t write_ptr = rar->cstate.write_ptr +
 	    rar->cstate.solid_offset;
+	const size_t write_idx = write_ptr & cmask;
+	const size_t read_idx = (write_ptr - dist) & cmask;
 	int i;
 
 	if (rar->cstate.window_buf == NULL)
 		return ARCHIVE_FATAL;
 
-	/* The unpacker spends most of the time in this function. It would be
-	 * a good idea to introduce some optimizations here.
+	/* The unpacker spends most of the time in this function.
 	 *
 	 * Just remember that this loop treats buffers that overlap differently
-	 * than buffers that do not overlap. This is why a simple memcpy(3)
-	 * call will not be enough. */
+	 * than buffers that do not overlap: the copy has to behave as if it
+	 * was done byte by byte, so that a short distance repeats the
+	 * pattern. This is why a simple memcpy(3) call will not be enough. */
+
+	if(write_idx + len <= cmask + 1 && read_idx + len <= cmask + 1) {
+		/* Neither the source nor the destination wraps around the
+		 * end of the window. */
+		uint8_t* dst = &rar->cstate.window_buf[write_idx];
+		const uint8_t* src = &rar->cstate.window_buf[read_idx];
+
+		if(read_idx >= write_idx || write_idx - read_idx >= (size_t) len) {
+			/* Source is ahead of the destination, or doesn't
+			 * overlap it: the byte by byte copy is a memmove. */
+			memmove(dst, src, len);
+		} else if(write_idx - read_idx >= 8) {
+			/* Overlapping copy in 8 or 16 byte chunks; every chunk
+			 * only reads bytes that have already been written. */
+			const int step = write_idx - read_idx >= 16 ? 16 : 8;
+
+			for(i = 0; i + step <= len; i += step)
+				memcpy(dst + i, src + i, step);
+			for(; i < len; i++)
+				dst[i] = src[i];
+		} else {
+			for(i = 0; i < len; i++)
+				dst[i] = src[i];
+		}
+
+		rar->cstate.write_ptr += len;
+		return ARCHIVE_OK;
+	}
 
 	for(i = 0; i < len; i++) {
-		const ssize_t write_idx = (write_ptr + i) & cmask;
-		const ssize_t read_idx = (write_ptr + i - dist) & cmask;
-		rar->cstate.window_buf[write_idx] =
-		    rar->cstate.window_buf[read_idx];
+		const ssize_t widx = (write_ptr + i) & cmask;
+		const ssize_t ridx = (write_ptr + i - dist) & cmask;
+		rar->cstate.window_buf[widx] = rar->cstate.window_buf[ridx];
 	}
 
 	rar->cstate.write_ptr += len;
@@ -3007,7 +3242,7 @@ static int copy_string(struct archive_read* a, int len, int dist) {
 static int do_uncompress_block(struct archive_read* a, const uint8_t* p) {
 	struct rar5* rar = get_context(a);
 	uint16_t num;
-	int ret;
+	int ret, fast;
 
 	const uint64_t cmask = rar->cstate.window_mask;
 	const struct compressed_block_header* hdr = &rar->last_block_hdr;
@@ -3033,8 +3268,34 @@ static int do_uncompress_block(struct archive_read* a, const uint8_t* p) {
 			break;
 		}
 
+		/* Away from the end of the block, symbols can be decoded
+		 * without checking the bounds for every one of them. */
+		fast = rar->bits.in_addr + FAST_DECODE_MARGIN <=
+		    rar->cstate.cur_block_size;
+
 		/* Decode the next literal. */
-		if(ARCHIVE_OK != decode_number(a, &rar->cstate.ld, p, &num)) {
+		if(fast) {
+			const uint32_t bits = peek_bits_32(rar, p);
+			const struct decode_table* ld = &rar->cstate.ld;
+			const int code = bits >> (32 - ld->quick_bits);
+
+			if(ld->pair_len[code] != 0) {
+				/* Two literals at once. */
+				int64_t write_idx = rar->cstate.solid_offset +
+				    rar->cstate.write_ptr;
+
+				rar->cstate.window_buf[write_idx & cmask] =
+				    (uint8_t) ld->quick_num[code];
+				rar->cstate.window_buf[(write_idx + 1) & cmask] =
+				    ld->pair_sym[code];
+				rar->cstate.write_ptr += 2;
+				skip_bits(rar, ld->pair_len[code]);
+				continue;
+			}
+
+			num = decode_bitfield(rar, ld, bits >> 16);
+		} else if(ARCHIVE_OK != decode_number(a, &rar->cstate.ld, p,
+		    &num)) {
 			return ARCHIVE_EOF;
 		}
 
@@ -3074,8 +3335,8 @@ static int do_uncompress_block(struct archive_read* a, const uint8_t* p) {
 				return ARCHIVE_FATAL;
 			}
 
-			if(ARCHIVE_OK != decode_number(a, &rar->cstate.dd, p,
-			    &dist_slot))
+			if(ARCHIVE_OK != decode_symbol(a, rar, &rar->cstate.dd,
+			    p, fast, &dist_slot))
 			{
 				archive_set_error(&a->archive,
 				    ARCHIVE_ERRNO_PROGRAMMER,
@@ -3118,8 +3379,9 @@ static int do_uncompress_block(struct archive_read* a, const uint8_t* p) {
 						dist += add;
 					}
 
-					if(ARCHIVE_OK != decode_number(a,
-					    &rar->cstate.ldd, p, &low_dist))
+					if(ARCHIVE_OK != decode_symbol(a,
+					    rar, &rar->cstate.ldd, p, fast,
+					    &low_dist))
 					{
 						archive_set_error(&a->archive,
 						    ARCHIVE_ERRNO_PROGRAMMER,
@@ -3200,8 +3462,8 @@ static int do_uncompress_block(struct archive_read* a, const uint8_t* p) {
 			uint16_t len_slot;
 			int len;
 
-			if(ARCHIVE_OK != decode_number(a, &rar->cstate.rd, p,
-			    &len_slot)) {
+			if(ARCHIVE_OK != decode_symbol(a, rar, &rar->cstate.rd,
+			    p, fast, &len_slot)) {
 				return ARCHIVE_FATAL;
 			}
 
@@ -3495,6 +3757,7 @@ static int process_block(struct archive_read* a) {
 		to_skip = sizeof(struct compressed_block_header) +
 			bf_byte_count(&rar->last_block_hdr) + 1;
 
+		solid_cache_hash(rar, p, to_skip);
 		if(ARCHIVE_OK != consume(a, to_skip))
 			return ARCHIVE_EOF;
 
@@ -3583,6 +3846,8 @@ static int process_block(struct archive_read* a) {
 		/* If we're processing a normal block, consume the whole
 		 * block. We can do this because we've already read the whole
 		 * block to memory. */
+		solid_cache_hash(rar, rar->cstate.block_buf,
+		    rar->cstate.cur_block_size);
 		if(ARCHIVE_OK != consume(a, rar->cstate.cur_block_size))
 			return ARCHIVE_FATAL;
 
@@ -3874,6 +4139,7 @@ static int do_unstore_file(struct archive_read* a,
 		return ARCHIVE_FATAL;
 	}
 
+	solid_cache_hash(rar, p, to_read);
 	if(ARCHIVE_OK != consume(a, to_read)) {
 		return ARCHIVE_EOF;
 	}
@@ -4051,6 +4317,298 @@ static void rar5_signature(char *buf) {
 		}
 }
 
+static void solid_snapshot_free(void* p) {
+	struct solid_snapshot* s = (struct solid_snapshot*) p;
+
+	__archive_solid_cache_release(s->parent);
+	free(s->data);
+	free(s);
+}
+
+/* Rebuilds the window buffer contents described by a snapshot. Delta
+ * snapshots are applied on top of their parent. */
+static void solid_snapshot_load_window(struct rar5* rar,
+    struct archive_solid_cache_entry* e)
+{
+	const struct solid_snapshot* s = __archive_solid_cache_data(e, NULL);
+	size_t pos, frag;
+
+	if(s->parent == NULL) {
+		memcpy(rar->cstate.window_buf, s->data, s->size);
+		return;
+	}
+
+	solid_snapshot_load_window(rar, s->parent);
+
+	pos = (size_t) (s->start & rar->cstate.window_mask);
+	frag = rar5_min(s->size, (size_t) rar->cstate.window_size - pos);
+	memcpy(&rar->cstate.window_buf[pos], s->data, frag);
+	memcpy(rar->cstate.window_buf, &s->data[frag], s->size - frag);
+}
+
+/* Loads the snapshot found in the solid cache for the members that were
+ * skipped without unpacking them. This is deferred until something needs
+ * to be unpacked, so skipping over a run of cached members costs nothing
+ * more than consuming their compressed data. */
+static void solid_cache_load_pending(struct rar5* rar) {
+	const struct solid_snapshot* s =
+	    __archive_solid_cache_data(rar->scache.pending, NULL);
+
+	if(s->window_size == rar->cstate.window_size &&
+	    rar->cstate.window_buf != NULL)
+	{
+		solid_snapshot_load_window(rar, rar->scache.pending);
+		memcpy(rar->cstate.dist_cache, s->dist_cache,
+		    sizeof(s->dist_cache));
+		rar->cstate.last_len = s->last_len;
+		rar->cstate.bd = s->bd;
+		rar->cstate.ld = s->ld;
+		rar->cstate.dd = s->dd;
+		rar->cstate.ldd = s->ldd;
+		rar->cstate.rd = s->rd;
+	}
+
+	__archive_solid_cache_release(rar->scache.pending);
+	rar->scache.pending = NULL;
+}
+
+/* Hashes a base block header that passed its CRC check; file and service
+ * headers are added to the chain when their member is started. */
+static void solid_cache_hash_header(struct rar5* rar, const uint8_t* p,
+    size_t size)
+{
+	archive_sha256_ctx ctx;
+
+	if(archive_sha256_init(&ctx) != ARCHIVE_OK) {
+		/* No digest, no cache. */
+		rar->scache.enabled = 0;
+		return;
+	}
+
+	archive_sha256_update(&ctx, p, size);
+	archive_sha256_final(&ctx, rar->scache.header);
+}
+
+/* Folds the digest of the member read so far into the chain. */
+static void solid_cache_end_member(struct rar5* rar) {
+	if(!rar->scache.hashing)
+		return;
+
+	archive_sha256_final(&rar->scache.member, rar->scache.chain);
+	rar->scache.hashing = 0;
+}
+
+/* Starts hashing a new member of a solid stream, right after its file or
+ * service header has been read. */
+static void solid_cache_begin_member(struct rar5* rar) {
+	solid_cache_end_member(rar);
+	if(!rar->main.solid || rar->main.volume)
+		return;
+
+	if(archive_sha256_init(&rar->scache.member) != ARCHIVE_OK) {
+		rar->scache.enabled = 0;
+		return;
+	}
+
+	archive_sha256_update(&rar->scache.member, rar->scache.chain,
+	    sizeof(rar->scache.chain));
+	archive_sha256_update(&rar->scache.member, rar->scache.header,
+	    sizeof(rar->scache.header));
+	rar->scache.hashing = 1;
+}
+
+/* Adds packed data of the current member to its digest. */
+static void solid_cache_hash(struct rar5* rar, const uint8_t* p,
+    size_t size)
+{
+	if(rar->scache.hashing)
+		archive_sha256_update(&rar->scache.member, p, size);
+}
+
+/* The key of the state after the current member has been unpacked; all
+ * of the member's packed data must have been hashed by now. */
+static void solid_cache_key(struct rar5* rar,
+    struct archive_solid_cache_key* key)
+{
+	solid_cache_end_member(rar);
+	memset(key, 0, sizeof(*key));
+	key->format = ARCHIVE_SOLID_CACHE_RAR5;
+	memcpy(key->digest, rar->scache.chain, sizeof(key->digest));
+}
+
+/* Called when a member of a solid stream has been fully unpacked; stores
+ * the resulting decoder state in the solid cache. */
+static void solid_cache_store(struct rar5* rar) {
+	struct archive_solid_cache_key key;
+	struct archive_solid_cache_entry* e;
+	const struct solid_snapshot* parent = NULL;
+	struct solid_snapshot* s;
+	const size_t wsize = (size_t) rar->cstate.window_size;
+	const int64_t written = rar->cstate.write_ptr;
+	size_t pos, frag;
+
+	if(rar->main.volume || rar->file.service ||
+	    rar->cstate.window_buf == NULL ||
+	    cdeque_size(&rar->cstate.filters) > 0)
+	{
+		/* Can't describe this state with a snapshot. */
+		__archive_solid_cache_release(rar->scache.last);
+		rar->scache.last = NULL;
+		return;
+	}
+
+	s = calloc(1, sizeof(*s));
+	if(s == NULL)
+		goto fail;
+
+	if(rar->scache.last != NULL)
+		parent = __archive_solid_cache_data(rar->scache.last, NULL);
+
+	if(parent != NULL && parent->window_size == rar->cstate.window_size &&
+	    parent->end == rar->cstate.solid_offset &&
+	    parent->depth < SOLID_SNAPSHOT_DEPTH && written < (int64_t) wsize)
+	{
+		/* Only keep the bytes written by this member. The
+		 * snapshot owns the reference to its parent. */
+		s->parent = rar->scache.last;
+		rar->scache.last = NULL;
+		s->depth = parent->depth + 1;
+		s->start = rar->cstate.solid_offset;
+		s->size = (size_t) written;
+		s->data = malloc(s->size > 0 ? s->size : 1);
+		if(s->data == NULL)
+			goto fail;
+
+		pos = (size_t) (s->start & rar->cstate.window_mask);
+		frag = rar5_min(s->size, wsize - pos);
+		memcpy(s->data, &rar->cstate.window_buf[pos], frag);
+		memcpy(&s->data[frag], rar->cstate.window_buf,
+		    s->size - frag);
+	} else {
+		__archive_solid_cache_release(rar->scache.last);
+		rar->scache.last = NULL;
+		s->size = wsize;
+		s->data = malloc(wsize);
+		if(s->data == NULL)
+			goto fail;
+
+		memcpy(s->data, rar->cstate.window_buf, wsize);
+	}
+
+	s->window_size = rar->cstate.window_size;
+	s->end = rar->cstate.solid_offset + written;
+	memcpy(s->dist_cache, rar->cstate.dist_cache, sizeof(s->dist_cache));
+	s->last_len = rar->cstate.last_len;
+	s->bd = rar->cstate.bd;
+	s->ld = rar->cstate.ld;
+	s->dd = rar->cstate.dd;
+	s->ldd = rar->cstate.ldd;
+	s->rd = rar->cstate.rd;
+
+	solid_cache_key(rar, &key);
+	if(sizeof(*s) + s->size > rar->scache.limit)
+		goto fail;
+
+	e = __archive_solid_cache_put(&key, s, sizeof(*s) + s->size,
+	    solid_snapshot_free);
+	if(e == NULL) {
+		solid_snapshot_free(s);
+		return;
+	}
+
+	rar->scache.last = e;
+	return;
+
+fail:
+	__archive_solid_cache_release(rar->scache.last);
+	rar->scache.last = NULL;
+	if(s != NULL)
+		solid_snapshot_free(s);
+}
+
+/* Tries to skip the current member of a solid stream by using the decoder
+ * state stored in the solid cache by some other read handle. Returns 1 if
+ * the member has been skipped.
+ *
+ * The key covers the packed data of the member, so that data is read
+ * first; on a miss the stream is rewound to unpack the member as usual. */
+static int solid_cache_skip(struct archive_read* a, struct rar5* rar) {
+	struct archive_solid_cache_key key;
+	struct archive_solid_cache_entry* e;
+	const struct solid_snapshot* s = NULL;
+	const uint8_t* p;
+	int64_t start, remaining;
+	ssize_t avail;
+
+	if(rar->main.volume || rar->file.service || !rar->scache.hashing ||
+	    rar->cstate.initialized || rar->cstate.last_write_ptr != 0 ||
+	    !a->filter->can_seek)
+		return 0;
+
+	start = a->filter->position;
+	for(remaining = rar->file.bytes_remaining; remaining > 0;
+	    remaining -= avail)
+	{
+		p = __archive_read_ahead(a, 1, &avail);
+		if(p == NULL) {
+			archive_set_error(&a->archive,
+			    ARCHIVE_ERRNO_FILE_FORMAT,
+			    "Truncated RAR5 file data");
+			return ARCHIVE_FATAL;
+		}
+
+		if(avail > remaining)
+			avail = (ssize_t) remaining;
+
+		solid_cache_hash(rar, p, avail);
+		if(ARCHIVE_OK != consume(a, avail))
+			return ARCHIVE_FATAL;
+	}
+
+	solid_cache_key(rar, &key);
+	e = __archive_solid_cache_get(&key);
+	if(e != NULL) {
+		s = __archive_solid_cache_data(e, NULL);
+		if(s->window_size != rar->cstate.window_size ||
+		    s->end < rar->cstate.solid_offset ||
+		    s->end - rar->cstate.solid_offset !=
+		    rar->file.unpacked_size)
+		{
+			__archive_solid_cache_release(e);
+			e = NULL;
+		}
+	}
+
+	if(e != NULL && rar->cstate.window_buf == NULL) {
+		init_unpack(rar);
+		if(rar->cstate.window_buf == NULL ||
+		    rar->cstate.filtered_buf == NULL)
+		{
+			__archive_solid_cache_release(e);
+			e = NULL;
+		}
+	}
+
+	if(e == NULL) {
+		if(__archive_read_seek(a, start, SEEK_SET) < 0)
+			return ARCHIVE_FATAL;
+
+		return 0;
+	}
+
+	rar->file.bytes_remaining = 0;
+	rar->file.eof = 1;
+	rar->cstate.initialized = 1;
+	rar->cstate.write_ptr = s->end - rar->cstate.solid_offset;
+	rar->cstate.last_write_ptr = rar->cstate.write_ptr;
+
+	__archive_solid_cache_release(rar->scache.last);
+	__archive_solid_cache_release(rar->scache.pending);
+	rar->scache.last = e;
+	rar->scache.pending = __archive_solid_cache_ref(e);
+	return 1;
+}
+
 static int rar5_read_data(struct archive_read *a, const void **buff,
     size_t *size, int64_t *offset) {
 	int ret;
@@ -4084,6 +4642,9 @@ static int rar5_read_data(struct archive_read *a, const void **buff,
 		return ARCHIVE_EOF;
 	}
 
+	if(rar->scache.pending != NULL && rar->file.service == 0)
+		solid_cache_load_pending(rar);
+
 	ret = do_unpack(a, rar, buff, size, offset);
 	if(ret != ARCHIVE_OK) {
 		return ret;
@@ -4101,7 +4662,12 @@ static int rar5_read_data(struct archive_read *a, const void **buff,
 		 * to the user. */
 
 		rar->file.eof = 1;
-		return verify_global_checksums(a);
+		ret = verify_global_checksums(a);
+		if(ret == ARCHIVE_OK && rar->scache.enabled &&
+		    rar->main.solid)
+			solid_cache_store(rar);
+
+		return ret;
 	}
 
 	return ARCHIVE_OK;
@@ -4118,6 +4684,16 @@ static int rar5_read_data_skip(struct archive_read *a) {
 
 		int ret;
 
+		/* Another read handle might have unpacked this member
+		 * already. */
+		if(rar->scache.enabled) {
+			ret = solid_cache_skip(a, rar);
+			if(ret < 0)
+				return ret;
+			if(ret > 0)
+				return ARCHIVE_OK;
+		}
+
 		/* Make sure to process all blocks in the compressed stream. */
 		while(rar->file.bytes_remaining > 0) {
 			/* Setting the "skip mode" will allow us to skip
@@ -4178,6 +4754,10 @@ static int rar5_cleanup(struct archive_read *a) {
 
 	free(rar->vol.push_buf);
 
+	__archive_solid_cache_release(rar->scache.last);
+	__archive_solid_cache_release(rar->scache.pending);
+	solid_cache_end_member(rar);
+
 	free_filters(rar);
 	cdeque_free(&rar->cstate.filters);
 
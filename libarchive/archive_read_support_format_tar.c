@@ -44,6 +44,7 @@
 #include "archive_entry_locale.h"
 #include "archive_private.h"
 #include "archive_read_private.h"
+#include "archive_tar_index_private.h"
 
 #define tar_min(a,b) ((a) < (b) ? (a) : (b))
 
@@ -155,10 +156,11 @@ struct tar {
 	int			 process_mac_extensions;
 	int			 read_concatenated_archives;
 	int			 realsize_override;
+	struct archive_tar_index *index;
 };
 
 static int	archive_block_is_null(const char *p);
-static char	*base64_decode(const char *, size_t, size_t *);
+static size_t	base64_decode(char *, size_t);
 static int	gnu_add_sparse_entry(struct archive_read *, struct tar *,
 		    int64_t offset, int64_t remaining);
 
@@ -204,12 +206,12 @@ static int	archive_read_format_tar_read_header(struct archive_read *,
 		    struct archive_entry *);
 static int	checksum(struct archive_read *, const void *);
 static int 	pax_attribute(struct archive_read *, struct tar *,
-		    struct archive_entry *, const char *key, const char *value,
+		    struct archive_entry *, char *key, char *value,
 		    size_t value_length);
 static int	pax_attribute_acl(struct archive_read *, struct tar *,
 		    struct archive_entry *, const char *, int);
-static int	pax_attribute_xattr(struct archive_entry *, const char *,
-		    const char *);
+static int	pax_attribute_xattr(struct archive_entry *, char *,
+		    char *, size_t);
 static int 	pax_header(struct archive_read *, struct tar *,
 		    struct archive_entry *, struct archive_string *);
 static void	pax_time(const char *, int64_t *sec, long *nanos);
@@ -226,7 +228,7 @@ static int64_t	tar_atol8(const char *, size_t);
 static int	tar_read_header(struct archive_read *, struct tar *,
 		    struct archive_entry *, size_t *);
 static int	tohex(int c);
-static char	*url_decode(const char *);
+static void	url_decode(char *);
 static void	tar_flush_unconsumed(struct archive_read *, size_t *);
 
 
@@ -295,6 +297,7 @@ archive_read_format_tar_cleanup(struct archive_read *a)
 	archive_string_free(&tar->longname);
 	archive_string_free(&tar->longlink);
 	archive_string_free(&tar->localname);
+	__archive_tar_index_free(tar->index);
 	free(tar);
 	(a->format->data) = NULL;
 	return (ARCHIVE_OK);
@@ -452,6 +455,13 @@ archive_read_format_tar_options(struct archive_read *a,
 	} else if (strcmp(key, "read_concatenated_archives") == 0) {
 		tar->read_concatenated_archives = (val != NULL && val[0] != 0);
 		return (ARCHIVE_OK);
+	} else if (strcmp(key, "index") == 0) {
+		__archive_tar_index_free(tar->index);
+		tar->index = NULL;
+		if (val == NULL || val[0] == 0)
+			return (ARCHIVE_OK);
+		return (__archive_tar_index_load(&a->archive, &tar->index,
+		    val));
 	}
 
 	/* Note: The "warn" return is just to inform the options
@@ -687,6 +697,65 @@ archive_read_format_tar_skip(struct archive_read *a)
 	return (ARCHIVE_OK);
 }
 
+/*
+ * Position the reader on the member named `pathname' using the index
+ * given with the "index" option, or on the start of the archive if
+ * `pathname' is NULL.  The next call to archive_read_next_header()
+ * returns that member.
+ */
+int
+archive_read_tar_seek_entry(struct archive *_a, const char *pathname)
+{
+	struct archive_read *a = (struct archive_read *)_a;
+	struct tar *tar;
+	int64_t offset;
+
+	archive_check_magic(_a, ARCHIVE_READ_MAGIC,
+	    ARCHIVE_STATE_HEADER | ARCHIVE_STATE_DATA | ARCHIVE_STATE_EOF,
+	    "archive_read_tar_seek_entry");
+	if (a->format == NULL ||
+	    a->format->read_header != archive_read_format_tar_read_header) {
+		archive_set_error(_a, ARCHIVE_ERRNO_MISC,
+		    "Can only use archive_read_tar_seek_entry"
+		    " with tar format");
+		return (ARCHIVE_FAILED);
+	}
+	tar = (struct tar *)(a->format->data);
+	if (tar->index == NULL) {
+		archive_set_error(_a, ARCHIVE_ERRNO_MISC,
+		    "No tar index was given");
+		return (ARCHIVE_FAILED);
+	}
+	if (pathname == NULL)
+		offset = 0;
+	else if (__archive_tar_index_find(tar->index, pathname, &offset)
+	    != 0) {
+		archive_set_error(_a, ENOENT, "%s: Not found in tar index",
+		    pathname);
+		return (ARCHIVE_WARN);
+	}
+
+	offset = __archive_read_seek(a, offset, SEEK_SET);
+	if (offset == ARCHIVE_FAILED) {
+		archive_set_error(_a, ARCHIVE_ERRNO_MISC,
+		    "Can't seek in this archive");
+		return (ARCHIVE_FAILED);
+	}
+	if (offset < 0) {
+		a->archive.state = ARCHIVE_STATE_FATAL;
+		return (ARCHIVE_FATAL);
+	}
+
+	/* Forget the member we were in the middle of. */
+	tar->entry_bytes_remaining = 0;
+	tar->entry_bytes_unconsumed = 0;
+	tar->entry_padding = 0;
+	tar->sparse_gnu_pending = 0;
+	gnu_clear_sparse_list(tar);
+	a->archive.state = ARCHIVE_STATE_HEADER;
+	return (ARCHIVE_OK);
+}
+
 /*
  * This function recursively interprets all of the headers associated
  * with a single entry.
@@ -890,6 +959,7 @@ checksum(struct archive_read *a, const void *h)
 {
 	const unsigned char *bytes;
 	const struct archive_entry_header_ustar	*header;
+	uint64_t w, lanes, high;
 	int check, sum;
 	size_t i;
 
@@ -904,18 +974,37 @@ checksum(struct archive_read *a, const void *h)
 			return 0;
 	}
 
+	/*
+	 * Sum the whole block eight bytes at a time, accumulating the
+	 * bytes in 16-bit lanes; 64 words cannot overflow a lane.  At
+	 * the same time, count the bytes with the high bit set, which
+	 * is all we need to derive the signed sum below.
+	 */
+	lanes = high = 0;
+	for (i = 0; i < 512; i += 8) {
+		memcpy(&w, bytes + i, sizeof(w));
+		lanes += w & ARCHIVE_LITERAL_ULL(0x00ff00ff00ff00ff);
+		lanes += (w >> 8) & ARCHIVE_LITERAL_ULL(0x00ff00ff00ff00ff);
+		high += (w >> 7) & ARCHIVE_LITERAL_ULL(0x0101010101010101);
+	}
+	high = (high & ARCHIVE_LITERAL_ULL(0x00ff00ff00ff00ff)) +
+	    ((high >> 8) & ARCHIVE_LITERAL_ULL(0x00ff00ff00ff00ff));
+	/* Add up the four lanes. */
+	lanes = (lanes & ARCHIVE_LITERAL_ULL(0x0000ffff0000ffff)) +
+	    ((lanes >> 16) & ARCHIVE_LITERAL_ULL(0x0000ffff0000ffff));
+	lanes = (lanes + (lanes >> 32)) & 0xffffffff;
+	high = (high * ARCHIVE_LITERAL_ULL(0x0001000100010001)) >> 48;
+
 	/*
 	 * Test the checksum.  Note that POSIX specifies _unsigned_
-	 * bytes for this calculation.
+	 * bytes for this calculation.  The checksum field itself
+	 * counts as spaces; having been checked above, it holds no
+	 * bytes with the high bit set.
 	 */
 	sum = (int)tar_atol(header->checksum, sizeof(header->checksum));
-	check = 0;
-	for (i = 0; i < 148; i++)
-		check += (unsigned char)bytes[i];
-	for (; i < 156; i++)
-		check += 32;
-	for (; i < 512; i++)
-		check += (unsigned char)bytes[i];
+	check = (int)lanes + 8 * 32;
+	for (i = 148; i < 156; i++)
+		check -= bytes[i];
 	if (sum == check)
 		return (1);
 
@@ -924,13 +1013,7 @@ checksum(struct archive_read *a, const void *h)
 	 * was created by an old BSD, Solaris, or HP-UX tar with a
 	 * broken checksum calculation.
 	 */
-	check = 0;
-	for (i = 0; i < 148; i++)
-		check += (signed char)bytes[i];
-	for (; i < 156; i++)
-		check += 32;
-	for (; i < 512; i++)
-		check += (signed char)bytes[i];
+	check -= 256 * (int)high;
 	if (sum == check)
 		return (1);
 
@@ -1759,34 +1842,24 @@ pax_header(struct archive_read *a, struct tar *tar,
 
 static int
 pax_attribute_xattr(struct archive_entry *entry,
-	const char *name, const char *value)
+	char *name, char *value, size_t value_length)
 {
-	char *name_decoded;
-	void *value_decoded;
 	size_t value_len;
 
 	if (strlen(name) < 18 || (memcmp(name, "LIBARCHIVE.xattr.", 17)) != 0)
-		return 3;
+		return 1;
 
 	name += 17;
 
-	/* URL-decode name */
-	name_decoded = url_decode(name);
-	if (name_decoded == NULL)
-		return 2;
-
-	/* Base-64 decode value */
-	value_decoded = base64_decode(value, strlen(value), &value_len);
-	if (value_decoded == NULL) {
-		free(name_decoded);
-		return 1;
-	}
+	/*
+	 * Both decoders shrink their input, so the name and value are
+	 * decoded where they lie in the pax header buffer.
+	 */
+	url_decode(name);
+	value_len = base64_decode(value, value_length);
 
-	archive_entry_xattr_add_entry(entry, name_decoded,
-		value_decoded, value_len);
+	archive_entry_xattr_add_entry(entry, name, value, value_len);
 
-	free(name_decoded);
-	free(value_decoded);
 	return 0;
 }
 
@@ -1862,7 +1935,8 @@ pax_attribute_acl(struct archive_read *a, struct tar *tar,
 
 /*
  * Parse a single key=value attribute.  key/value pointers are
- * assumed to point into reasonably long-lived storage.
+ * assumed to point into reasonably long-lived storage, which
+ * may be modified to decode values in place.
  *
  * Note that POSIX reserves all-lowercase keywords.  Vendor-specific
  * extensions should always have keywords of the form "VENDOR.attribute"
@@ -1875,15 +1949,12 @@ pax_attribute_acl(struct archive_read *a, struct tar *tar,
  */
 static int
 pax_attribute(struct archive_read *a, struct tar *tar,
-    struct archive_entry *entry, const char *key, const char *value, size_t value_length)
+    struct archive_entry *entry, char *key, char *value, size_t value_length)
 {
 	int64_t s;
 	long n;
 	int err = ARCHIVE_OK, r;
 
-	if (value == NULL)
-		value = "";	/* Disable compiler warning; do not pass
-				 * NULL pointer to strlen().  */
 	switch (key[0]) {
 	case 'G':
 		/* Reject GNU.sparse.* headers on non-regular files. */
@@ -1982,7 +2053,8 @@ pax_attribute(struct archive_read *a, struct tar *tar,
 			}
 		}
 		if (memcmp(key, "LIBARCHIVE.xattr.", 17) == 0)
-			pax_attribute_xattr(entry, key, value);
+			pax_attribute_xattr(entry, key, value,
+			    value_length);
 		break;
 	case 'R':
 		/* GNU tar uses RHT.security header to store SELinux xattrs
@@ -1994,7 +2066,11 @@ pax_attribute(struct archive_read *a, struct tar *tar,
 		break;
 	case 'S':
 		/* We support some keys used by the "star" archiver */
-		if (strcmp(key, "SCHILY.acl.access") == 0) {
+		/* Extended attributes are by far the most common. */
+		if (strncmp(key, "SCHILY.xattr.", 13) == 0) {
+			pax_attribute_schily_xattr(entry, key, value,
+			    value_length);
+		} else if (strcmp(key, "SCHILY.acl.access") == 0) {
 			r = pax_attribute_acl(a, tar, entry, value,
 			    ARCHIVE_ENTRY_ACL_TYPE_ACCESS);
 			if (r == ARCHIVE_FATAL)
@@ -2030,9 +2106,6 @@ pax_attribute(struct archive_read *a, struct tar *tar,
 			tar->realsize = tar_atol10(value, strlen(value));
 			tar->realsize_override = 1;
 			archive_entry_set_size(entry, tar->realsize);
-		} else if (strncmp(key, "SCHILY.xattr.", 13) == 0) {
-			pax_attribute_schily_xattr(entry, key, value,
-			    value_length);
 		} else if (strcmp(key, "SUN.holesdata") == 0) {
 			/* A Solaris extension for sparse. */
 			r = solaris_sparse_parse(a, tar, entry, value);
@@ -2821,6 +2894,43 @@ readline(struct archive_read *a, struct tar *tar, const char **start,
 	}
 }
 
+#define	BX	0xff	/* Not a base-64 digit. */
+#define	BP	0xfe	/* Padding. */
+static const unsigned char base64_table[256] = {
+	BX, BX, BX, BX, BX, BX, BX, BX,
+	BX, BX, BX, BX, BX, BX, BX, BX, /* 00 - 0F */
+	BX, BX, BX, BX, BX, BX, BX, BX,
+	BX, BX, BX, BX, BX, BX, BX, BX, /* 10 - 1F */
+	BX, BX, BX, BX, BX, BX, BX, BX,
+	BX, BX, BX, 62, BX, BX, BX, 63, /* 20 - 2F */
+	52, 53, 54, 55, 56, 57, 58, 59,
+	60, 61, BX, BX, BX, BP, BX, BX, /* 30 - 3F */
+	BX,  0,  1,  2,  3,  4,  5,  6,
+	 7,  8,  9, 10, 11, 12, 13, 14, /* 40 - 4F */
+	15, 16, 17, 18, 19, 20, 21, 22,
+	23, 24, 25, BX, BX, BX, BX, BP, /* 50 - 5F */
+	BX, 26, 27, 28, 29, 30, 31, 32,
+	33, 34, 35, 36, 37, 38, 39, 40, /* 60 - 6F */
+	41, 42, 43, 44, 45, 46, 47, 48,
+	49, 50, 51, BX, BX, BX, BX, BX, /* 70 - 7F */
+	BX, BX, BX, BX, BX, BX, BX, BX,
+	BX, BX, BX, BX, BX, BX, BX, BX, /* 80 - 8F */
+	BX, BX, BX, BX, BX, BX, BX, BX,
+	BX, BX, BX, BX, BX, BX, BX, BX, /* 90 - 9F */
+	BX, BX, BX, BX, BX, BX, BX, BX,
+	BX, BX, BX, BX, BX, BX, BX, BX, /* A0 - AF */
+	BX, BX, BX, BX, BX, BX, BX, BX,
+	BX, BX, BX, BX, BX, BX, BX, BX, /* B0 - BF */
+	BX, BX, BX, BX, BX, BX, BX, BX,
+	BX, BX, BX, BX, BX, BX, BX, BX, /* C0 - CF */
+	BX, BX, BX, BX, BX, BX, BX, BX,
+	BX, BX, BX, BX, BX, BX, BX, BX, /* D0 - DF */
+	BX, BX, BX, BX, BX, BX, BX, BX,
+	BX, BX, BX, BX, BX, BX, BX, BX, /* E0 - EF */
+	BX, BX, BX, BX, BX, BX, BX, BX,
+	BX, BX, BX, BX, BX, BX, BX, BX, /* F0 - FF */
+};
+
 /*
  * base64_decode - Base64 decode
  *
@@ -2829,56 +2939,51 @@ readline(struct archive_read *a, struct tar *tar, const char **start,
  *    * with or without the final group padded with '=' or '_' characters
  * (The most economical Base-64 variant does not pad the last group and
  * omits line breaks; RFC1341 used for MIME requires both.)
+ *
+ * The output never overtakes the input, so `s' is decoded in place;
+ * the length of the result is returned.
  */
-static char *
-base64_decode(const char *s, size_t len, size_t *out_len)
+static size_t
+base64_decode(char *s, size_t len)
 {
-	static const unsigned char digits[64] = {
-		'A','B','C','D','E','F','G','H','I','J','K','L','M','N',
-		'O','P','Q','R','S','T','U','V','W','X','Y','Z','a','b',
-		'c','d','e','f','g','h','i','j','k','l','m','n','o','p',
-		'q','r','s','t','u','v','w','x','y','z','0','1','2','3',
-		'4','5','6','7','8','9','+','/' };
-	static unsigned char decode_table[128];
-	char *out, *d;
 	const unsigned char *src = (const unsigned char *)s;
-
-	/* If the decode table is not yet initialized, prepare it. */
-	if (decode_table[digits[1]] != 1) {
-		unsigned i;
-		memset(decode_table, 0xff, sizeof(decode_table));
-		for (i = 0; i < sizeof(digits); i++)
-			decode_table[digits[i]] = i;
-	}
-
-	/* Allocate enough space to hold the entire output. */
-	/* Note that we may not use all of this... */
-	out = (char *)malloc(len - len / 4 + 1);
-	if (out == NULL) {
-		*out_len = 0;
-		return (NULL);
-	}
-	d = out;
+	unsigned char *d = (unsigned char *)s;
+	unsigned v;
+	int group_size;
 
 	while (len > 0) {
+		/* Fast path: four base-64 digits in a row. */
+		if (len >= 4 && (base64_table[src[0]] | base64_table[src[1]] |
+		    base64_table[src[2]] | base64_table[src[3]]) < 64) {
+			v = (base64_table[src[0]] << 18) |
+			    (base64_table[src[1]] << 12) |
+			    (base64_table[src[2]] << 6) | base64_table[src[3]];
+			d[0] = (v >> 16) & 0xff;
+			d[1] = (v >> 8) & 0xff;
+			d[2] = v & 0xff;
+			d += 3;
+			src += 4;
+			len -= 4;
+			continue;
+		}
+
 		/* Collect the next group of (up to) four characters. */
-		int v = 0;
-		int group_size = 0;
+		group_size = 0;
+		v = 0;
 		while (group_size < 4 && len > 0) {
 			/* '=' or '_' padding indicates final group. */
-			if (*src == '=' || *src == '_') {
+			if (base64_table[*src] == BP) {
 				len = 0;
 				break;
 			}
 			/* Skip illegal characters (including line breaks) */
-			if (*src > 127 || *src < 32
-			    || decode_table[*src] == 0xff) {
+			if (base64_table[*src] == BX) {
 				len--;
 				src++;
 				continue;
 			}
 			v <<= 6;
-			v |= decode_table[*src++];
+			v |= base64_table[*src++];
 			len --;
 			group_size++;
 		}
@@ -2898,20 +3003,20 @@ base64_decode(const char *s, size_t len, size_t *out_len)
 		d += group_size * 3 / 4;
 	}
 
-	*out_len = d - out;
-	return (out);
+	return (d - (unsigned char *)s);
 }
+#undef BX
+#undef BP
 
-static char *
-url_decode(const char *in)
+/*
+ * Decode %-escapes in place; the result is never longer than the input.
+ */
+static void
+url_decode(char *s)
 {
-	char *out, *d;
-	const char *s;
+	char *d;
 
-	out = (char *)malloc(strlen(in) + 1);
-	if (out == NULL)
-		return (NULL);
-	for (s = in, d = out; *s != '\0'; ) {
+	for (d = s; *s != '\0'; ) {
 		if (s[0] == '%' && s[1] != '\0' && s[2] != '\0') {
 			/* Try to convert % escape */
 			int digit1 = tohex(s[1]);
@@ -2928,7 +3033,6 @@ url_decode(const char *in)
 		*d++ = *s++;
 	}
 	*d = '\0';
-	return (out);
 }
 
 static int
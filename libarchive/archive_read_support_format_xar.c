@@ -199,7 +199,7 @@ struct xar_file {
 };
 
 struct hdlink {
-	struct hdlink		 *next;
+	struct hdlink		 *next;	/* Hash chain. */
 
 	unsigned int		 id;
 	int			 cnt;
@@ -345,7 +345,14 @@ struct xar {
 	struct xattr		*xattr; /* current reading extended attribute. */
 	struct heap_queue	 file_queue;
 	struct xar_file		*hdlink_orgs;
-	struct hdlink		*hdlink_list;
+	/*
+	 * Hardlink groups hashed by link id; the table is grown as
+	 * groups are added so lookups stay cheap for large TOCs.
+	 */
+#define HDLINK_HASH_MIN	256
+	struct hdlink		**hdlink_hash;
+	size_t			 hdlink_hash_size;
+	size_t			 hdlink_count;
 
 	int	 		 entry_init;
 	uint64_t		 entry_total;
@@ -389,6 +396,7 @@ static time_t	parse_time(const char *p, size_t n);
 static int	heap_add_entry(struct archive_read *a,
     struct heap_queue *, struct xar_file *);
 static struct xar_file *heap_get_entry(struct heap_queue *);
+static int	hdlink_hash_grow(struct archive_read *, struct xar *);
 static int	add_link(struct archive_read *,
     struct xar *, struct xar_file *);
 static void	checksum_init(struct archive_read *, int, int);
@@ -634,8 +642,11 @@ read_toc(struct archive_read *a)
 	for (file = xar->hdlink_orgs; file != NULL; file = file->hdnext) {
 		struct hdlink **hdlink;
 
-		for (hdlink = &(xar->hdlink_list); *hdlink != NULL;
-		    hdlink = &((*hdlink)->next)) {
+		if (xar->hdlink_hash == NULL)
+			break;
+		for (hdlink = &(xar->hdlink_hash[
+		    (unsigned)file->id & (xar->hdlink_hash_size - 1)]);
+		    *hdlink != NULL; hdlink = &((*hdlink)->next)) {
 			if ((*hdlink)->id == file->id) {
 				struct hdlink *hltmp;
 				struct xar_file *f2;
@@ -648,10 +659,11 @@ read_toc(struct archive_read *a)
 					archive_string_copy(
 					    &(f2->hardlink), &(file->pathname));
 				}
-				/* Remove resolved files from hdlist_list. */
+				/* Remove resolved files from hdlink_hash. */
 				hltmp = *hdlink;
 				*hdlink = hltmp->next;
 				free(hltmp);
+				xar->hdlink_count--;
 				break;
 			}
 		}
@@ -948,19 +960,23 @@ xar_cleanup(struct archive_read *a)
 {
 	struct xar *xar;
 	struct hdlink *hdlink;
+	size_t n;
 	int i;
 	int r;
 
 	xar = (struct xar *)(a->format->data);
 	checksum_cleanup(a);
 	r = decompression_cleanup(a);
-	hdlink = xar->hdlink_list;
-	while (hdlink != NULL) {
-		struct hdlink *next = hdlink->next;
+	for (n = 0; n < xar->hdlink_hash_size; n++) {
+		hdlink = xar->hdlink_hash[n];
+		while (hdlink != NULL) {
+			struct hdlink *next = hdlink->next;
 
-		free(hdlink);
-		hdlink = next;
+			free(hdlink);
+			hdlink = next;
+		}
 	}
+	free(xar->hdlink_hash);
 	for (i = 0; i < xar->file_queue.used; i++)
 		file_free(xar->file_queue.files[i]);
 	free(xar->file_queue.files);
@@ -1326,12 +1342,50 @@ heap_get_entry(struct heap_queue *heap)
 	}
 }
 
+/*
+ * Double the hardlink hash table once it holds as many groups as it
+ * has buckets.  Link ids are assigned sequentially by xar writers, so
+ * the low bits of the id are used as the hash directly.
+ */
+static int
+hdlink_hash_grow(struct archive_read *a, struct xar *xar)
+{
+	struct hdlink **new_hash, *hdlink, *next;
+	size_t new_size, n;
+
+	if (xar->hdlink_hash_size == 0)
+		new_size = HDLINK_HASH_MIN;
+	else
+		new_size = xar->hdlink_hash_size * 2;
+	new_hash = calloc(new_size, sizeof(new_hash[0]));
+	if (new_hash == NULL) {
+		archive_set_error(&a->archive, ENOMEM, "Out of memory");
+		return (ARCHIVE_FATAL);
+	}
+	for (n = 0; n < xar->hdlink_hash_size; n++) {
+		for (hdlink = xar->hdlink_hash[n]; hdlink != NULL;
+		    hdlink = next) {
+			next = hdlink->next;
+			hdlink->next = new_hash[hdlink->id & (new_size - 1)];
+			new_hash[hdlink->id & (new_size - 1)] = hdlink;
+		}
+	}
+	free(xar->hdlink_hash);
+	xar->hdlink_hash = new_hash;
+	xar->hdlink_hash_size = new_size;
+	return (ARCHIVE_OK);
+}
+
 static int
 add_link(struct archive_read *a, struct xar *xar, struct xar_file *file)
 {
-	struct hdlink *hdlink;
+	struct hdlink *hdlink, **bucket;
 
-	for (hdlink = xar->hdlink_list; hdlink != NULL; hdlink = hdlink->next) {
+	if (xar->hdlink_count >= xar->hdlink_hash_size &&
+	    hdlink_hash_grow(a, xar) != ARCHIVE_OK)
+		return (ARCHIVE_FATAL);
+	bucket = &(xar->hdlink_hash[file->link & (xar->hdlink_hash_size - 1)]);
+	for (hdlink = *bucket; hdlink != NULL; hdlink = hdlink->next) {
 		if (hdlink->id == file->link) {
 			file->hdnext = hdlink->files;
 			hdlink->cnt++;
@@ -1348,8 +1402,9 @@ add_link(struct archive_read *a, struct xar *xar, struct xar_file *file)
 	hdlink->id = file->link;
 	hdlink->cnt = 1;
 	hdlink->files = file;
-	hdlink->next = xar->hdlink_list;
-	xar->hdlink_list = hdlink;
+	hdlink->next = *bucket;
+	*bucket = hdlink;
+	xar->hdlink_count++;
 	return (ARCHIVE_OK);
 }
 
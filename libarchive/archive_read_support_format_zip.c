@@ -72,6 +72,7 @@
 #include "archive_rb.h"
 #include "archive_read_private.h"
 #include "archive_ppmd8_private.h"
+#include "archive_zipcrypto_private.h"
 
 #ifndef HAVE_ZLIB_H
 #include "archive_crc32.h"
@@ -112,10 +113,6 @@ struct zip_entry {
 	}			aes_extra;
 };
 
-struct trad_enc_ctx {
-	uint32_t	keys[3];
-};
-
 /* Bits used in zip_flags. */
 #define ZIP_ENCRYPTED	(1 << 0)
 #define ZIP_LENGTH_AT_END	(1 << 3)
@@ -298,39 +295,12 @@ ppmd_read(void* p) {
   Traditional PKWARE Decryption functions.
  */
 
-static void
-trad_enc_update_keys(struct trad_enc_ctx *ctx, uint8_t c)
-{
-	uint8_t t;
-#define CRC32(c, b) (crc32(c ^ 0xffffffffUL, &b, 1) ^ 0xffffffffUL)
-
-	ctx->keys[0] = CRC32(ctx->keys[0], c);
-	ctx->keys[1] = (ctx->keys[1] + (ctx->keys[0] & 0xff)) * 134775813L + 1;
-	t = (ctx->keys[1] >> 24) & 0xff;
-	ctx->keys[2] = CRC32(ctx->keys[2], t);
-#undef CRC32
-}
-
-static uint8_t
-trad_enc_decrypt_byte(struct trad_enc_ctx *ctx)
-{
-	unsigned temp = ctx->keys[2] | 2;
-	return (uint8_t)((temp * (temp ^ 1)) >> 8) & 0xff;
-}
-
 static void
 trad_enc_decrypt_update(struct trad_enc_ctx *ctx, const uint8_t *in,
     size_t in_len, uint8_t *out, size_t out_len)
 {
-	unsigned i, max;
-
-	max = (unsigned)((in_len < out_len)? in_len: out_len);
-
-	for (i = 0; i < max; i++) {
-		uint8_t t = in[i] ^ trad_enc_decrypt_byte(ctx);
-		out[i] = t;
-		trad_enc_update_keys(ctx, t);
-	}
+	__archive_zipcrypto_decrypt(ctx, in, out,
+	    (in_len < out_len)? in_len: out_len);
 }
 
 static int
@@ -344,13 +314,7 @@ trad_enc_init(struct trad_enc_ctx *ctx, const char *pw, size_t pw_len,
 		return -1;
 	}
 
-	ctx->keys[0] = 305419896L;
-	ctx->keys[1] = 591751049L;
-	ctx->keys[2] = 878082192L;
-
-	for (;pw_len; --pw_len)
-		trad_enc_update_keys(ctx, *pw++);
-
+	__archive_zipcrypto_init(ctx, pw, pw_len);
 	trad_enc_decrypt_update(ctx, key, 12, header, 12);
 	/* Return the last byte for CRC check. */
 	*crcchk = header[11];
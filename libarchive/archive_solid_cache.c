@@ -0,0 +1,362 @@
+/*-
+ * Copyright (c) 2026 The libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archive_platform.h"
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#include "archive.h"
+#include "archive_endian.h"
+#include "archive_solid_cache_private.h"
+
+#define SOLID_CACHE_BUCKETS	256
+#define SOLID_CACHE_DEFAULT_LIMIT	(256 * 1024 * 1024)
+
+struct archive_solid_cache_entry {
+	struct archive_solid_cache_entry *hnext;	/* Hash chain. */
+	struct archive_solid_cache_entry *lru_prev;
+	struct archive_solid_cache_entry *lru_next;
+	struct archive_solid_cache_key	 key;
+	unsigned			 hash;
+	int				 refcnt;
+	void				*data;
+	size_t				 size;
+	void				(*free_data)(void *);
+};
+
+static struct {
+	struct archive_solid_cache_entry *buckets[SOLID_CACHE_BUCKETS];
+	/* lru_head is the most recently used entry. */
+	struct archive_solid_cache_entry *lru_head;
+	struct archive_solid_cache_entry *lru_tail;
+	size_t				 limit;
+	size_t				 used;
+	int64_t				 hits;
+} cache = { .limit = SOLID_CACHE_DEFAULT_LIMIT };
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t	solid_cache_mtx = PTHREAD_MUTEX_INITIALIZER;
+#define	CACHE_LOCK()	pthread_mutex_lock(&solid_cache_mtx)
+#define	CACHE_UNLOCK()	pthread_mutex_unlock(&solid_cache_mtx)
+#else
+#define	CACHE_LOCK()
+#define	CACHE_UNLOCK()
+#endif
+
+static unsigned
+key_hash(const struct archive_solid_cache_key *key)
+{
+	/* The digest is uniformly distributed already. */
+	return (archive_le32dec(key->digest) ^ key->format);
+}
+
+static int
+key_equal(const struct archive_solid_cache_key *a,
+    const struct archive_solid_cache_key *b)
+{
+	return (a->format == b->format &&
+	    memcmp(a->digest, b->digest, sizeof(a->digest)) == 0);
+}
+
+static void
+entry_free(struct archive_solid_cache_entry *e)
+{
+	if (e->free_data != NULL)
+		e->free_data(e->data);
+	free(e);
+}
+
+static void
+lru_unlink(struct archive_solid_cache_entry *e)
+{
+	if (e->lru_prev != NULL)
+		e->lru_prev->lru_next = e->lru_next;
+	else
+		cache.lru_head = e->lru_next;
+	if (e->lru_next != NULL)
+		e->lru_next->lru_prev = e->lru_prev;
+	else
+		cache.lru_tail = e->lru_prev;
+	e->lru_prev = e->lru_next = NULL;
+}
+
+static void
+lru_push_front(struct archive_solid_cache_entry *e)
+{
+	e->lru_prev = NULL;
+	e->lru_next = cache.lru_head;
+	if (cache.lru_head != NULL)
+		cache.lru_head->lru_prev = e;
+	else
+		cache.lru_tail = e;
+	cache.lru_head = e;
+}
+
+/*
+ * Drop an entry from the cache.  The entry itself is freed once its
+ * last reference goes away.  Must be called with the lock held; returns
+ * the entry if the caller has to free it after unlocking.
+ */
+static struct archive_solid_cache_entry *
+cache_remove(struct archive_solid_cache_entry *e)
+{
+	struct archive_solid_cache_entry **pp;
+
+	pp = &cache.buckets[e->hash % SOLID_CACHE_BUCKETS];
+	while (*pp != e)
+		pp = &(*pp)->hnext;
+	*pp = e->hnext;
+	e->hnext = NULL;
+	lru_unlink(e);
+	cache.used -= e->size;
+	if (--e->refcnt == 0)
+		return (e);
+	return (NULL);
+}
+
+/*
+ * Evict least recently used entries until `need' more bytes fit.
+ * Evicted entries are collected on `freelist' so that their payload is
+ * released outside the lock.
+ */
+static void
+cache_evict(size_t need, struct archive_solid_cache_entry **freelist)
+{
+	struct archive_solid_cache_entry *e;
+
+	while (cache.lru_tail != NULL &&
+	    (cache.used + need > cache.limit || cache.limit == 0)) {
+		e = cache_remove(cache.lru_tail);
+		if (e != NULL) {
+			e->hnext = *freelist;
+			*freelist = e;
+		}
+	}
+}
+
+static void
+free_list(struct archive_solid_cache_entry *e)
+{
+	struct archive_solid_cache_entry *next;
+
+	for (; e != NULL; e = next) {
+		next = e->hnext;
+		entry_free(e);
+	}
+}
+
+int
+archive_solid_cache_set_limit(la_int64_t limit)
+{
+	struct archive_solid_cache_entry *freelist = NULL;
+
+	if (limit < 0)
+		return (ARCHIVE_FAILED);
+	CACHE_LOCK();
+	if ((uint64_t)limit > SIZE_MAX)
+		cache.limit = SIZE_MAX;
+	else
+		cache.limit = (size_t)limit;
+	cache_evict(0, &freelist);
+	CACHE_UNLOCK();
+	free_list(freelist);
+	return (ARCHIVE_OK);
+}
+
+void
+archive_solid_cache_stats(la_int64_t *limit, la_int64_t *used,
+    la_int64_t *hits)
+{
+	CACHE_LOCK();
+	if (limit != NULL)
+		*limit = (la_int64_t)cache.limit;
+	if (used != NULL)
+		*used = (la_int64_t)cache.used;
+	if (hits != NULL)
+		*hits = cache.hits;
+	CACHE_UNLOCK();
+}
+
+size_t
+__archive_solid_cache_limit(void)
+{
+	size_t limit;
+
+	CACHE_LOCK();
+	limit = cache.limit;
+	CACHE_UNLOCK();
+	return (limit);
+}
+
+struct archive_solid_cache_entry *
+__archive_solid_cache_get(const struct archive_solid_cache_key *key)
+{
+	struct archive_solid_cache_entry *e;
+	unsigned hash = key_hash(key);
+
+	CACHE_LOCK();
+	for (e = cache.buckets[hash % SOLID_CACHE_BUCKETS]; e != NULL;
+	    e = e->hnext) {
+		if (e->hash == hash && key_equal(&e->key, key)) {
+			e->refcnt++;
+			lru_unlink(e);
+			lru_push_front(e);
+			cache.hits++;
+			break;
+		}
+	}
+	CACHE_UNLOCK();
+	return (e);
+}
+
+struct archive_solid_cache_entry *
+__archive_solid_cache_put(const struct archive_solid_cache_key *key,
+    void *data, size_t size, void (*free_data)(void *))
+{
+	struct archive_solid_cache_entry *e, *old, *freelist = NULL;
+	unsigned hash = key_hash(key);
+
+	e = malloc(sizeof(*e));
+	if (e == NULL)
+		return (NULL);
+	e->key = *key;
+	e->hash = hash;
+	e->data = data;
+	e->size = size;
+	e->free_data = free_data;
+	/* One reference for the cache and one for the caller. */
+	e->refcnt = 2;
+
+	CACHE_LOCK();
+	if (size > cache.limit) {
+		CACHE_UNLOCK();
+		free(e);
+		return (NULL);
+	}
+	/* Replace an older entry with the same key. */
+	for (old = cache.buckets[hash % SOLID_CACHE_BUCKETS]; old != NULL;
+	    old = old->hnext) {
+		if (old->hash == hash && key_equal(&old->key, key)) {
+			old = cache_remove(old);
+			if (old != NULL) {
+				old->hnext = freelist;
+				freelist = old;
+			}
+			break;
+		}
+	}
+	cache_evict(size, &freelist);
+	e->hnext = cache.buckets[hash % SOLID_CACHE_BUCKETS];
+	cache.buckets[hash % SOLID_CACHE_BUCKETS] = e;
+	lru_push_front(e);
+	cache.used += size;
+	CACHE_UNLOCK();
+	free_list(freelist);
+	return (e);
+}
+
+void *
+__archive_solid_cache_data(struct archive_solid_cache_entry *e,
+    size_t *size)
+{
+	if (size != NULL)
+		*size = e->size;
+	return (e->data);
+}
+
+struct archive_solid_cache_entry *
+__archive_solid_cache_ref(struct archive_solid_cache_entry *e)
+{
+	CACHE_LOCK();
+	e->refcnt++;
+	CACHE_UNLOCK();
+	return (e);
+}
+
+void
+__archive_solid_cache_release(struct archive_solid_cache_entry *e)
+{
+	int last;
+
+	if (e == NULL)
+		return;
+	CACHE_LOCK();
+	last = (--e->refcnt == 0);
+	CACHE_UNLOCK();
+	if (last)
+		entry_free(e);
+}
+
+int
+__archive_solid_cache_parse_size(const char *val, size_t *size)
+{
+	char *end;
+	unsigned long long v;
+
+	if (val == NULL || val[0] < '0' || val[0] > '9')
+		return (-1);
+	errno = 0;
+	v = strtoull(val, &end, 10);
+	if (errno != 0)
+		return (-1);
+	switch (*end) {
+	case 'g': case 'G':
+		if (v > (ULLONG_MAX >> 10))
+			return (-1);
+		v <<= 10;
+		/* FALLTHROUGH */
+	case 'm': case 'M':
+		if (v > (ULLONG_MAX >> 10))
+			return (-1);
+		v <<= 10;
+		/* FALLTHROUGH */
+	case 'k': case 'K':
+		if (v > (ULLONG_MAX >> 10))
+			return (-1);
+		v <<= 10;
+		end++;
+		break;
+	}
+	if (*end != '\0')
+		return (-1);
+	if (v > (unsigned long long)SIZE_MAX)
+		v = SIZE_MAX;
+	*size = (size_t)v;
+	return (0);
+}
@@ -0,0 +1,95 @@
+/*-
+ * Copyright (c) 2026 The libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARCHIVE_SOLID_CACHE_PRIVATE_H_INCLUDED
+#define ARCHIVE_SOLID_CACHE_PRIVATE_H_INCLUDED
+
+#ifndef __LIBARCHIVE_BUILD
+#error This header is only to be used internally to libarchive.
+#endif
+
+/*
+ * A process-wide, size-bounded LRU cache of decoded solid blocks.
+ *
+ * Readers of solid formats (7-Zip folders, RAR5 solid streams) have to
+ * decode everything that precedes the entry a caller asks for.  When the
+ * same archive is opened over and over again to pick different members,
+ * the decoded blocks can be shared between read handles through this
+ * cache.  Each read handle uses it only when told to through its
+ * "solid-cache" format option, which also bounds the size of the blocks
+ * that handle caches; the total size of the cache is set for the whole
+ * process with archive_solid_cache_set_limit().
+ *
+ * Entries are reference counted; an entry returned by
+ * __archive_solid_cache_get() or __archive_solid_cache_put() stays valid
+ * until it is handed back to __archive_solid_cache_release(), even if the
+ * cache evicts it in the meantime.
+ */
+
+#define ARCHIVE_SOLID_CACHE_7ZIP	0x377a6970	/* "7zip" */
+#define ARCHIVE_SOLID_CACHE_RAR5	0x72617235	/* "rar5" */
+
+#define ARCHIVE_SOLID_CACHE_DIGEST_SIZE	32	/* SHA-256 */
+
+/*
+ * Entries are keyed on a digest of everything the decoded data depends
+ * on, that is the packed data and the coder parameters; values read from
+ * archive headers alone would let a crafted archive claim the decoded
+ * data of another one.
+ */
+struct archive_solid_cache_key {
+	uint32_t	format;		/* One of ARCHIVE_SOLID_CACHE_* */
+	unsigned char	digest[ARCHIVE_SOLID_CACHE_DIGEST_SIZE];
+};
+
+struct archive_solid_cache_entry;
+
+/* Get the maximum number of bytes held by the cache. */
+size_t	__archive_solid_cache_limit(void);
+
+/* Look up an entry; returns NULL on a miss. */
+struct archive_solid_cache_entry *
+	__archive_solid_cache_get(const struct archive_solid_cache_key *);
+
+/*
+ * Insert `data' (`size' bytes accounted to the cache) under `key'.
+ * On success the cache takes ownership of `data' and releases it with
+ * `free_data' once the entry is evicted and unreferenced.  Returns NULL,
+ * leaving `data' with the caller, if the entry cannot be cached.
+ */
+struct archive_solid_cache_entry *
+	__archive_solid_cache_put(const struct archive_solid_cache_key *,
+	    void *data, size_t size, void (*free_data)(void *));
+
+void	*__archive_solid_cache_data(struct archive_solid_cache_entry *,
+	    size_t *);
+struct archive_solid_cache_entry *
+	__archive_solid_cache_ref(struct archive_solid_cache_entry *);
+void	__archive_solid_cache_release(struct archive_solid_cache_entry *);
+
+/* Parse a "solid-cache" option value (bytes, with optional k/m/g). */
+int	__archive_solid_cache_parse_size(const char *, size_t *);
+
+#endif /* ARCHIVE_SOLID_CACHE_PRIVATE_H_INCLUDED */
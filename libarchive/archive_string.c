@@ -108,6 +108,9 @@ struct archive_string_conv {
 #define SCONV_FROM_UTF16BE 	(1<<11)	/* "from charset" side is UTF-16BE. */
 #define SCONV_TO_UTF16LE 	(1<<12)	/* "to charset" side is UTF-16LE. */
 #define SCONV_FROM_UTF16LE 	(1<<13)	/* "from charset" side is UTF-16LE. */
+#define SCONV_ASCII_COMPAT	(1<<14)	/* Both charsets encode ASCII as
+					 * themselves, so ASCII input needs
+					 * no conversion. */
 #define SCONV_TO_UTF16		(SCONV_TO_UTF16BE | SCONV_TO_UTF16LE)
 #define SCONV_FROM_UTF16	(SCONV_FROM_UTF16BE | SCONV_FROM_UTF16LE)
 
@@ -1119,6 +1122,94 @@ canonical_charset_name(const char *charset)
 	return (charset);
 }
 
+/*
+ * Return 1 if `charset' is known to encode the ASCII range as plain
+ * single bytes, and never uses those bytes as parts of other characters
+ * or as shift sequences.
+ */
+static int
+ascii_compatible_charset(const char *charset)
+{
+	static const char *prefixes[] = {
+		"UTF-8", "UTF8", "ANSI_X3.4-19", "ASCII", "US-ASCII", "646",
+		"ISO-8859-", "ISO8859-", "ISO_8859-", "CP125", "WINDOWS-125",
+		"KOI8-", "EUC-", "EUCJP", "EUCKR", NULL
+	};
+	const char *p, *s;
+	int i;
+
+	if (charset == NULL)
+		return (0);
+	for (i = 0; prefixes[i] != NULL; i++) {
+		for (p = prefixes[i], s = charset; *p != '\0'; p++, s++) {
+			char c = *s;
+			if (c >= 'a' && c <= 'z')
+				c -= 'a' - 'A';
+			if (c != *p)
+				break;
+		}
+		if (*p == '\0')
+			return (1);
+	}
+	return (0);
+}
+
+/*
+ * Return 1 if strings in the current locale can be treated as ASCII
+ * when all of their bytes are in the ASCII range.
+ */
+static int
+locale_is_ascii_compatible(void)
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+	return (0);
+#else
+	return (ascii_compatible_charset(default_iconv_charset("")));
+#endif
+}
+
+/*
+ * Return the number of leading bytes of `s' (at most `n') that are ASCII
+ * characters other than NUL.  Eight bytes are tested at a time: a byte
+ * is flagged if its high bit is set or if subtracting one from it
+ * borrows, which only happens for NUL.
+ */
+static size_t
+ascii_run(const char *s, size_t n)
+{
+	const uint64_t ones = UINT64_C(0x0101010101010101);
+	const uint64_t highs = UINT64_C(0x8080808080808080);
+	size_t i = 0;
+	uint64_t v;
+
+	for (; n - i >= sizeof(v); i += sizeof(v)) {
+		memcpy(&v, s + i, sizeof(v));
+		if (((v - ones) | v) & highs)
+			break;
+	}
+	while (i < n && (unsigned char)s[i] - 1U < 0x7f)
+		i++;
+	return (i);
+}
+
+static int
+is_ascii(const char *p, size_t n)
+{
+	return (ascii_run(p, n) == n);
+}
+
+static int
+wcs_is_ascii(const wchar_t *p, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if ((unsigned long)p[i] > 0x7f)
+			return (0);
+	}
+	return (1);
+}
+
 /*
  * Create a string conversion object.
  */
@@ -1193,6 +1284,10 @@ create_sconv_object(const char *fc, const char *tc,
 		flag |= SCONV_FROM_UTF16BE;
 	else if (strcmp(fc, "UTF-16LE") == 0)
 		flag |= SCONV_FROM_UTF16LE;
+#if !defined(_WIN32) || defined(__CYGWIN__)
+	if (ascii_compatible_charset(fc) && ascii_compatible_charset(tc))
+		flag |= SCONV_ASCII_COMPAT;
+#endif
 #if defined(_WIN32) && !defined(__CYGWIN__)
 	if (sc->to_cp == CP_UTF8)
 		flag |= SCONV_TO_UTF8;
@@ -1988,9 +2083,11 @@ archive_strncat_l(struct archive_string *as, const void *_p, size_t n,
 	}
 
 	/*
-	 * If sc is NULL, we just make a copy.
+	 * If sc is NULL, we just make a copy. The same goes for ASCII text
+	 * between two charsets that both encode ASCII as themselves.
 	 */
-	if (sc == NULL) {
+	if (sc == NULL || ((sc->flag & SCONV_ASCII_COMPAT) &&
+	    is_ascii(_p, length))) {
 		if (archive_string_append(as, _p, length) == NULL)
 			return (-1);/* No memory */
 		return (0);
@@ -2637,6 +2734,75 @@ unicode_to_utf16le(char *p, size_t remaining, uint32_t uc)
 	}
 }
 
+/*
+ * Runs of ASCII characters are the same code points in every form, so
+ * the conversion loops below copy (or widen, or narrow) them in bulk
+ * instead of calling parse() and unparse() for each one.
+ */
+
+/* Number of leading ASCII characters, other than NUL, in UTF-16 text. */
+static size_t
+utf16_ascii_run(const char *s, size_t n, int be)
+{
+	const unsigned char *u = (const unsigned char *)s;
+	const int hi = be ? 0 : 1;
+	size_t i;
+
+	for (i = 0; i + 2 <= n; i += 2) {
+		if (u[i + hi] != 0 || u[i + 1 - hi] - 1U >= 0x7f)
+			break;
+	}
+	return (i / 2);
+}
+
+/*
+ * Copy `cnt' ASCII characters read by `parse' to `p' in the form written
+ * by `unparse'.  Returns the number of bytes written; the caller makes
+ * sure that there is enough room.
+ */
+static size_t
+copy_ascii_run(char *p, const char *s, size_t cnt,
+    int (*parse)(uint32_t *, const char *, size_t),
+    size_t (*unparse)(char *, size_t, uint32_t))
+{
+	const int from16 = (parse == utf16be_to_unicode ||
+	    parse == utf16le_to_unicode);
+	const int lo = (parse == utf16be_to_unicode) ? 1 : 0;
+	char *start = p;
+	size_t i;
+
+	if (!from16 && unparse == unicode_to_utf8) {
+		memcpy(p, s, cnt);
+		return (cnt);
+	}
+	for (i = 0; i < cnt; i++) {
+		const char c = from16 ? s[i * 2 + lo] : s[i];
+
+		if (unparse == unicode_to_utf8)
+			*p++ = c;
+		else if (unparse == unicode_to_utf16be) {
+			*p++ = 0;
+			*p++ = c;
+		} else {
+			*p++ = c;
+			*p++ = 0;
+		}
+	}
+	return (p - start);
+}
+
+/* Number of leading ASCII characters in text read by `parse'. */
+static size_t
+parse_ascii_run(const char *s, size_t n,
+    int (*parse)(uint32_t *, const char *, size_t))
+{
+	if (parse == utf16be_to_unicode)
+		return (utf16_ascii_run(s, n, 1));
+	if (parse == utf16le_to_unicode)
+		return (utf16_ascii_run(s, n, 0));
+	return (ascii_run(s, n));
+}
+
 /*
  * Copy UTF-8 string in checking surrogate pair.
  * If any surrogate pair are found, it would be canonicalized.
@@ -2665,7 +2831,12 @@ strncat_from_utf8_to_utf8(struct archive_string *as, const void *_p,
 		/*
 		 * Forward byte sequence until a conversion of that is needed.
 		 */
-		while ((n = utf8_to_unicode(&uc, s, len)) > 0) {
+		for (;;) {
+			w = ascii_run(s, len);
+			s += w;
+			len -= w;
+			if ((n = utf8_to_unicode(&uc, s, len)) <= 0)
+				break;
 			s += n;
 			len -= n;
 		}
@@ -2770,7 +2941,28 @@ archive_string_append_unicode(struct archive_string *as, const void *_p,
 	s = (const char *)_p;
 	p = as->s + as->length;
 	endp = as->s + as->buffer_length - ts;
-	while ((n = parse(&uc, s, len)) != 0) {
+	for (;;) {
+		size_t cnt = parse_ascii_run(s, len, parse);
+
+		if (cnt > 0) {
+			/* tm * len bytes are reserved for the remaining
+			 * input, which is enough for the ASCII run. */
+			while ((size_t)(endp - p) < cnt * ts) {
+				as->length = p - as->s;
+				if (archive_string_ensure(as,
+				    as->buffer_length + len * tm + ts) == NULL)
+					return (-1);
+				p = as->s + as->length;
+				endp = as->s + as->buffer_length - ts;
+			}
+			p += copy_ascii_run(p, s, cnt, parse, unparse);
+			if (parse != cesu8_to_unicode)
+				cnt *= 2;
+			s += cnt;
+			len -= cnt;
+		}
+		if ((n = parse(&uc, s, len)) == 0)
+			break;
 		if (n < 0) {
 			/* Use a replaced unicode character. */
 			n *= -1;
@@ -2994,6 +3186,25 @@ archive_string_normalize_C(struct archive_string *as, const void *_p,
 
 	p = as->s + as->length;
 	endp = as->s + as->buffer_length - ts;
+
+	/*
+	 * ASCII characters are already in NFC, and only the last one of
+	 * a run can be combined with what follows it; copy the others as
+	 * they are.
+	 */
+	{
+		size_t cnt = parse_ascii_run(s, len, parse);
+		size_t bytes;
+
+		if (cnt > 0 && cnt * (spair == 4 ? 2 : 1) < len)
+			cnt--;
+		bytes = cnt * (spair == 4 ? 2 : 1);
+		/* len * tm + ts bytes are reserved, which is enough. */
+		p += copy_ascii_run(p, s, cnt, parse, unparse);
+		s += bytes;
+		len -= bytes;
+	}
+
 	while ((n = parse(&uc, s, len)) != 0) {
 		const char *ucptr, *uc2ptr;
 
@@ -3861,6 +4072,17 @@ archive_mstring_clean(struct archive_mstring *aes)
 	aes->aes_set = 0;
 }
 
+/* Like archive_mstring_clean(), but keeps the buffers for reuse. */
+void
+archive_mstring_empty(struct archive_mstring *aes)
+{
+	archive_wstring_empty(&(aes->aes_wcs));
+	archive_string_empty(&(aes->aes_mbs));
+	archive_string_empty(&(aes->aes_utf8));
+	archive_string_empty(&(aes->aes_mbs_in_locale));
+	aes->aes_set = 0;
+}
+
 void
 archive_mstring_copy(struct archive_mstring *dest, struct archive_mstring *src)
 {
@@ -3889,6 +4111,18 @@ archive_mstring_get_utf8(struct archive *a, struct archive_mstring *aes,
 		const char *pm; /* unused */
 		archive_mstring_get_mbs(a, aes, &pm); /* ignore errors, we'll handle it later */
 	}
+	if ((aes->aes_set & AES_SET_MBS) &&
+	    is_ascii(aes->aes_mbs.s, aes->aes_mbs.length) &&
+	    locale_is_ascii_compatible()) {
+		/* ASCII text reads the same in UTF-8; this also avoids
+		 * creating a conversion object when `a' is NULL. */
+		if (archive_strncpy(&(aes->aes_utf8), aes->aes_mbs.s,
+		    aes->aes_mbs.length) == NULL)
+			return (-1);
+		aes->aes_set |= AES_SET_UTF8;
+		*p = aes->aes_utf8.s;
+		return (0);
+	}
 	if (aes->aes_set & AES_SET_MBS) {
 		sc = archive_string_conversion_to_charset(a, "UTF-8", 1);
 		if (sc == NULL)
@@ -3921,6 +4155,37 @@ archive_mstring_get_mbs(struct archive *a, struct archive_mstring *aes,
 	}
 
 	*p = NULL;
+	/* Plain ASCII in any form is the same string in an ASCII-compatible
+	 * locale; copy it instead of converting it. */
+	if ((aes->aes_set & (AES_SET_WCS | AES_SET_UTF8)) &&
+	    locale_is_ascii_compatible()) {
+		if ((aes->aes_set & AES_SET_UTF8) &&
+		    is_ascii(aes->aes_utf8.s, aes->aes_utf8.length)) {
+			if (archive_strncpy(&(aes->aes_mbs), aes->aes_utf8.s,
+			    aes->aes_utf8.length) == NULL)
+				return (-1);
+			aes->aes_set |= AES_SET_MBS;
+			*p = aes->aes_mbs.s;
+			return (0);
+		}
+		if ((aes->aes_set & AES_SET_WCS) &&
+		    wcs_is_ascii(aes->aes_wcs.s, aes->aes_wcs.length)) {
+			size_t i;
+
+			archive_string_empty(&(aes->aes_mbs));
+			if (archive_string_ensure(&(aes->aes_mbs),
+			    aes->aes_wcs.length + 1) == NULL)
+				return (-1);
+			for (i = 0; i < aes->aes_wcs.length; i++)
+				aes->aes_mbs.s[i] = (char)aes->aes_wcs.s[i];
+			aes->aes_mbs.s[i] = '\0';
+			aes->aes_mbs.length = i;
+			aes->aes_set |= AES_SET_MBS;
+			*p = aes->aes_mbs.s;
+			return (0);
+		}
+	}
+
 	/* If there's a WCS form, try converting with the native locale. */
 	if (aes->aes_set & AES_SET_WCS) {
 		archive_string_empty(&(aes->aes_mbs));
@@ -3973,6 +4238,24 @@ archive_mstring_get_wcs(struct archive *a, struct archive_mstring *aes,
 		const char *p; /* unused */
 		archive_mstring_get_mbs(a, aes, &p); /* ignore errors, we'll handle it later */
 	}
+	/* ASCII text only needs to be widened. */
+	if ((aes->aes_set & AES_SET_MBS) &&
+	    is_ascii(aes->aes_mbs.s, aes->aes_mbs.length) &&
+	    locale_is_ascii_compatible()) {
+		size_t i;
+
+		archive_wstring_empty(&(aes->aes_wcs));
+		if (archive_wstring_ensure(&(aes->aes_wcs),
+		    aes->aes_mbs.length + 1) == NULL)
+			return (-1);
+		for (i = 0; i < aes->aes_mbs.length; i++)
+			aes->aes_wcs.s[i] = (wchar_t)aes->aes_mbs.s[i];
+		aes->aes_wcs.s[i] = L'\0';
+		aes->aes_wcs.length = i;
+		aes->aes_set |= AES_SET_WCS;
+		*wp = aes->aes_wcs.s;
+		return (ret);
+	}
 	/* Try converting MBS to WCS using native locale. */
 	if (aes->aes_set & AES_SET_MBS) {
 		archive_wstring_empty(&(aes->aes_wcs));
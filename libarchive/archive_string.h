@@ -219,6 +219,7 @@ struct archive_mstring {
 };
 
 void	archive_mstring_clean(struct archive_mstring *);
+void	archive_mstring_empty(struct archive_mstring *);
 void	archive_mstring_copy(struct archive_mstring *dest, struct archive_mstring *src);
 int archive_mstring_get_mbs(struct archive *, struct archive_mstring *, const char **);
 int archive_mstring_get_utf8(struct archive *, struct archive_mstring *, const char **);
@@ -0,0 +1,475 @@
+/*-
+ * Copyright (c) 2026 The libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archive_platform.h"
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_IO_H
+#include <io.h>
+#endif
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "archive.h"
+#include "archive_private.h"
+#include "archive_string.h"
+#include "archive_tar_index_private.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+#ifndef O_CLOEXEC
+#define O_CLOEXEC	0
+#endif
+
+#define TAR_INDEX_MAGIC		"#tar-index 1"
+#define TAR_INDEX_BUFSIZE	(64 * 1024)
+
+struct tar_index_entry {
+	struct tar_index_entry	*next;
+	int64_t			 header_offset;
+	unsigned		 hash;
+	size_t			 len;
+	char			 pathname[1];
+};
+
+struct archive_tar_index {
+	/* Writing. */
+	struct archive_string	 filename;
+	int			 fd;
+	struct archive_string	 buf;
+
+	/* Reading. */
+
+	struct tar_index_entry	**hash;
+	size_t			 hash_size;
+	size_t			 count;
+};
+
+/*
+ * "dir" and "dir/" name the same member; the writers append the slash
+ * to directory names.
+ */
+static size_t
+name_length(const char *p, size_t len)
+{
+	while (len > 1 && p[len - 1] == '/')
+		len--;
+	return (len);
+}
+
+static unsigned
+name_hash(const char *p, size_t len)
+{
+	unsigned h = 2166136261U;
+
+	while (len-- > 0)
+		h = (h ^ (unsigned char)*p++) * 16777619U;
+	return (h);
+}
+
+static struct archive_tar_index *
+tar_index_new(void)
+{
+	struct archive_tar_index *idx;
+
+	idx = calloc(1, sizeof(*idx));
+	if (idx == NULL)
+		return (NULL);
+	idx->fd = -1;
+	archive_string_init(&idx->filename);
+	archive_string_init(&idx->buf);
+	return (idx);
+}
+
+static int
+tar_index_flush(struct archive *a, struct archive_tar_index *idx)
+{
+	const char *p = idx->buf.s;
+	size_t remaining = idx->buf.length;
+	ssize_t bytes;
+
+	while (remaining > 0) {
+		bytes = write(idx->fd, p, remaining);
+		if (bytes < 0) {
+			if (errno == EINTR)
+				continue;
+			archive_set_error(a, errno, "Can't write tar index");
+			return (ARCHIVE_FATAL);
+		}
+		p += bytes;
+		remaining -= bytes;
+	}
+	archive_string_empty(&idx->buf);
+	return (ARCHIVE_OK);
+}
+
+int
+__archive_tar_index_create(struct archive *a,
+    struct archive_tar_index **pidx, const char *filename)
+{
+	struct archive_tar_index *idx;
+
+	idx = tar_index_new();
+	if (idx == NULL) {
+		archive_set_error(a, ENOMEM, "Can't allocate tar index");
+		return (ARCHIVE_FATAL);
+	}
+	/* The file is created once the first member is written. */
+	archive_strcpy(&idx->filename, filename);
+	archive_strcat(&idx->buf, TAR_INDEX_MAGIC "\n");
+	*pidx = idx;
+	return (ARCHIVE_OK);
+}
+
+static int
+tar_index_open(struct archive *a, struct archive_tar_index *idx)
+{
+	idx->fd = open(idx->filename.s,
+	    O_WRONLY | O_CREAT | O_TRUNC | O_BINARY | O_CLOEXEC, 0666);
+	if (idx->fd < 0) {
+		archive_set_error(a, errno, "Can't open tar index %s",
+		    idx->filename.s);
+		return (ARCHIVE_FATAL);
+	}
+	__archive_ensure_cloexec_flag(idx->fd);
+	return (ARCHIVE_OK);
+}
+
+int
+__archive_tar_index_add(struct archive *a, struct archive_tar_index *idx,
+    const char *pathname, int64_t header_offset, int64_t data_offset,
+    int64_t size)
+{
+	const char *p;
+
+	archive_string_sprintf(&idx->buf, "%jd %jd %jd ",
+	    (intmax_t)header_offset, (intmax_t)data_offset, (intmax_t)size);
+	for (p = pathname; *p != '\0'; p++) {
+		if (*p == '\\')
+			archive_strcat(&idx->buf, "\\\\");
+		else if (*p == '\n')
+			archive_strcat(&idx->buf, "\\n");
+		else
+			archive_strappend_char(&idx->buf, *p);
+	}
+	archive_strappend_char(&idx->buf, '\n');
+	if (idx->buf.length < TAR_INDEX_BUFSIZE)
+		return (ARCHIVE_OK);
+	if (idx->fd < 0 && tar_index_open(a, idx) != ARCHIVE_OK)
+		return (ARCHIVE_FATAL);
+	return (tar_index_flush(a, idx));
+}
+
+int
+__archive_tar_index_close(struct archive *a, struct archive_tar_index *idx)
+{
+	int r;
+
+	if (idx == NULL || idx->filename.length == 0)
+		return (ARCHIVE_OK);
+	if (idx->fd < 0 && tar_index_open(a, idx) != ARCHIVE_OK)
+		return (ARCHIVE_FATAL);
+	r = tar_index_flush(a, idx);
+	if (close(idx->fd) != 0 && r == ARCHIVE_OK) {
+		archive_set_error(a, errno, "Can't close tar index");
+		r = ARCHIVE_FATAL;
+	}
+	idx->fd = -1;
+	archive_string_empty(&idx->filename);
+	return (r);
+}
+
+static int
+tar_index_insert(struct archive_tar_index *idx, const char *pathname,
+    size_t len, int64_t header_offset)
+{
+	struct tar_index_entry *e, **pp;
+	unsigned h;
+	size_t i;
+
+	len = name_length(pathname, len);
+	h = name_hash(pathname, len);
+
+	/* A later member of the same name replaces an earlier one. */
+	if (idx->hash_size > 0) {
+		for (e = idx->hash[h & (idx->hash_size - 1)]; e != NULL;
+		    e = e->next) {
+			if (e->hash == h && e->len == len &&
+			    memcmp(e->pathname, pathname, len) == 0) {
+				e->header_offset = header_offset;
+				return (0);
+			}
+		}
+	}
+
+	if (idx->count >= idx->hash_size) {
+		struct tar_index_entry **hash, *next;
+		size_t size = idx->hash_size ? idx->hash_size * 2 : 1024;
+
+		hash = calloc(size, sizeof(*hash));
+		if (hash == NULL)
+			return (-1);
+		for (i = 0; i < idx->hash_size; i++) {
+			for (e = idx->hash[i]; e != NULL; e = next) {
+				next = e->next;
+				pp = &hash[e->hash & (size - 1)];
+				e->next = *pp;
+				*pp = e;
+			}
+		}
+		free(idx->hash);
+		idx->hash = hash;
+		idx->hash_size = size;
+	}
+
+	e = malloc(sizeof(*e) + len);
+	if (e == NULL)
+		return (-1);
+	e->header_offset = header_offset;
+	e->hash = h;
+	e->len = len;
+	memcpy(e->pathname, pathname, len);
+	e->pathname[len] = '\0';
+	pp = &idx->hash[h & (idx->hash_size - 1)];
+	e->next = *pp;
+	*pp = e;
+	idx->count++;
+	return (0);
+}
+
+static int
+parse_number(const char **pp, int64_t *v)
+{
+	const char *p = *pp;
+	int64_t n = 0;
+
+	if (*p < '0' || *p > '9')
+		return (-1);
+	while (*p >= '0' && *p <= '9') {
+		if (n > (INT64_MAX - (*p - '0')) / 10)
+			return (-1);
+		n = n * 10 + (*p++ - '0');
+	}
+	if (*p++ != ' ')
+		return (-1);
+	*pp = p;
+	*v = n;
+	return (0);
+}
+
+/*
+ * Parse one line of the index, without its trailing newline.
+ */
+static int
+tar_index_parse_line(struct archive_tar_index *idx,
+    struct archive_string *name, const char *p)
+{
+	int64_t header_offset, data_offset, size;
+
+	if (parse_number(&p, &header_offset) != 0 ||
+	    parse_number(&p, &data_offset) != 0 ||
+	    parse_number(&p, &size) != 0 || *p == '\0')
+		return (1);
+	archive_string_empty(name);
+	for (; *p != '\0'; p++) {
+		if (*p != '\\') {
+			archive_strappend_char(name, *p);
+			continue;
+		}
+		if (p[1] == '\\')
+			archive_strappend_char(name, '\\');
+		else if (p[1] == 'n')
+			archive_strappend_char(name, '\n');
+		else
+			return (1);
+		p++;
+	}
+	return (tar_index_insert(idx, name->s, name->length, header_offset));
+}
+
+int
+__archive_tar_index_load(struct archive *a,
+    struct archive_tar_index **pidx, const char *filename)
+{
+	struct archive_tar_index *idx;
+	struct archive_string line, name;
+	char *buff, *p, *nl;
+	const char *s;
+	ssize_t bytes;
+	size_t lineno = 0;
+	int fd, r = ARCHIVE_OK;
+
+	idx = tar_index_new();
+	buff = malloc(TAR_INDEX_BUFSIZE);
+	if (idx == NULL || buff == NULL) {
+		free(idx);
+		free(buff);
+		archive_set_error(a, ENOMEM, "Can't allocate tar index");
+		return (ARCHIVE_FATAL);
+	}
+	fd = open(filename, O_RDONLY | O_BINARY | O_CLOEXEC);
+	if (fd < 0) {
+		archive_set_error(a, errno, "Can't open tar index %s",
+		    filename);
+		free(buff);
+		__archive_tar_index_free(idx);
+		return (ARCHIVE_FAILED);
+	}
+	__archive_ensure_cloexec_flag(fd);
+	archive_string_init(&line);
+	archive_string_init(&name);
+
+	for (;;) {
+		bytes = read(fd, buff, TAR_INDEX_BUFSIZE);
+		if (bytes < 0) {
+			if (errno == EINTR)
+				continue;
+			archive_set_error(a, errno, "Can't read tar index %s",
+			    filename);
+			r = ARCHIVE_FAILED;
+			break;
+		}
+		if (bytes == 0) {
+			if (line.length > 0) {
+				archive_set_error(a, ARCHIVE_ERRNO_FILE_FORMAT,
+				    "%s: Truncated tar index", filename);
+				r = ARCHIVE_FAILED;
+			}
+			break;
+		}
+		for (p = buff; p < buff + bytes; p = nl + 1) {
+			nl = memchr(p, '\n', buff + bytes - p);
+			if (nl == NULL) {
+				archive_strncat(&line, p, buff + bytes - p);
+				break;
+			}
+			archive_strncat(&line, p, nl - p);
+			s = (line.length > 0) ? line.s : "";
+			if (++lineno == 1) {
+				if (strcmp(s, TAR_INDEX_MAGIC) != 0) {
+					archive_set_error(a,
+					    ARCHIVE_ERRNO_FILE_FORMAT,
+					    "%s: Not a tar index", filename);
+					r = ARCHIVE_FAILED;
+				}
+			} else {
+				switch (tar_index_parse_line(idx, &name, s)) {
+				case 0:
+					break;
+				case 1:
+					archive_set_error(a,
+					    ARCHIVE_ERRNO_FILE_FORMAT,
+					    "%s: Malformed tar index at line %ju",
+					    filename, (uintmax_t)lineno);
+					r = ARCHIVE_FAILED;
+					break;
+				default:
+					archive_set_error(a, ENOMEM,
+					    "Can't allocate tar index");
+					r = ARCHIVE_FATAL;
+					break;
+				}
+			}
+			if (r != ARCHIVE_OK)
+				break;
+			archive_string_empty(&line);
+		}
+		if (r != ARCHIVE_OK)
+			break;
+	}
+	if (r == ARCHIVE_OK && lineno == 0) {
+		archive_set_error(a, ARCHIVE_ERRNO_FILE_FORMAT,
+		    "%s: Not a tar index", filename);
+		r = ARCHIVE_FAILED;
+	}
+	close(fd);
+	free(buff);
+	archive_string_free(&line);
+	archive_string_free(&name);
+	if (r != ARCHIVE_OK) {
+		__archive_tar_index_free(idx);
+		return (r);
+	}
+	*pidx = idx;
+	return (ARCHIVE_OK);
+}
+
+int
+__archive_tar_index_find(struct archive_tar_index *idx,
+    const char *pathname, int64_t *header_offset)
+{
+	struct tar_index_entry *e;
+	size_t len;
+	unsigned h;
+
+	if (idx->hash_size == 0)
+		return (-1);
+	len = name_length(pathname, strlen(pathname));
+	h = name_hash(pathname, len);
+	for (e = idx->hash[h & (idx->hash_size - 1)]; e != NULL;
+	    e = e->next) {
+		if (e->hash == h && e->len == len &&
+		    memcmp(e->pathname, pathname, len) == 0) {
+			*header_offset = e->header_offset;
+			return (0);
+		}
+	}
+	return (-1);
+}
+
+void
+__archive_tar_index_free(struct archive_tar_index *idx)
+{
+	struct tar_index_entry *e, *next;
+	size_t i;
+
+	if (idx == NULL)
+		return;
+	if (idx->fd >= 0)
+		close(idx->fd);
+	for (i = 0; i < idx->hash_size; i++) {
+		for (e = idx->hash[i]; e != NULL; e = next) {
+			next = e->next;
+			free(e);
+		}
+	}
+	free(idx->hash);
+	archive_string_free(&idx->filename);
+	archive_string_free(&idx->buf);
+	free(idx);
+}
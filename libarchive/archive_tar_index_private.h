@@ -0,0 +1,69 @@
+/*-
+ * Copyright (c) 2026 The libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARCHIVE_TAR_INDEX_PRIVATE_H_INCLUDED
+#define ARCHIVE_TAR_INDEX_PRIVATE_H_INCLUDED
+
+#ifndef __LIBARCHIVE_BUILD
+#error This header is only to be used internally to libarchive.
+#endif
+
+/*
+ * A sidecar index of a tar archive, written by the tar writers when
+ * the "index" option is given and used by the tar reader to seek
+ * straight to a member.
+ *
+ * The index is a text file.  The first line is "#tar-index 1"; every
+ * following line describes one member as
+ *
+ *	<header offset> <data offset> <size> <pathname>
+ *
+ * where the offsets are decimal byte offsets into the uncompressed tar
+ * stream of the first header block belonging to the member (including
+ * any pax extended or GNU long name headers) and of its data.  In the
+ * pathname, backslash and newline are written as "\\" and "\n".
+ */
+
+struct archive_tar_index;
+
+/* Writing. */
+int	__archive_tar_index_create(struct archive *,
+	    struct archive_tar_index **, const char *filename);
+int	__archive_tar_index_add(struct archive *, struct archive_tar_index *,
+	    const char *pathname, int64_t header_offset, int64_t data_offset,
+	    int64_t size);
+int	__archive_tar_index_close(struct archive *,
+	    struct archive_tar_index *);
+
+/* Reading. */
+int	__archive_tar_index_load(struct archive *,
+	    struct archive_tar_index **, const char *filename);
+/* Returns 0 and the header offset of the last member named `pathname'. */
+int	__archive_tar_index_find(struct archive_tar_index *,
+	    const char *pathname, int64_t *header_offset);
+
+void	__archive_tar_index_free(struct archive_tar_index *);
+
+#endif /* ARCHIVE_TAR_INDEX_PRIVATE_H_INCLUDED */
@@ -49,6 +49,9 @@
 #ifdef HAVE_SYS_IOCTL_H
 #include <sys/ioctl.h>
 #endif
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
 #ifdef HAVE_SYS_STAT_H
 #include <sys/stat.h>
 #endif
@@ -308,8 +311,31 @@ struct archive_write_disk {
 	int			 stream_valid;
 	int			 decmpfs_compression_level;
 #endif
+
+	/*
+	 * ARCHIVE_EXTRACT_DURABLE: regular files that are complete but
+	 * still under their temporary names, waiting for the next batch
+	 * sync and rename.
+	 */
+	struct durable_file	*durable;
+	int			 durable_count;
+	int			 durable_alloc;
+	int64_t			 durable_bytes;
+	int			 durable_max_files;
+	int64_t			 durable_max_bytes;
 };
 
+struct durable_file {
+	char			*tmpname;
+	char			*name;	/* Points into the tmpname allocation. */
+	int			 fd;	/* Open until the batch is synced. */
+	dev_t			 dev;
+};
+
+/* Default batch window for ARCHIVE_EXTRACT_DURABLE. */
+#define	DURABLE_MAX_FILES	128
+#define	DURABLE_MAX_BYTES	(64 * 1024 * 1024)
+
 /*
  * Default mode for dirs created automatically (will be modified by umask).
  * Note that POSIX specifies 0777 for implicitly-created dirs, "modified
@@ -357,6 +383,11 @@ struct archive_write_disk {
 
 static int	la_opendirat(int, const char *);
 static int	la_mktemp(struct archive_write_disk *);
+static int	durable_add(struct archive_write_disk *);
+static int	durable_clamp_files(int);
+static int	durable_flush(struct archive_write_disk *);
+static int	durable_pending(struct archive_write_disk *, const char *);
+static void	durable_release(struct archive_write_disk *);
 static int	la_verify_filetype(mode_t, __LA_MODE_T);
 static void	fsobj_error(int *, struct archive_string *, int, const char *,
 		    const char *);
@@ -433,6 +464,192 @@ la_mktemp(struct archive_write_disk *a)
 	return fd;
 }
 
+/*
+ * Queue the current temporary file for a batched sync and rename.
+ * Returns -1, leaving the file alone, if it can't be queued.
+ */
+static int
+durable_add(struct archive_write_disk *a)
+{
+	struct durable_file *df;
+	struct stat st;
+	size_t tlen, nlen;
+	int i;
+
+	if (fstat(a->fd, &st) != 0)
+		return (-1);
+	if (a->durable_count >= a->durable_alloc) {
+		int n = a->durable_alloc == 0 ? 16 : a->durable_alloc * 2;
+		df = realloc(a->durable, n * sizeof(*df));
+		if (df == NULL)
+			return (-1);
+		a->durable = df;
+		a->durable_alloc = n;
+	}
+	df = &a->durable[a->durable_count];
+	tlen = strlen(a->tmpname) + 1;
+	nlen = strlen(a->name) + 1;
+	df->tmpname = malloc(tlen + nlen);
+	if (df->tmpname == NULL)
+		return (-1);
+	memcpy(df->tmpname, a->tmpname, tlen);
+	df->name = df->tmpname + tlen;
+	memcpy(df->name, a->name, nlen);
+	df->dev = st.st_dev;
+	df->fd = a->fd;
+#ifdef HAVE_SYNCFS
+	/* One descriptor per filesystem is enough for syncfs(). */
+	for (i = 0; i < a->durable_count; i++) {
+		if (a->durable[i].fd >= 0 && a->durable[i].dev == st.st_dev) {
+			close(df->fd);
+			df->fd = -1;
+			break;
+		}
+	}
+#else
+	(void)i; /* UNUSED */
+#endif
+	a->durable_count++;
+	a->durable_bytes += st.st_size;
+	a->fd = -1;
+	a->tmpname = NULL;
+	return (0);
+}
+
+/*
+ * Without syncfs() every queued file holds its descriptor until the
+ * batch is flushed; keep a batch within a quarter of the descriptor
+ * limit so that extraction does not run out of them.
+ */
+static int
+durable_clamp_files(int files)
+{
+#if !defined(HAVE_SYNCFS) && defined(HAVE_SYS_RESOURCE_H) && \
+    defined(RLIMIT_NOFILE)
+	struct rlimit rl;
+
+	if (files > 0 && getrlimit(RLIMIT_NOFILE, &rl) == 0 &&
+	    rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur / 4 < (rlim_t)files)
+		files = rl.rlim_cur >= 4 ? (int)(rl.rlim_cur / 4) : 1;
+#endif
+	return (files);
+}
+
+static int
+durable_pending(struct archive_write_disk *a, const char *name)
+{
+	int i;
+
+	for (i = 0; i < a->durable_count; i++)
+		if (strcmp(a->durable[i].name, name) == 0)
+			return (1);
+	return (0);
+}
+
+#ifndef HAVE_SYNCFS
+/* Sync the directory holding `name' so that its rename persists. */
+static int
+durable_sync_dir(const char *name, const char *prev)
+{
+	struct archive_string dir;
+	const char *p;
+	int fd, r = 0;
+
+	p = strrchr(name, '/');
+	/* Consecutive files usually share a directory. */
+	if (prev != NULL) {
+		const char *q = strrchr(prev, '/');
+		if ((p == NULL && q == NULL) || (p != NULL && q != NULL &&
+		    p - name == q - prev && memcmp(name, prev, p - name) == 0))
+			return (0);
+	}
+	archive_string_init(&dir);
+	if (p == NULL)
+		archive_strcpy(&dir, ".");
+	else if (p == name)
+		archive_strcpy(&dir, "/");
+	else
+		archive_strncpy(&dir, name, p - name);
+	fd = open(dir.s, O_RDONLY | O_BINARY | O_CLOEXEC);
+	if (fd >= 0) {
+		/* Some filesystems can't sync directories. */
+		if (fsync(fd) != 0 && errno != EINVAL)
+			r = -1;
+		close(fd);
+	} else
+		r = -1;
+	archive_string_free(&dir);
+	return (r);
+}
+#endif
+
+/*
+ * Make every queued file durable: sync the data, rename the files into
+ * place in the order they were extracted, then sync the renames.
+ */
+static int
+durable_flush(struct archive_write_disk *a)
+{
+	struct durable_file *df;
+	int i, ret = ARCHIVE_OK;
+
+	for (i = 0; i < a->durable_count; i++) {
+		df = &a->durable[i];
+		if (df->fd < 0)
+			continue;
+#ifdef HAVE_SYNCFS
+		if (syncfs(df->fd) != 0) {
+#else
+		if (fsync(df->fd) != 0) {
+#endif
+			archive_set_error(&a->archive, errno,
+			    "Failed to sync %s", df->name);
+			if (ARCHIVE_WARN < ret) ret = ARCHIVE_WARN;
+		}
+	}
+	for (i = 0; i < a->durable_count; i++) {
+		df = &a->durable[i];
+		if (rename(df->tmpname, df->name) == -1) {
+			/* The extracted data is lost with the temporary. */
+			archive_set_error(&a->archive, errno,
+			    "Failed to rename temporary file to %s; "
+			    "%s was not extracted", df->name, df->name);
+			unlink(df->tmpname);
+			ret = ARCHIVE_FAILED;
+		}
+	}
+	for (i = 0; i < a->durable_count; i++) {
+		df = &a->durable[i];
+#ifdef HAVE_SYNCFS
+		if (df->fd >= 0 && syncfs(df->fd) != 0) {
+#else
+		if (durable_sync_dir(df->name,
+		    i > 0 ? a->durable[i - 1].name : NULL) != 0) {
+#endif
+			archive_set_error(&a->archive, errno,
+			    "Failed to sync directory of %s", df->name);
+			if (ARCHIVE_WARN < ret) ret = ARCHIVE_WARN;
+		}
+	}
+	durable_release(a);
+	return (ret);
+}
+
+/* Forget the queue, closing any descriptors it still holds. */
+static void
+durable_release(struct archive_write_disk *a)
+{
+	int i;
+
+	for (i = 0; i < a->durable_count; i++) {
+		if (a->durable[i].fd >= 0)
+			close(a->durable[i].fd);
+		free(a->durable[i].tmpname);
+	}
+	a->durable_count = 0;
+	a->durable_bytes = 0;
+}
+
 static int
 la_opendirat(int fd, const char *path) {
 	const int flags = O_CLOEXEC
@@ -554,10 +771,25 @@ archive_write_disk_set_options(struct archive *_a, int flags)
 {
 	struct archive_write_disk *a = (struct archive_write_disk *)_a;
 
+	/* Durable extraction builds on the temporary file and rename. */
+	if (flags & ARCHIVE_EXTRACT_DURABLE)
+		flags |= ARCHIVE_EXTRACT_SAFE_WRITES;
 	a->flags = flags;
 	return (ARCHIVE_OK);
 }
 
+int
+archive_write_disk_set_durable_batch(struct archive *_a, int files,
+    la_int64_t bytes)
+{
+	struct archive_write_disk *a = (struct archive_write_disk *)_a;
+	archive_check_magic(&a->archive, ARCHIVE_WRITE_DISK_MAGIC,
+	    ARCHIVE_STATE_ANY, "archive_write_disk_set_durable_batch");
+	a->durable_max_files = durable_clamp_files(files);
+	a->durable_max_bytes = bytes;
+	return (ARCHIVE_OK);
+}
+
 
 /*
  * Extract this entry to disk.
@@ -576,7 +808,7 @@ _archive_write_disk_header(struct archive *_a, struct archive_entry *entry)
 	struct archive_write_disk *a = (struct archive_write_disk *)_a;
 	struct fixup_entry *fe;
 	const char *linkname;
-	int ret, r;
+	int ret, r, flush_ret;
 
 	archive_check_magic(&a->archive, ARCHIVE_WRITE_DISK_MAGIC,
 	    ARCHIVE_STATE_HEADER | ARCHIVE_STATE_DATA,
@@ -631,6 +863,20 @@ _archive_write_disk_header(struct archive *_a, struct archive_entry *entry)
 		return (ARCHIVE_WARN);
 	}
 
+	/*
+	 * Files waiting for a durable rename are not yet visible under
+	 * their names; put them in place before an entry that replaces
+	 * or hardlinks to one of them.  A failure here belongs to an
+	 * earlier entry, but it is still reported from this header.
+	 */
+	flush_ret = ARCHIVE_OK;
+	if (a->durable_count > 0 && (durable_pending(a, a->name) ||
+	    (linkname != NULL && durable_pending(a, linkname)))) {
+		flush_ret = durable_flush(a);
+		if (flush_ret == ARCHIVE_FATAL)
+			return (flush_ret);
+	}
+
 	/*
 	 * Query the umask so we get predictable mode settings.
 	 * This gets done on every call to _write_header in case the
@@ -932,6 +1178,12 @@ _archive_write_disk_header(struct archive *_a, struct archive_entry *entry)
 	/* We've created the object and are ready to pour data into it. */
 	if (ret >= ARCHIVE_WARN)
 		a->archive.state = ARCHIVE_STATE_DATA;
+	/*
+	 * An earlier file lost in the flush doesn't stop this one from
+	 * being written, so don't fail this header on its behalf.
+	 */
+	if (flush_ret < ret)
+		ret = flush_ret < ARCHIVE_WARN ? ARCHIVE_WARN : flush_ret;
 	/*
 	 * If it's not open, tell our client not to try writing.
 	 * In particular, dirs, links, etc, don't get written to.
@@ -1902,6 +2154,24 @@ _archive_write_disk_finish_entry(struct archive *_a)
 	}
 
 finish_metadata:
+	/*
+	 * A durable file is queued for the next batched sync and rename.
+	 * If it can't be queued, sync it on its own.
+	 */
+	if (a->fd >= 0 && a->tmpname != NULL &&
+	    (a->flags & ARCHIVE_EXTRACT_DURABLE)) {
+		if (durable_add(a) == 0) {
+			if (a->durable_count >= a->durable_max_files ||
+			    a->durable_bytes >= a->durable_max_bytes) {
+				int r2 = durable_flush(a);
+				if (r2 < ret) ret = r2;
+			}
+		} else if (fsync(a->fd) != 0) {
+			archive_set_error(&a->archive, errno,
+			    "Failed to sync %s", a->name);
+			if (ARCHIVE_WARN < ret) ret = ARCHIVE_WARN;
+		}
+	}
 	/* If there's an fd, we can close it now. */
 	if (a->fd >= 0) {
 		close(a->fd);
@@ -2009,6 +2279,8 @@ archive_write_disk_new(void)
 		return (NULL);
 	}
 	a->path_safe.s[0] = 0;
+	a->durable_max_files = durable_clamp_files(DURABLE_MAX_FILES);
+	a->durable_max_bytes = DURABLE_MAX_BYTES;
 
 #ifdef HAVE_ZLIB_H
 	a->decmpfs_compression_level = 5;
@@ -2417,6 +2689,14 @@ create_filesystem_object(struct archive_write_disk *a)
 		/* FALLTHROUGH */
 	case AE_IFREG:
 		a->tmpname = NULL;
+		if ((a->flags & ARCHIVE_EXTRACT_DURABLE) &&
+		    lstat(a->name, &st) != 0 && errno == ENOENT) {
+			/* Nothing to replace; still keep a partially
+			 * written file from showing up under its name. */
+			a->fd = la_mktemp(a);
+			r = (a->fd < 0);
+			break;
+		}
 		a->fd = open(a->name,
 		    O_WRONLY | O_CREAT | O_EXCL | O_BINARY | O_CLOEXEC, mode);
 		__archive_ensure_cloexec_flag(a->fd);
@@ -2516,6 +2796,11 @@ _archive_write_disk_close(struct archive *_a)
 	    ARCHIVE_STATE_HEADER | ARCHIVE_STATE_DATA,
 	    "archive_write_disk_close");
 	ret = _archive_write_disk_finish_entry(&a->archive);
+	if (a->durable_count > 0) {
+		int r = durable_flush(a);
+		if (r < ret)
+			ret = r;
+	}
 
 	/* Sort dir list so directories are fixed up in depth-first order. */
 	p = sort_dir_list(a->fixup_list);
@@ -2656,6 +2941,8 @@ _archive_write_disk_free(struct archive *_a)
 	archive_entry_free(a->entry);
 	archive_string_free(&a->_name_data);
 	archive_string_free(&a->_tmpname_data);
+	durable_release(a);
+	free(a->durable);
 	archive_string_free(&a->archive.error_string);
 	archive_string_free(&a->path_safe);
 	a->archive.magic = 0;
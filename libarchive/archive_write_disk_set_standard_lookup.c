@@ -45,78 +45,59 @@
 #endif
 
 #include "archive.h"
+#include "archive_name_cache_private.h"
 #include "archive_private.h"
 #include "archive_read_private.h"
 #include "archive_write_disk_private.h"
 
-struct bucket {
-	char	*name;
-	int	 hash;
-	id_t	 id;
-};
-
-static const size_t cache_size = 127;
-static unsigned int	hash(const char *);
 static int64_t	lookup_gid(void *, const char *uname, int64_t);
 static int64_t	lookup_uid(void *, const char *uname, int64_t);
-static void	cleanup(void *);
 
 /*
  * Installs functions that use getpwnam()/getgrnam()---along with
- * a simple cache to accelerate such lookups---into the archive_write_disk
+ * a cache to accelerate such lookups---into the archive_write_disk
  * object.  This is in a separate file because getpwnam()/getgrnam()
  * can pull in a LOT of library code (including NIS/LDAP functions, which
  * pull in DNS resolvers, etc).  This can easily top 500kB, which makes
  * it inappropriate for some space-constrained applications.
  *
+ * The cache itself is shared by every handle in the process; see
+ * archive_name_cache.c.
+ *
  * Applications that are size-sensitive may want to just use the
  * real default functions (defined in archive_write_disk.c) that just
  * use the uid/gid without the lookup.  Or define your own custom functions
  * if you prefer.
- *
- * TODO: Replace these hash tables with simpler move-to-front LRU
- * lists with a bounded size (128 items?).  The hash is a bit faster,
- * but has a bad pathology in which it thrashes a single bucket.  Even
- * walking a list of 128 items is a lot faster than calling
- * getpwnam()!
  */
 int
 archive_write_disk_set_standard_lookup(struct archive *a)
 {
-	struct bucket *ucache = calloc(cache_size, sizeof(struct bucket));
-	struct bucket *gcache = calloc(cache_size, sizeof(struct bucket));
-	if (ucache == NULL || gcache == NULL) {
-		free(ucache);
-		free(gcache);
-		return (ARCHIVE_FATAL);
-	}
-	archive_write_disk_set_group_lookup(a, gcache, lookup_gid, cleanup);
-	archive_write_disk_set_user_lookup(a, ucache, lookup_uid, cleanup);
+	archive_write_disk_set_group_lookup(a, NULL, lookup_gid, NULL);
+	archive_write_disk_set_user_lookup(a, NULL, lookup_uid, NULL);
 	return (ARCHIVE_OK);
 }
 
 static int64_t
 lookup_gid(void *private_data, const char *gname, int64_t gid)
 {
-	int h;
-	struct bucket *b;
-	struct bucket *gcache = (struct bucket *)private_data;
+	int64_t id;
+	int found = 0;
+
+	(void)private_data; /* UNUSED */
 
 	/* If no gname, just use the gid provided. */
 	if (gname == NULL || *gname == '\0')
 		return (gid);
 
 	/* Try to find gname in the cache. */
-	h = hash(gname);
-	b = &gcache[h % cache_size ];
-	if (b->name != NULL && b->hash == h && strcmp(gname, b->name) == 0)
-		return ((gid_t)b->id);
+	switch (__archive_name_cache_lookup_id(ARCHIVE_NAME_CACHE_GID,
+	    gname, &id)) {
+	case ARCHIVE_NAME_CACHE_HIT:
+		return (id);
+	case ARCHIVE_NAME_CACHE_NEGATIVE:
+		return (gid);
+	}
 
-	/* Free the cache slot for a new entry. */
-	free(b->name);
-	b->name = strdup(gname);
-	/* Note: If strdup fails, that's okay; we just won't cache. */
-	b->hash = h;
 #if HAVE_GRP_H
 #  if HAVE_GETGRNAM_R
 	{
@@ -141,8 +122,10 @@ lookup_gid(void *private_data, const char *gname, int64_t gid)
 				break;
 			buffer = allocated;
 		}
-		if (result != NULL)
+		if (result != NULL) {
 			gid = result->gr_gid;
+			found = 1;
+		}
 		free(allocated);
 	}
 #  else /* HAVE_GETGRNAM_R */
@@ -150,8 +133,10 @@ lookup_gid(void *private_data, const char *gname, int64_t gid)
 		struct group *result;
 
 		result = getgrnam(gname);
-		if (result != NULL)
+		if (result != NULL) {
 			gid = result->gr_gid;
+			found = 1;
+		}
 	}
 #  endif /* HAVE_GETGRNAM_R */
 #elif defined(_WIN32) && !defined(__CYGWIN__)
@@ -159,7 +144,8 @@ lookup_gid(void *private_data, const char *gname, int64_t gid)
 #else
 	#error No way to perform gid lookups on this platform
 #endif
-	b->id = (gid_t)gid;
+	__archive_name_cache_add(ARCHIVE_NAME_CACHE_GID, (gid_t)gid, gname,
+	    found);
 
 	return (gid);
 }
@@ -167,25 +153,24 @@ lookup_gid(void *private_data, const char *gname, int64_t gid)
 static int64_t
 lookup_uid(void *private_data, const char *uname, int64_t uid)
 {
-	int h;
-	struct bucket *b;
-	struct bucket *ucache = (struct bucket *)private_data;
+	int64_t id;
+	int found = 0;
+
+	(void)private_data; /* UNUSED */
 
 	/* If no uname, just use the uid provided. */
 	if (uname == NULL || *uname == '\0')
 		return (uid);
 
 	/* Try to find uname in the cache. */
-	h = hash(uname);
-	b = &ucache[h % cache_size ];
-	if (b->name != NULL && b->hash == h && strcmp(uname, b->name) == 0)
-		return ((uid_t)b->id);
+	switch (__archive_name_cache_lookup_id(ARCHIVE_NAME_CACHE_UID,
+	    uname, &id)) {
+	case ARCHIVE_NAME_CACHE_HIT:
+		return (id);
+	case ARCHIVE_NAME_CACHE_NEGATIVE:
+		return (uid);
+	}
 
-	/* Free the cache slot for a new entry. */
-	free(b->name);
-	b->name = strdup(uname);
-	/* Note: If strdup fails, that's okay; we just won't cache. */
-	b->hash = h;
 #if HAVE_PWD_H
 #  if HAVE_GETPWNAM_R
 	{
@@ -210,8 +195,10 @@ lookup_uid(void *private_data, const char *uname, int64_t uid)
 				break;
 			buffer = allocated;
 		}
-		if (result != NULL)
+		if (result != NULL) {
 			uid = result->pw_uid;
+			found = 1;
+		}
 		free(allocated);
 	}
 #  else /* HAVE_GETPWNAM_R */
@@ -219,8 +206,10 @@ lookup_uid(void *private_data, const char *uname, int64_t uid)
 		struct passwd *result;
 
 		result = getpwnam(uname);
-		if (result != NULL)
+		if (result != NULL) {
 			uid = result->pw_uid;
+			found = 1;
+		}
 	}
 #endif	/* HAVE_GETPWNAM_R */
 #elif defined(_WIN32) && !defined(__CYGWIN__)
@@ -228,35 +217,8 @@ lookup_uid(void *private_data, const char *uname, int64_t uid)
 #else
 	#error No way to look up uids on this platform
 #endif
-	b->id = (uid_t)uid;
+	__archive_name_cache_add(ARCHIVE_NAME_CACHE_UID, (uid_t)uid, uname,
+	    found);
 
 	return (uid);
 }
-
-static void
-cleanup(void *private)
-{
-	size_t i;
-	struct bucket *cache = (struct bucket *)private;
-
-	for (i = 0; i < cache_size; i++)
-		free(cache[i].name);
-	free(cache);
-}
-
-
-static unsigned int
-hash(const char *p)
-{
-	/* A 32-bit version of Peter Weinberger's (PJW) hash algorithm,
-	   as used by ELF for hashing function names. */
-	unsigned g, h = 0;
-	while (*p != '\0') {
-		h = (h << 4) + *p++;
-		if ((g = h & 0xF0000000) != 0) {
-			h ^= g >> 24;
-			h &= 0x0FFFFFFF;
-		}
-	}
-	return h;
-}
@@ -1073,6 +1073,22 @@ archive_write_disk_set_skip_file(struct archive *_a, la_int64_t d, la_int64_t i)
 	return (ARCHIVE_OK);
 }
 
+/*
+ * ARCHIVE_EXTRACT_DURABLE is not implemented here; accept the
+ * setting so that callers need not special-case this platform.
+ */
+int
+archive_write_disk_set_durable_batch(struct archive *_a, int files,
+    la_int64_t bytes)
+{
+	struct archive_write_disk *a = (struct archive_write_disk *)_a;
+	archive_check_magic(&a->archive, ARCHIVE_WRITE_DISK_MAGIC,
+	    ARCHIVE_STATE_ANY, "archive_write_disk_set_durable_batch");
+	(void)files; /* UNUSED */
+	(void)bytes; /* UNUSED */
+	return (ARCHIVE_OK);
+}
+
 static ssize_t
 write_data_block(struct archive_write_disk *a, const char *buff, size_t size)
 {
@@ -43,6 +43,7 @@
 #include "archive_entry.h"
 #include "archive_entry_locale.h"
 #include "archive_private.h"
+#include "archive_tar_index_private.h"
 #include "archive_write_private.h"
 #include "archive_write_set_format_private.h"
 
@@ -60,6 +61,7 @@ struct gnutar {
 	struct archive_string_conv *opt_sconv;
 	struct archive_string_conv *sconv_default;
 	int init_default_conversion;
+	struct archive_tar_index *index;
 };
 
 /*
@@ -214,6 +216,13 @@ archive_write_gnutar_options(struct archive_write *a, const char *key,
 				ret = ARCHIVE_FATAL;
 		}
 		return (ret);
+	} else if (strcmp(key, "index") == 0) {
+		__archive_tar_index_free(gnutar->index);
+		gnutar->index = NULL;
+		if (val == NULL || val[0] == 0)
+			return (ARCHIVE_OK);
+		return (__archive_tar_index_create(&a->archive,
+		    &gnutar->index, val));
 	}
 
 	/* Note: The "warn" return is just to inform the options
@@ -225,7 +234,13 @@ archive_write_gnutar_options(struct archive_write *a, const char *key,
 static int
 archive_write_gnutar_close(struct archive_write *a)
 {
-	return (__archive_write_nulls(a, 512*2));
+	struct gnutar *gnutar = (struct gnutar *)a->format_data;
+	int ret;
+
+	ret = __archive_write_nulls(a, 512*2);
+	if (ret == ARCHIVE_OK)
+		ret = __archive_tar_index_close(&a->archive, gnutar->index);
+	return (ret);
 }
 
 static int
@@ -234,6 +249,7 @@ archive_write_gnutar_free(struct archive_write *a)
 	struct gnutar *gnutar;
 
 	gnutar = (struct gnutar *)a->format_data;
+	__archive_tar_index_free(gnutar->index);
 	free(gnutar);
 	a->format_data = NULL;
 	return (ARCHIVE_OK);
@@ -278,8 +294,10 @@ archive_write_gnutar_header(struct archive_write *a,
 	struct gnutar *gnutar;
 	struct archive_string_conv *sconv;
 	struct archive_entry *entry_main;
+	int64_t header_offset;
 
 	gnutar = (struct gnutar *)a->format_data;
+	header_offset = a->filter_first->bytes_written;
 
 	/* Setup default string conversion. */
 	if (gnutar->opt_sconv == NULL) {
@@ -552,6 +570,15 @@ archive_write_gnutar_header(struct archive_write *a,
 	}
 	if (ret2 < ret)
 		ret = ret2;
+	if (gnutar->index != NULL) {
+		ret2 = __archive_tar_index_add(&a->archive, gnutar->index,
+		    archive_entry_pathname(entry), header_offset,
+		    a->filter_first->bytes_written, archive_entry_size(entry));
+		if (ret2 < ARCHIVE_WARN) {
+			ret = ret2;
+			goto exit_write_header;
+		}
+	}
 
 	gnutar->entry_bytes_remaining = archive_entry_size(entry);
 	gnutar->entry_padding = 0x1ff & (-(int64_t)gnutar->entry_bytes_remaining);
@@ -28,12 +28,18 @@
 #ifdef HAVE_SYS_TYPES_H
 #include <sys/types.h>
 #endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
 #ifdef HAVE_SYS_UTSNAME_H
 #include <sys/utsname.h>
 #endif
 #ifdef HAVE_ERRNO_H
 #include <errno.h>
 #endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
 #ifdef HAVE_LIMITS_H
 #include <limits.h>
 #endif
@@ -62,6 +68,12 @@
 #define getuid()			0
 #define getgid()			0
 #endif
+#ifndef O_BINARY
+#define O_BINARY	0
+#endif
+#ifndef O_CLOEXEC
+#define O_CLOEXEC	0
+#endif
 
 /*#define DEBUG 1*/
 #ifdef DEBUG
@@ -193,6 +205,12 @@ struct isofile {
 		struct content	*next;		/* next content	*/
 	} content, *cur_content;
 	int			 write_content;
+	/* The contents are read from the source file, not from the
+	 * temporary file, when the image is written. */
+	int			 from_source;
+	struct archive_string	 source_path;	/* Absolute path */
+	dev_t			 source_dev;
+	ino_t			 source_ino;
 
 	enum {
 		NO = 0,
@@ -639,6 +657,21 @@ struct iso_option {
 #define OPT_RR_USEFUL			2
 #define OPT_RR_DEFAULT			OPT_RR_USEFUL
 
+	/*
+	 * Usage  : source-files
+	 * Type   : boolean
+	 * Default: Disabled
+	 *
+	 * Reads the contents of a regular file from its source path
+	 * (archive_entry_sourcepath()) when the ISO image is written
+	 * instead of saving them to the temporary file, so the data
+	 * is not copied twice.  Files whose source path is unset or
+	 * does not match the entry, and files which may be zisofs'ed,
+	 * still go through the temporary file.
+	 */
+	unsigned int	 source_files:1;
+#define OPT_SOURCE_FILES_DEFAULT	0	/* Disabled */
+
 	/*
 	 * Usage  : volume-id=<value>
 	 * Type   : string, max 32 bytes
@@ -945,6 +978,7 @@ static int	wb_consume(struct archive_write *, size_t);
 static int	wb_set_offset(struct archive_write *, int64_t);
 #endif
 static int	write_null(struct archive_write *, size_t);
+static int	open_temp(struct archive_write *);
 static int	write_VD_terminator(struct archive_write *);
 static int	set_file_identifier(unsigned char *, int, int, enum vdc,
 		    struct archive_write *, struct vdd *,
@@ -958,6 +992,8 @@ static int	write_path_table(struct archive_write *, int,
 static int	write_directory_descriptors(struct archive_write *,
 		    struct vdd *);
 static int	write_file_descriptors(struct archive_write *);
+static int	write_source_contents(struct archive_write *,
+		    struct isofile *);
 static int	write_rr_ER(struct archive_write *);
 static void	calculate_path_table_size(struct vdd *);
 
@@ -974,6 +1010,9 @@ static int	isofile_gen_utility_names(struct archive_write *,
 static int	isofile_register_hardlink(struct archive_write *,
 		    struct isofile *);
 static void	isofile_connect_hardlink_files(struct iso9660 *);
+static int	isofile_use_source(struct archive_write *, struct isofile *);
+static int	isofile_setup_source_extents(struct archive_write *,
+		    struct isofile *);
 static void	isofile_init_hardlinks(struct iso9660 *);
 static void	isofile_free_hardlinks(struct iso9660 *);
 
@@ -1036,6 +1075,7 @@ static int	isoent_create_boot_catalog(struct archive_write *,
 		    struct isoent *);
 static size_t	fd_boot_image_size(int);
 static int	make_boot_catalog(struct archive_write *);
+static int	load_source_boot_file(struct archive_write *);
 static int	setup_boot_information(struct archive_write *);
 
 static int	zisofs_init(struct archive_write *, struct isofile *);
@@ -1152,6 +1192,7 @@ archive_write_set_format_iso9660(struct archive *_a)
 	iso9660->opt.pad = OPT_PAD_DEFAULT;
 	iso9660->opt.publisher = OPT_PUBLISHER_DEFAULT;
 	iso9660->opt.rr = OPT_RR_DEFAULT;
+	iso9660->opt.source_files = OPT_SOURCE_FILES_DEFAULT;
 	iso9660->opt.volume_id = OPT_VOLUME_ID_DEFAULT;
 	iso9660->opt.zisofs = OPT_ZISOFS_DEFAULT;
 
@@ -1479,6 +1520,12 @@ iso9660_options(struct archive_write *a, const char *key, const char *value)
 			return (ARCHIVE_OK);
 		}
 		break;
+	case 's':
+		if (strcmp(key, "source-files") == 0) {
+			iso9660->opt.source_files = value != NULL;
+			return (ARCHIVE_OK);
+		}
+		break;
 	case 'v':
 		if (strcmp(key, "volume-id") == 0) {
 			r = get_str_opt(a, &(iso9660->volume_identifier),
@@ -1613,9 +1660,34 @@ iso9660_write_header(struct archive_write *a, struct archive_entry *entry)
 			return (ARCHIVE_FATAL);
 	}
 
+	file->cur_content = &(file->content);
+	iso9660->bytes_remaining =  archive_entry_size(file->entry);
+	if (isofile_use_source(a, file)) {
+		/* The contents will be read at close time. */
+		file->from_source = 1;
+		return (ret);
+	}
+
 	/*
 	 * Prepare to save the contents of the file.
 	 */
+	if (open_temp(a) != ARCHIVE_OK)
+		return (ARCHIVE_FATAL);
+
+	/* Save an offset of current file in temporary file. */
+	file->content.offset_of_temp = wb_offset(a);
+	r = zisofs_init(a, file);
+	if (r < ret)
+		ret = r;
+
+	return (ret);
+}
+
+static int
+open_temp(struct archive_write *a)
+{
+	struct iso9660 *iso9660 = a->format_data;
+
 	if (iso9660->temp_fd < 0) {
 		iso9660->temp_fd = __archive_mktemp(NULL);
 		if (iso9660->temp_fd < 0) {
@@ -1624,16 +1696,174 @@ iso9660_write_header(struct archive_write *a, struct archive_entry *entry)
 			return (ARCHIVE_FATAL);
 		}
 	}
+	return (ARCHIVE_OK);
+}
 
-	/* Save an offset of current file in temporary file. */
-	file->content.offset_of_temp = wb_offset(a);
-	file->cur_content = &(file->content);
-	r = zisofs_init(a, file);
-	if (r < ret)
-		ret = r;
-	iso9660->bytes_remaining =  archive_entry_size(file->entry);
+/*
+ * Make an absolute path of a source path so that the file can still
+ * be found at close time if the current directory has been changed.
+ */
+static int
+source_abspath(struct archive_string *as, const char *path)
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+	char *p;
 
-	return (ret);
+	p = _fullpath(NULL, path, 0);
+	if (p == NULL)
+		return (-1);
+	archive_strcpy(as, p);
+	free(p);
+#else
+	size_t size;
+
+	archive_string_empty(as);
+	if (path[0] != '/') {
+		for (size = 256;; size *= 2) {
+			if (archive_string_ensure(as, size) == NULL)
+				return (-1);
+			if (getcwd(as->s, size) != NULL)
+				break;
+			if (errno != ERANGE)
+				return (-1);
+		}
+		as->length = strlen(as->s);
+		if (as->length == 0 || as->s[as->length -1] != '/')
+			archive_strappend_char(as, '/');
+	}
+	archive_strcat(as, path);
+#endif
+	return (0);
+}
+
+/*
+ * Check if the contents of a regular file can be read from its source
+ * file at close time.  The source has to be a regular file of the same
+ * size, and zisofs must not be in use since the compressed size has to
+ * be known before the directory records are built.
+ */
+static int
+isofile_use_source(struct archive_write *a, struct isofile *file)
+{
+	struct iso9660 *iso9660 = a->format_data;
+	const char *path;
+	struct stat st;
+
+	if (!iso9660->opt.source_files ||
+	    (iso9660->opt.rr && iso9660->opt.zisofs))
+		return (0);
+	path = archive_entry_sourcepath(file->entry);
+	if (path == NULL || source_abspath(&(file->source_path), path) != 0)
+		return (0);
+	if (stat(file->source_path.s, &st) != 0 || !S_ISREG(st.st_mode) ||
+	    st.st_size != archive_entry_size(file->entry))
+		return (0);
+	file->source_dev = st.st_dev;
+	file->source_ino = st.st_ino;
+	return (1);
+}
+
+/*
+ * Split the contents of a file read from its source into extents
+ * the same way write_iso9660_data() does for data it saves.
+ */
+static int
+isofile_setup_source_extents(struct archive_write *a, struct isofile *file)
+{
+	struct iso9660 *iso9660 = a->format_data;
+	struct content *con;
+	int64_t remaining, max;
+
+	max = MULTI_EXTENT_SIZE - LOGICAL_BLOCK_SIZE;
+	remaining = archive_entry_size(file->entry);
+	con = &(file->content);
+	for (;;) {
+		if (iso9660->need_multi_extent && remaining >= max)
+			con->size = max;
+		else
+			con->size = remaining;
+		con->blocks = (int)((con->size + LOGICAL_BLOCK_SIZE -1)
+		    >> LOGICAL_BLOCK_BITS);
+		remaining -= con->size;
+		if (con->size < max)
+			break;
+		con->next = calloc(1, sizeof(*con));
+		if (con->next == NULL) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "Can't allocate content data");
+			return (ARCHIVE_FATAL);
+		}
+		con = con->next;
+	}
+	file->cur_content = con;
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Read file contents from its source file, and write it with padding
+ * for each extent.
+ */
+static int
+write_source_contents(struct archive_write *a, struct isofile *file)
+{
+	const char *path;
+	struct content *con;
+	struct stat st;
+	int fd, r;
+
+	path = file->source_path.s;
+	fd = open(path, O_RDONLY | O_BINARY | O_CLOEXEC);
+	if (fd < 0) {
+		archive_set_error(&a->archive, errno,
+		    "Can't open ``%s''", path);
+		return (ARCHIVE_FATAL);
+	}
+	__archive_ensure_cloexec_flag(fd);
+	/* The directory records already hold the size found at
+	 * header time; make sure the same file is still there. */
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+	    st.st_size != archive_entry_size(file->entry) ||
+	    st.st_dev != file->source_dev || st.st_ino != file->source_ino) {
+		archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+		    "``%s'' has changed since its header was written", path);
+		close(fd);
+		return (ARCHIVE_FATAL);
+	}
+	r = ARCHIVE_OK;
+	for (con = &(file->content); con != NULL && r == ARCHIVE_OK;
+	    con = con->next) {
+		int64_t size = con->size;
+
+		while (size) {
+			size_t rsize;
+			ssize_t rs;
+
+			rsize = wb_remaining(a);
+			if (rsize > (size_t)size)
+				rsize = (size_t)size;
+			rs = read(fd, wb_buffptr(a), rsize);
+			if (rs <= 0) {
+				if (rs == 0)
+					archive_set_error(&a->archive,
+					    ARCHIVE_ERRNO_MISC,
+					    "``%s'' got smaller", path);
+				else
+					archive_set_error(&a->archive, errno,
+					    "Can't read ``%s''", path);
+				r = ARCHIVE_FATAL;
+				break;
+			}
+			size -= rs;
+			r = wb_consume(a, rs);
+			if (r < 0)
+				break;
+		}
+		if (r == ARCHIVE_OK)
+			r = write_null(a, (size_t)(((int64_t)con->blocks
+			    << LOGICAL_BLOCK_BITS) - con->size));
+	}
+	close(fd);
+	return (r);
 }
 
 static int
@@ -1799,6 +2029,11 @@ iso9660_write_data(struct archive_write *a, const void *buff, size_t s)
 		s = (size_t)iso9660->bytes_remaining;
 	if (s == 0)
 		return (0);
+	if (iso9660->cur_file->from_source) {
+		/* The contents are read from the source file later. */
+		iso9660->bytes_remaining -= s;
+		return (s);
+	}
 
 	r = write_iso9660_data(a, buff, s);
 	if (r > 0)
@@ -1815,6 +2050,14 @@ iso9660_finish_entry(struct archive_write *a)
 		return (ARCHIVE_OK);
 	if (archive_entry_filetype(iso9660->cur_file->entry) != AE_IFREG)
 		return (ARCHIVE_OK);
+	if (iso9660->cur_file->from_source) {
+		if (isofile_setup_source_extents(a, iso9660->cur_file)
+		    != ARCHIVE_OK)
+			return (ARCHIVE_FATAL);
+		if (iso9660->cur_file->content.size != 0)
+			isofile_add_data_file(iso9660, iso9660->cur_file);
+		return (ARCHIVE_OK);
+	}
 	if (iso9660->cur_file->content.size == 0)
 		return (ARCHIVE_OK);
 
@@ -1879,6 +2122,11 @@ iso9660_close(struct archive_write *a)
 	if (iso9660->opt.boot) {
 		/* Find out the boot file entry. */
 		ret = isoent_find_out_boot_file(a, iso9660->primary.rootent);
+		if (ret < 0)
+			return (ret);
+		/* The boot file may be modified by boot-info-table, so
+		 * its contents have to be in the temporary file. */
+		ret = load_source_boot_file(a);
 		if (ret < 0)
 			return (ret);
 		/* Reconvert the boot file from zisofs'ed form to
@@ -4544,6 +4792,22 @@ write_file_descriptors(struct archive_write *a)
 		if (!file->write_content)
 			continue;
 
+		if (file->from_source) {
+			/* Flush out blocks from the temporary file first. */
+			if (blocks > 0) {
+				r = write_file_contents(a, offset,
+				    blocks << LOGICAL_BLOCK_BITS);
+				if (r < 0)
+					return (r);
+			}
+			blocks = 0;
+			offset = 0;
+			r = write_source_contents(a, file);
+			if (r < 0)
+				return (r);
+			continue;
+		}
+
 		if ((offset + (blocks << LOGICAL_BLOCK_BITS)) <
 		     file->content.offset_of_temp) {
 			if (blocks > 0) {
@@ -4640,6 +4904,7 @@ isofile_new(struct archive_write *a, struct archive_entry *entry)
 	archive_string_init(&(file->basename));
 	archive_string_init(&(file->basename_utf16));
 	archive_string_init(&(file->symlink));
+	archive_string_init(&(file->source_path));
 	file->cur_content = &(file->content);
 
 	return (file);
@@ -4661,6 +4926,7 @@ isofile_free(struct isofile *file)
 	archive_string_free(&(file->basename));
 	archive_string_free(&(file->basename_utf16));
 	archive_string_free(&(file->symlink));
+	archive_string_free(&(file->source_path));
 	free(file);
 }
 
@@ -7306,6 +7572,26 @@ make_boot_catalog(struct archive_write *a)
 	return (wb_consume(a, LOGICAL_BLOCK_SIZE));
 }
 
+static int
+load_source_boot_file(struct archive_write *a)
+{
+	struct iso9660 *iso9660 = a->format_data;
+	struct isofile *file;
+	int r;
+
+	file = iso9660->el_torito.boot->file;
+	if (!file->from_source)
+		return (ARCHIVE_OK);
+	if (open_temp(a) != ARCHIVE_OK)
+		return (ARCHIVE_FATAL);
+	file->content.offset_of_temp = wb_offset(a);
+	r = write_source_contents(a, file);
+	if (r < 0)
+		return (r);
+	file->from_source = 0;
+	return (ARCHIVE_OK);
+}
+
 static int
 setup_boot_information(struct archive_write *a)
 {
@@ -36,14 +36,25 @@
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #include "archive.h"
 #include "archive_entry.h"
 #include "archive_entry_locale.h"
 #include "archive_private.h"
+#include "archive_tar_index_private.h"
 #include "archive_write_private.h"
 #include "archive_write_set_format_private.h"
 
+/* Granularity of the zero-block scan done by "detect-sparse". */
+#define PAX_SPARSE_BLOCK	4096
+#define PAX_SPOOL_SIZE		(64 * 1024)
+
 struct sparse_block {
 	struct sparse_block	*next;
 	int		is_hole;
@@ -62,6 +73,25 @@ struct pax {
 	struct sparse_block	*sparse_tail;
 	struct archive_string_conv *sconv_utf8;
 	int			 opt_binary;
+	struct archive_tar_index *index;
+
+	/*
+	 * "detect-sparse" state.  The header of a regular file is held
+	 * back in `deferred' while its body is scanned for runs of zero
+	 * blocks; non-zero blocks are spooled to a temporary file and
+	 * replayed once the sparse map is known.  `header_check' is set
+	 * while the header is built, but not written, to report its
+	 * problems before it is deferred.
+	 */
+	int			 opt_detect_sparse;
+	int			 header_check;
+	struct archive_entry	*deferred;
+	int64_t			 deferred_offset;
+	int			 deferred_holes;
+	int			 spool_fd;
+	unsigned char		*spool_buff;
+	size_t			 spool_pending;
+	size_t			 spool_block;
 
 	unsigned flags;
 #define WRITE_SCHILY_XATTR       (1 << 0)
@@ -89,6 +119,15 @@ static int		 archive_write_pax_header(struct archive_write *,
 			     struct archive_entry *);
 static int		 archive_write_pax_options(struct archive_write *,
 			     const char *, const char *);
+static int		 write_sparse_map(struct archive_write *,
+			     struct pax *);
+static int		 detect_sparse_possible(struct archive_entry *);
+static int		 detect_sparse_begin(struct pax *,
+			     struct archive_entry *);
+static ssize_t		 detect_sparse_data(struct archive_write *,
+			     struct pax *, const void *, size_t);
+static int		 detect_sparse_end(struct archive_write *,
+			     struct pax *);
 static char		*base64_encode(const char *src, size_t len);
 static char		*build_gnu_sparse_name(char *dest, const char *src);
 static char		*build_pax_attribute_name(char *dest, const char *src);
@@ -145,6 +184,7 @@ archive_write_set_format_pax(struct archive *_a)
 		return (ARCHIVE_FATAL);
 	}
 	pax->flags = WRITE_LIBARCHIVE_XATTR | WRITE_SCHILY_XATTR;
+	pax->spool_fd = -1;
 
 	a->format_data = pax;
 	a->format_name = "pax";
@@ -222,6 +262,16 @@ archive_write_pax_options(struct archive_write *a, const char *key,
 			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
 			    "pax: invalid xattr header name");
 		return (ret);
+	} else if (strcmp(key, "index") == 0) {
+		__archive_tar_index_free(pax->index);
+		pax->index = NULL;
+		if (val == NULL || val[0] == 0)
+			return (ARCHIVE_OK);
+		return (__archive_tar_index_create(&a->archive,
+		    &pax->index, val));
+	} else if (strcmp(key, "detect-sparse") == 0) {
+		pax->opt_detect_sparse = (val != NULL && val[0] != 0);
+		return (ARCHIVE_OK);
 	}
 
 	/* Note: The "warn" return is just to inform the options
@@ -600,6 +650,7 @@ archive_write_pax_header(struct archive_write *a,
 	char pax_entry_name[256];
 	char gnu_sparse_name[256];
 	struct archive_string entry_name;
+	int64_t header_offset;
 
 	ret = ARCHIVE_OK;
 	need_extension = 0;
@@ -614,6 +665,30 @@ archive_write_pax_header(struct archive_write *a,
 		return (ARCHIVE_FAILED);
 	}
 
+	/*
+	 * With "detect-sparse", hold back the header of a dense regular
+	 * file that may have holes until its body has been scanned; it is
+	 * written by archive_write_pax_finish_entry().  The header is
+	 * built once now so that a warning or failure is reported for
+	 * this entry rather than for the next one.
+	 */
+	if (pax->opt_detect_sparse && pax->deferred == NULL &&
+	    !pax->header_check &&
+	    archive_entry_filetype(entry_original) == AE_IFREG &&
+	    archive_entry_hardlink(entry_original) == NULL &&
+	    archive_entry_size(entry_original) > PAX_SPARSE_BLOCK &&
+	    archive_entry_sparse_count(entry_original) == 0 &&
+	    detect_sparse_possible(entry_original)) {
+		pax->header_check = 1;
+		ret = archive_write_pax_header(a, entry_original);
+		pax->header_check = 0;
+		if (ret < ARCHIVE_WARN)
+			return (ret);
+		if (detect_sparse_begin(pax, entry_original) == ARCHIVE_OK)
+			return (ret);
+		ret = ARCHIVE_OK;
+	}
+
 	/*
 	 * Choose a header encoding.
 	 */
@@ -748,7 +823,7 @@ archive_write_pax_header(struct archive_write *a,
 	 */
 	mac_metadata =
 	    archive_entry_mac_metadata(entry_original, &mac_metadata_size);
-	if (mac_metadata != NULL) {
+	if (mac_metadata != NULL && !pax->header_check) {
 		const char *oname;
 		char *name, *bname;
 		size_t name_length;
@@ -817,6 +892,9 @@ archive_write_pax_header(struct archive_write *a,
 			ret = r;
 	}
 
+	/* The index points past the copyfile entry written above. */
+	header_offset = a->filter_first->bytes_written;
+
 	/* Copy entry so we can modify it as needed. */
 #if defined(_WIN32) && !defined(__CYGWIN__)
 	/* Make sure the path separators in pathname, hardlink and symlink
@@ -1393,6 +1471,13 @@ archive_write_pax_header(struct archive_write *a,
 		return (ARCHIVE_FATAL);
 	}
 
+	/* The header is only being checked before it is deferred. */
+	if (pax->header_check) {
+		archive_entry_free(entry_main);
+		archive_string_free(&entry_name);
+		return (ret);
+	}
+
 	/* If we built any extended attributes, write that entry first. */
 	if (archive_strlen(&(pax->pax_header)) > 0) {
 		struct archive_entry *pax_attr_entry;
@@ -1501,6 +1586,16 @@ archive_write_pax_header(struct archive_write *a,
 		archive_string_free(&entry_name);
 		return (r);
 	}
+	if (pax->index != NULL) {
+		r = __archive_tar_index_add(&a->archive, pax->index,
+		    archive_entry_pathname(entry_original), header_offset,
+		    a->filter_first->bytes_written, real_size);
+		if (r != ARCHIVE_OK) {
+			archive_entry_free(entry_main);
+			archive_string_free(&entry_name);
+			return (r);
+		}
+	}
 
 	/*
 	 * Inform the client of the on-disk size we're using, so
@@ -1786,7 +1881,13 @@ build_gnu_sparse_name(char *dest, const char *src)
 static int
 archive_write_pax_close(struct archive_write *a)
 {
-	return (__archive_write_nulls(a, 512 * 2));
+	struct pax *pax = (struct pax *)a->format_data;
+	int ret;
+
+	ret = __archive_write_nulls(a, 512 * 2);
+	if (ret == ARCHIVE_OK)
+		ret = __archive_tar_index_close(&a->archive, pax->index);
+	return (ret);
 }
 
 static int
@@ -1802,6 +1903,11 @@ archive_write_pax_free(struct archive_write *a)
 	archive_string_free(&pax->sparse_map);
 	archive_string_free(&pax->l_url_encoded_name);
 	sparse_list_clear(pax);
+	__archive_tar_index_free(pax->index);
+	archive_entry_free(pax->deferred);
+	if (pax->spool_fd >= 0)
+		close(pax->spool_fd);
+	free(pax->spool_buff);
 	free(pax);
 	a->format_data = NULL;
 	return (ARCHIVE_OK);
@@ -1812,9 +1918,15 @@ archive_write_pax_finish_entry(struct archive_write *a)
 {
 	struct pax *pax;
 	uint64_t remaining;
-	int ret;
+	int r, ret;
 
 	pax = (struct pax *)a->format_data;
+	ret = ARCHIVE_OK;
+	if (pax->deferred != NULL) {
+		ret = detect_sparse_end(a, pax);
+		if (ret < ARCHIVE_WARN)
+			return (ret);
+	}
 	remaining = pax->entry_bytes_remaining;
 	if (remaining == 0) {
 		while (pax->sparse_list) {
@@ -1826,8 +1938,10 @@ archive_write_pax_finish_entry(struct archive_write *a)
 			pax->sparse_list = sb;
 		}
 	}
-	ret = __archive_write_nulls(a, (size_t)(remaining + pax->entry_padding));
+	r = __archive_write_nulls(a, (size_t)(remaining + pax->entry_padding));
 	pax->entry_bytes_remaining = pax->entry_padding = 0;
+	if (r != ARCHIVE_OK)
+		ret = r;
 	return (ret);
 }
 
@@ -1840,21 +1954,16 @@ archive_write_pax_data(struct archive_write *a, const void *buff, size_t s)
 	int ret;
 
 	pax = (struct pax *)a->format_data;
+	if (pax->deferred != NULL)
+		return (detect_sparse_data(a, pax, buff, s));
 
 	/*
 	 * According to GNU PAX format 1.0, write a sparse map
 	 * before the body.
 	 */
-	if (archive_strlen(&(pax->sparse_map))) {
-		ret = __archive_write_output(a, pax->sparse_map.s,
-		    archive_strlen(&(pax->sparse_map)));
-		if (ret != ARCHIVE_OK)
-			return (ret);
-		ret = __archive_write_nulls(a, pax->sparse_map_padding);
-		if (ret != ARCHIVE_OK)
-			return (ret);
-		archive_string_empty(&(pax->sparse_map));
-	}
+	ret = write_sparse_map(a, pax);
+	if (ret != ARCHIVE_OK)
+		return (ret);
 
 	total = 0;
 	while (total < s) {
@@ -1892,6 +2001,300 @@ archive_write_pax_data(struct archive_write *a, const void *buff, size_t s)
 	return (total);
 }
 
+static int
+write_sparse_map(struct archive_write *a, struct pax *pax)
+{
+	int ret;
+
+	if (archive_strlen(&(pax->sparse_map)) == 0)
+		return (ARCHIVE_OK);
+	ret = __archive_write_output(a, pax->sparse_map.s,
+	    archive_strlen(&(pax->sparse_map)));
+	if (ret != ARCHIVE_OK)
+		return (ret);
+	ret = __archive_write_nulls(a, pax->sparse_map_padding);
+	if (ret != ARCHIVE_OK)
+		return (ret);
+	archive_string_empty(&(pax->sparse_map));
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Return nonzero if the block holds nothing but zero bytes.  Several
+ * words are folded together per step, which keeps the loop short and
+ * lets the compiler use its widest registers for it.
+ */
+static int
+is_zero_block(const unsigned char *p, size_t n)
+{
+	uint64_t w[4];
+
+	for (; n >= sizeof(w); p += sizeof(w), n -= sizeof(w)) {
+		memcpy(w, p, sizeof(w));
+		if ((w[0] | w[1] | w[2] | w[3]) != 0)
+			return (0);
+	}
+	while (n > 0) {
+		if (p[--n] != 0)
+			return (0);
+	}
+	return (1);
+}
+
+/*
+ * Return zero if the entry is known to have no holes: a file on disk
+ * with a block allocated for every byte has none, and copying it
+ * through the spool would only cost time.
+ */
+static int
+detect_sparse_possible(struct archive_entry *entry)
+{
+#ifdef HAVE_STRUCT_STAT_ST_BLOCKS
+	const char *path = archive_entry_sourcepath(entry);
+	struct stat st;
+
+	if (path != NULL && la_stat(path, &st) == 0 &&
+	    S_ISREG(st.st_mode) && st.st_size == archive_entry_size(entry) &&
+	    st.st_blocks >= (st.st_size + 511) / 512)
+		return (0);
+#else
+	(void)entry; /* UNUSED */
+#endif
+	return (1);
+}
+
+/*
+ * Start scanning a regular file for holes.  Returns ARCHIVE_FAILED,
+ * without setting an error, if the spool cannot be set up; the entry
+ * is then written as usual.
+ */
+static int
+detect_sparse_begin(struct pax *pax, struct archive_entry *entry)
+{
+	if (pax->spool_buff == NULL) {
+		pax->spool_buff = malloc(PAX_SPOOL_SIZE);
+		if (pax->spool_buff == NULL)
+			return (ARCHIVE_FAILED);
+	}
+	if (pax->spool_fd < 0) {
+		pax->spool_fd = __archive_mktemp(NULL);
+		if (pax->spool_fd < 0)
+			return (ARCHIVE_FAILED);
+	} else if (lseek(pax->spool_fd, 0, SEEK_SET) < 0)
+		return (ARCHIVE_FAILED);
+	pax->deferred = archive_entry_clone(entry);
+	if (pax->deferred == NULL)
+		return (ARCHIVE_FAILED);
+	archive_entry_sparse_clear(pax->deferred);
+	pax->deferred_offset = 0;
+	pax->deferred_holes = 0;
+	pax->spool_pending = 0;
+	pax->spool_block = 0;
+	return (ARCHIVE_OK);
+}
+
+static int
+spool_flush(struct archive_write *a, struct pax *pax)
+{
+	const unsigned char *p = pax->spool_buff;
+	size_t s = pax->spool_pending;
+	ssize_t bytes;
+
+	while (s > 0) {
+		bytes = write(pax->spool_fd, p, s);
+		if (bytes < 0) {
+			if (errno == EINTR)
+				continue;
+			archive_set_error(&a->archive, errno,
+			    "Can't write to the sparse spool file");
+			return (ARCHIVE_FATAL);
+		}
+		p += bytes;
+		s -= bytes;
+	}
+	pax->spool_pending = 0;
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Keep the `len' bytes just scanned, which sit at the end of the
+ * spool buffer, as file data ending at the current offset.
+ */
+static int
+spool_keep(struct archive_write *a, struct pax *pax, size_t len)
+{
+	archive_entry_sparse_add_entry(pax->deferred,
+	    pax->deferred_offset - len, len);
+	pax->spool_pending += len;
+	if (pax->spool_pending + PAX_SPARSE_BLOCK > PAX_SPOOL_SIZE)
+		return (spool_flush(a, pax));
+	return (ARCHIVE_OK);
+}
+
+static ssize_t
+detect_sparse_data(struct archive_write *a, struct pax *pax,
+    const void *buff, size_t s)
+{
+	const unsigned char *p = (const unsigned char *)buff;
+	size_t total, n;
+	int64_t avail;
+	int ret;
+
+	avail = archive_entry_size(pax->deferred) - pax->deferred_offset;
+	if ((int64_t)s > avail)
+		s = (size_t)avail;
+
+	total = 0;
+	while (total < s) {
+		unsigned char *b = pax->spool_buff + pax->spool_pending;
+		const unsigned char *blk;
+
+		n = PAX_SPARSE_BLOCK - pax->spool_block;
+		if (n > s - total)
+			n = s - total;
+		if (pax->spool_block == 0 && n == PAX_SPARSE_BLOCK)
+			/* Scan whole blocks in place. */
+			blk = p + total;
+		else {
+			memcpy(b + pax->spool_block, p + total, n);
+			blk = b;
+		}
+		pax->spool_block += n;
+		pax->deferred_offset += n;
+		total += n;
+		if (pax->spool_block < PAX_SPARSE_BLOCK)
+			break;
+		pax->spool_block = 0;
+		if (is_zero_block(blk, PAX_SPARSE_BLOCK)) {
+			pax->deferred_holes = 1;
+			continue;
+		}
+		if (blk != b)
+			memcpy(b, blk, PAX_SPARSE_BLOCK);
+		ret = spool_keep(a, pax, PAX_SPARSE_BLOCK);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+	}
+	return (total);
+}
+
+/*
+ * Write spooled file data.  Holes in the sparse list have no bytes in
+ * the spool, so they are dropped rather than consuming input.
+ */
+static int
+detect_sparse_replay(struct archive_write *a, struct pax *pax,
+    const unsigned char *p, size_t s)
+{
+	struct sparse_block *sb;
+	size_t ws;
+	int ret;
+
+	while (s > 0 && (sb = pax->sparse_list) != NULL) {
+		if (sb->is_hole || sb->remaining == 0) {
+			pax->sparse_list = sb->next;
+			free(sb);
+			continue;
+		}
+		ws = s;
+		if (ws > sb->remaining)
+			ws = (size_t)sb->remaining;
+		ret = __archive_write_output(a, p, ws);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+		sb->remaining -= ws;
+		p += ws;
+		s -= ws;
+	}
+	return (ARCHIVE_OK);
+}
+
+/*
+ * The body of a deferred entry is complete: record the holes that
+ * were found, write the header and replay the spooled data.  A short
+ * body is padded out with zeros, which become a trailing hole.
+ */
+static int
+detect_sparse_end(struct archive_write *a, struct pax *pax)
+{
+	struct archive_entry *entry = pax->deferred;
+	int64_t remaining;
+	ssize_t bytes;
+	size_t n;
+	int ret, r;
+
+	/* A trailing partial block is always stored. */
+	if (pax->spool_block > 0) {
+		n = pax->spool_block;
+		pax->spool_block = 0;
+		ret = spool_keep(a, pax, n);
+		if (ret != ARCHIVE_OK)
+			goto fail;
+	}
+	ret = spool_flush(a, pax);
+	if (ret != ARCHIVE_OK)
+		goto fail;
+	if (archive_entry_size(entry) - pax->deferred_offset >=
+	    PAX_SPARSE_BLOCK)
+		pax->deferred_holes = 1;
+	if (!pax->deferred_holes)
+		archive_entry_sparse_clear(entry);
+	else if (archive_entry_sparse_count(entry) == 0)
+		/* Nothing but zeros; the map needs one (empty) block. */
+		archive_entry_sparse_add_entry(entry,
+		    archive_entry_size(entry), 0);
+
+	/*
+	 * pax->deferred stays set so the header is not deferred again.
+	 * Its warnings were already returned by archive_write_header().
+	 */
+	ret = archive_write_pax_header(a, entry);
+	if (ret < ARCHIVE_WARN)
+		goto fail;
+	if (ret == ARCHIVE_WARN) {
+		archive_clear_error(&a->archive);
+		ret = ARCHIVE_OK;
+	}
+	r = write_sparse_map(a, pax);
+	if (r != ARCHIVE_OK) {
+		ret = r;
+		goto fail;
+	}
+	remaining = lseek(pax->spool_fd, 0, SEEK_CUR);
+	if (remaining < 0 || lseek(pax->spool_fd, 0, SEEK_SET) < 0) {
+		archive_set_error(&a->archive, errno,
+		    "Can't seek the sparse spool file");
+		ret = ARCHIVE_FATAL;
+		goto fail;
+	}
+	while (remaining > 0) {
+		n = PAX_SPOOL_SIZE;
+		if ((int64_t)n > remaining)
+			n = (size_t)remaining;
+		bytes = read(pax->spool_fd, pax->spool_buff, n);
+		if (bytes <= 0) {
+			if (bytes < 0 && errno == EINTR)
+				continue;
+			archive_set_error(&a->archive,
+			    bytes < 0 ? errno : ARCHIVE_ERRNO_MISC,
+			    "Can't read the sparse spool file");
+			ret = ARCHIVE_FATAL;
+			goto fail;
+		}
+		r = detect_sparse_replay(a, pax, pax->spool_buff,
+		    (size_t)bytes);
+		if (r != ARCHIVE_OK) {
+			ret = r;
+			goto fail;
+		}
+		remaining -= bytes;
+	}
+fail:
+	pax->deferred = NULL;
+	archive_entry_free(entry);
+	return (ret);
+}
+
 static int
 has_non_ASCII(const char *_p)
 {
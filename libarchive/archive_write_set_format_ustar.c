@@ -41,6 +41,7 @@
 #include "archive_entry.h"
 #include "archive_entry_locale.h"
 #include "archive_private.h"
+#include "archive_tar_index_private.h"
 #include "archive_write_private.h"
 #include "archive_write_set_format_private.h"
 
@@ -51,6 +52,7 @@ struct ustar {
 	struct archive_string_conv *opt_sconv;
 	struct archive_string_conv *sconv_default;
 	int	init_default_conversion;
+	struct archive_tar_index *index;
 };
 
 /*
@@ -223,6 +225,13 @@ archive_write_ustar_options(struct archive_write *a, const char *key,
 				ret = ARCHIVE_FATAL;
 		}
 		return (ret);
+	} else if (strcmp(key, "index") == 0) {
+		__archive_tar_index_free(ustar->index);
+		ustar->index = NULL;
+		if (val == NULL || val[0] == 0)
+			return (ARCHIVE_OK);
+		return (__archive_tar_index_create(&a->archive,
+		    &ustar->index, val));
 	}
 
 	/* Note: The "warn" return is just to inform the options
@@ -239,8 +248,10 @@ archive_write_ustar_header(struct archive_write *a, struct archive_entry *entry)
 	struct ustar *ustar;
 	struct archive_entry *entry_main;
 	struct archive_string_conv *sconv;
+	int64_t header_offset;
 
 	ustar = (struct ustar *)a->format_data;
+	header_offset = a->filter_first->bytes_written;
 
 	/* Setup default string conversion. */
 	if (ustar->opt_sconv == NULL) {
@@ -361,6 +372,15 @@ archive_write_ustar_header(struct archive_write *a, struct archive_entry *entry)
 	}
 	if (ret2 < ret)
 		ret = ret2;
+	if (ustar->index != NULL) {
+		ret2 = __archive_tar_index_add(&a->archive, ustar->index,
+		    archive_entry_pathname(entry), header_offset,
+		    a->filter_first->bytes_written, archive_entry_size(entry));
+		if (ret2 < ARCHIVE_WARN) {
+			archive_entry_free(entry_main);
+			return (ret2);
+		}
+	}
 
 	ustar->entry_bytes_remaining = archive_entry_size(entry);
 	ustar->entry_padding = 0x1ff & (-(int64_t)ustar->entry_bytes_remaining);
@@ -712,7 +732,13 @@ format_octal(int64_t v, char *p, int s)
 static int
 archive_write_ustar_close(struct archive_write *a)
 {
-	return (__archive_write_nulls(a, 512*2));
+	struct ustar *ustar = (struct ustar *)a->format_data;
+	int ret;
+
+	ret = __archive_write_nulls(a, 512*2);
+	if (ret == ARCHIVE_OK)
+		ret = __archive_tar_index_close(&a->archive, ustar->index);
+	return (ret);
 }
 
 static int
@@ -721,6 +747,7 @@ archive_write_ustar_free(struct archive_write *a)
 	struct ustar *ustar;
 
 	ustar = (struct ustar *)a->format_data;
+	__archive_tar_index_free(ustar->index);
 	free(ustar);
 	a->format_data = NULL;
 	return (ARCHIVE_OK);
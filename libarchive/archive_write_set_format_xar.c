@@ -156,7 +156,23 @@ struct la_zstream {
 				    enum la_zaction action);
 	int			 (*end)(struct archive *a,
 				    struct la_zstream *lastrm);
+	/* Expected input of a new stream, or 0 if unknown. */
+	uint64_t		 size_hint;
+	/* Restart the encoder for a new stream; NULL if unsupported. */
+	int			 (*reset)(struct archive *a,
+				    struct la_zstream *lastrm);
+};
+
+#if defined(HAVE_LZMA_H)
+struct lzma_encoder {
+	lzma_stream		 stream;
+	lzma_filter		 filters[2];
+	lzma_options_lzma	 options;
+	uint32_t		 preset_dict_size;
+	int			 xz;
+	int			 threads;
 };
+#endif
 
 struct chksumval {
 	enum sumalg		 alg;
@@ -246,6 +262,10 @@ struct xar {
 	struct chksumwork	 a_sumwrk;	/* archived checksum.	*/
 	struct chksumwork	 e_sumwrk;	/* extracted checksum.	*/
 	struct la_zstream	 stream;
+	/* Settings `stream' was set up with for file contents. */
+	enum enctype		 stream_compression;
+	int			 stream_compression_level;
+	uint32_t		 stream_threads;
 	struct archive_string_conv *sconv;
 	/*
 	 * Compressed data buffer.
@@ -307,6 +327,7 @@ static int	compression_init_encoder_gzip(struct archive *,
 static int	compression_code_gzip(struct archive *,
 		    struct la_zstream *, enum la_zaction);
 static int	compression_end_gzip(struct archive *, struct la_zstream *);
+static int	compression_reset_gzip(struct archive *, struct la_zstream *);
 static int	compression_init_encoder_bzip2(struct archive *,
 		    struct la_zstream *, int);
 #if defined(HAVE_BZLIB_H) && defined(BZ_CONFIG_ERROR)
@@ -322,8 +343,10 @@ static int	compression_init_encoder_xz(struct archive *,
 static int	compression_code_lzma(struct archive *,
 		    struct la_zstream *, enum la_zaction);
 static int	compression_end_lzma(struct archive *, struct la_zstream *);
+static int	compression_reset_lzma(struct archive *, struct la_zstream *);
 #endif
-static int	xar_compression_init_encoder(struct archive_write *);
+static int	xar_compression_init_encoder(struct archive_write *,
+		    uint64_t);
 static int	compression_code(struct archive *,
 		    struct la_zstream *, enum la_zaction);
 static int	compression_end(struct archive *,
@@ -522,6 +545,7 @@ xar_options(struct archive_write *a, const char *key, const char *value)
 			xar->opt_threads = 1;
 #endif
 		}
+		return (ARCHIVE_OK);
 	}
 
 	/* Note: The "warn" return is just to inform the options
@@ -644,7 +668,7 @@ xar_write_header(struct archive_write *a, struct archive_entry *entry)
 	xar->bytes_remaining = archive_entry_size(file->entry);
 	checksum_init(&(xar->a_sumwrk), xar->opt_sumalg);
 	checksum_init(&(xar->e_sumwrk), xar->opt_sumalg);
-	r = xar_compression_init_encoder(a);
+	r = xar_compression_init_encoder(a, file->data.size);
 
 	if (r != ARCHIVE_OK)
 		return (r);
@@ -2669,6 +2693,19 @@ compression_init_encoder_gzip(struct archive *a,
 	lastrm->valid = 1;
 	lastrm->code = compression_code_gzip;
 	lastrm->end = compression_end_gzip;
+	lastrm->reset = compression_reset_gzip;
+	return (ARCHIVE_OK);
+}
+
+static int
+compression_reset_gzip(struct archive *a, struct la_zstream *lastrm)
+{
+
+	if (deflateReset((z_stream *)lastrm->real_stream) != Z_OK) {
+		archive_set_error(a, ARCHIVE_ERRNO_MISC,
+		    "Internal error initializing compression library");
+		return (ARCHIVE_FATAL);
+	}
 	return (ARCHIVE_OK);
 }
 
@@ -2766,6 +2803,7 @@ compression_init_encoder_bzip2(struct archive *a,
 	lastrm->valid = 1;
 	lastrm->code = compression_code_bzip2;
 	lastrm->end = compression_end_bzip2;
+	lastrm->reset = NULL;
 	return (ARCHIVE_OK);
 }
 
@@ -2849,134 +2887,132 @@ compression_init_encoder_bzip2(struct archive *a,
 #endif
 
 #if defined(HAVE_LZMA_H)
+/*
+ * Start (or restart) the encoder held in `enc'.  liblzma reuses the
+ * buffers of an already initialized lzma_stream, so restarting for the
+ * next file avoids reallocating them and, for the multi-threaded
+ * encoder, recreating its worker threads.
+ *
+ * A dictionary larger than the input cannot improve compression, but
+ * its match finder tables are cleared on every start, which dominates
+ * the cost of compressing small files.  Size the dictionary to the
+ * input when it is known.
+ */
 static int
-compression_init_encoder_lzma(struct archive *a,
-    struct la_zstream *lastrm, int level)
+lzma_encoder_start(struct archive *a, struct la_zstream *lastrm,
+    struct lzma_encoder *enc)
 {
-	static const lzma_stream lzma_init_data = LZMA_STREAM_INIT;
-	lzma_stream *strm;
-	lzma_options_lzma lzma_opt;
+	uint32_t dict_size;
 	int r;
+#ifdef HAVE_LZMA_STREAM_ENCODER_MT
+	lzma_mt mt_options;
+#endif
 
-	if (lastrm->valid)
-		compression_end(a, lastrm);
-	if (lzma_lzma_preset(&lzma_opt, level)) {
-		lastrm->real_stream = NULL;
-		archive_set_error(a, ENOMEM,
-		    "Internal error initializing compression library");
-		return (ARCHIVE_FATAL);
+	dict_size = enc->preset_dict_size;
+	if (lastrm->size_hint > 0 && lastrm->size_hint < dict_size) {
+		dict_size = LZMA_DICT_SIZE_MIN;
+		while (dict_size < lastrm->size_hint)
+			dict_size <<= 1;
 	}
-	strm = calloc(1, sizeof(*strm));
-	if (strm == NULL) {
-		archive_set_error(a, ENOMEM,
-		    "Can't allocate memory for lzma stream");
-		return (ARCHIVE_FATAL);
+	enc->options.dict_size = dict_size;
+	if (!enc->xz)
+		r = lzma_alone_encoder(&(enc->stream), &(enc->options));
+#ifdef HAVE_LZMA_STREAM_ENCODER_MT
+	else if (enc->threads > 1) {
+		memset(&mt_options, 0, sizeof(mt_options));
+		mt_options.threads = enc->threads;
+		mt_options.timeout = 300;
+		mt_options.filters = enc->filters;
+		mt_options.check = LZMA_CHECK_CRC64;
+		r = lzma_stream_encoder_mt(&(enc->stream), &mt_options);
 	}
-	*strm = lzma_init_data;
-	r = lzma_alone_encoder(strm, &lzma_opt);
+#endif
+	else
+		r = lzma_stream_encoder(&(enc->stream), enc->filters,
+		    LZMA_CHECK_CRC64);
 	switch (r) {
 	case LZMA_OK:
-		lastrm->real_stream = strm;
+		lastrm->real_stream = enc;
 		lastrm->valid = 1;
 		lastrm->code = compression_code_lzma;
 		lastrm->end = compression_end_lzma;
-		r = ARCHIVE_OK;
-		break;
+		lastrm->reset = compression_reset_lzma;
+		return (ARCHIVE_OK);
 	case LZMA_MEM_ERROR:
-		free(strm);
-		lastrm->real_stream = NULL;
 		archive_set_error(a, ENOMEM,
 		    "Internal error initializing compression library: "
 		    "Cannot allocate memory");
-		r =  ARCHIVE_FATAL;
 		break;
-        default:
-		free(strm);
-		lastrm->real_stream = NULL;
+	default:
 		archive_set_error(a, ARCHIVE_ERRNO_MISC,
 		    "Internal error initializing compression library: "
 		    "It's a bug in liblzma");
-		r =  ARCHIVE_FATAL;
 		break;
 	}
-	return (r);
+	lzma_end(&(enc->stream));
+	free(enc);
+	lastrm->valid = 0;
+	lastrm->real_stream = NULL;
+	return (ARCHIVE_FATAL);
 }
 
 static int
-compression_init_encoder_xz(struct archive *a,
-    struct la_zstream *lastrm, int level, int threads)
+lzma_encoder_init(struct archive *a, struct la_zstream *lastrm,
+    int level, int xz, int threads)
 {
 	static const lzma_stream lzma_init_data = LZMA_STREAM_INIT;
-	lzma_stream *strm;
-	lzma_filter *lzmafilters;
-	lzma_options_lzma lzma_opt;
-	int r;
-#ifdef HAVE_LZMA_STREAM_ENCODER_MT
-	lzma_mt mt_options;
-#endif
-
-	(void)threads; /* UNUSED (if multi-threaded LZMA library not avail) */
+	struct lzma_encoder *enc;
 
 	if (lastrm->valid)
 		compression_end(a, lastrm);
-	strm = calloc(1, sizeof(*strm) + sizeof(*lzmafilters) * 2);
-	if (strm == NULL) {
+	enc = calloc(1, sizeof(*enc));
+	if (enc == NULL) {
 		archive_set_error(a, ENOMEM,
-		    "Can't allocate memory for xz stream");
+		    "Can't allocate memory for %s stream",
+		    xz ? "xz" : "lzma");
 		return (ARCHIVE_FATAL);
 	}
-	lzmafilters = (lzma_filter *)(strm+1);
 	if (level > 9)
 		level = 9;
-	if (lzma_lzma_preset(&lzma_opt, level)) {
-		free(strm);
+	if (lzma_lzma_preset(&(enc->options), level)) {
+		free(enc);
 		lastrm->real_stream = NULL;
 		archive_set_error(a, ENOMEM,
 		    "Internal error initializing compression library");
 		return (ARCHIVE_FATAL);
 	}
-	lzmafilters[0].id = LZMA_FILTER_LZMA2;
-	lzmafilters[0].options = &lzma_opt;
-	lzmafilters[1].id = LZMA_VLI_UNKNOWN;/* Terminate */
+	enc->preset_dict_size = enc->options.dict_size;
+	enc->filters[0].id = LZMA_FILTER_LZMA2;
+	enc->filters[0].options = &(enc->options);
+	enc->filters[1].id = LZMA_VLI_UNKNOWN;/* Terminate */
+	enc->xz = xz;
+	enc->threads = threads;
+	enc->stream = lzma_init_data;
+	return (lzma_encoder_start(a, lastrm, enc));
+}
 
-	*strm = lzma_init_data;
-#ifdef HAVE_LZMA_STREAM_ENCODER_MT
-	if (threads > 1) {
-		memset(&mt_options, 0, sizeof(mt_options));
-		mt_options.threads = threads;
-		mt_options.timeout = 300;
-		mt_options.filters = lzmafilters;
-		mt_options.check = LZMA_CHECK_CRC64;
-		r = lzma_stream_encoder_mt(strm, &mt_options);
-	} else
-#endif
-		r = lzma_stream_encoder(strm, lzmafilters, LZMA_CHECK_CRC64);
-	switch (r) {
-	case LZMA_OK:
-		lastrm->real_stream = strm;
-		lastrm->valid = 1;
-		lastrm->code = compression_code_lzma;
-		lastrm->end = compression_end_lzma;
-		r = ARCHIVE_OK;
-		break;
-	case LZMA_MEM_ERROR:
-		free(strm);
-		lastrm->real_stream = NULL;
-		archive_set_error(a, ENOMEM,
-		    "Internal error initializing compression library: "
-		    "Cannot allocate memory");
-		r =  ARCHIVE_FATAL;
-		break;
-        default:
-		free(strm);
-		lastrm->real_stream = NULL;
-		archive_set_error(a, ARCHIVE_ERRNO_MISC,
-		    "Internal error initializing compression library: "
-		    "It's a bug in liblzma");
-		r =  ARCHIVE_FATAL;
-		break;
-	}
-	return (r);
+static int
+compression_init_encoder_lzma(struct archive *a,
+    struct la_zstream *lastrm, int level)
+{
+
+	return (lzma_encoder_init(a, lastrm, level, 0, 1));
+}
+
+static int
+compression_init_encoder_xz(struct archive *a,
+    struct la_zstream *lastrm, int level, int threads)
+{
+
+	return (lzma_encoder_init(a, lastrm, level, 1, threads));
+}
+
+static int
+compression_reset_lzma(struct archive *a, struct la_zstream *lastrm)
+{
+
+	return (lzma_encoder_start(a, lastrm,
+	    (struct lzma_encoder *)lastrm->real_stream));
 }
 
 static int
@@ -2986,7 +3022,7 @@ compression_code_lzma(struct archive *a,
 	lzma_stream *strm;
 	int r;
 
-	strm = (lzma_stream *)lastrm->real_stream;
+	strm = &(((struct lzma_encoder *)lastrm->real_stream)->stream);
 	strm->next_in = lastrm->next_in;
 	strm->avail_in = lastrm->avail_in;
 	strm->total_in = lastrm->total_in;
@@ -3027,12 +3063,12 @@ compression_code_lzma(struct archive *a,
 static int
 compression_end_lzma(struct archive *a, struct la_zstream *lastrm)
 {
-	lzma_stream *strm;
+	struct lzma_encoder *enc;
 
 	(void)a; /* UNUSED */
-	strm = (lzma_stream *)lastrm->real_stream;
-	lzma_end(strm);
-	free(strm);
+	enc = (struct lzma_encoder *)lastrm->real_stream;
+	lzma_end(&(enc->stream));
+	free(enc);
 	lastrm->valid = 0;
 	lastrm->real_stream = NULL;
 	return (ARCHIVE_OK);
@@ -3062,12 +3098,28 @@ compression_init_encoder_xz(struct archive *a,
 #endif
 
 static int
-xar_compression_init_encoder(struct archive_write *a)
+xar_compression_init_encoder(struct archive_write *a, uint64_t size)
 {
 	struct xar *xar;
 	int r;
 
 	xar = (struct xar *)a->format_data;
+	xar->stream.size_hint = size;
+	/*
+	 * Restart the previous file's encoder when the settings have
+	 * not changed; setting up a new one for each small file costs
+	 * far more than compressing it.
+	 */
+	if (xar->stream.valid && xar->stream.reset != NULL &&
+	    xar->stream_compression == xar->opt_compression &&
+	    xar->stream_compression_level == xar->opt_compression_level &&
+	    xar->stream_threads == xar->opt_threads) {
+		r = xar->stream.reset(&(a->archive), &(xar->stream));
+		goto done;
+	}
+	xar->stream_compression = xar->opt_compression;
+	xar->stream_compression_level = xar->opt_compression_level;
+	xar->stream_threads = xar->opt_threads;
 	switch (xar->opt_compression) {
 	case GZIP:
 		r = compression_init_encoder_gzip(
@@ -3093,6 +3145,7 @@ xar_compression_init_encoder(struct archive_write *a)
 		r = ARCHIVE_OK;
 		break;
 	}
+done:
 	if (r == ARCHIVE_OK) {
 		xar->stream.total_in = 0;
 		xar->stream.next_out = xar->wbuff;
@@ -3178,7 +3231,7 @@ save_xattrs(struct archive_write *a, struct file *file)
 		/*
 		 * Init compression library.
 		 */
-		r = xar_compression_init_encoder(a);
+		r = xar_compression_init_encoder(a, size);
 		if (r != ARCHIVE_OK) {
 			free(heap);
 			return (ARCHIVE_FATAL);
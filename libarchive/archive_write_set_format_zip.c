@@ -57,6 +57,7 @@
 #include "archive_random_private.h"
 #include "archive_write_private.h"
 #include "archive_write_set_format_private.h"
+#include "archive_zipcrypto_private.h"
 
 #ifndef HAVE_ZLIB_H
 #include "archive_crc32.h"
@@ -114,10 +115,6 @@ struct cd_segment {
 	unsigned char *p;
 };
 
-struct trad_enc_ctx {
-	uint32_t keys[3];
-};
-
 struct zip {
 
 	int64_t entry_offset;
@@ -1499,52 +1496,21 @@ get_sconv(struct archive_write *a, struct zip *zip)
   Traditional PKWARE Decryption functions.
  */
 
-static void
-trad_enc_update_keys(struct trad_enc_ctx *ctx, uint8_t c)
-{
-	uint8_t t;
-#define CRC32(c, b) (crc32(c ^ 0xffffffffUL, &b, 1) ^ 0xffffffffUL)
-
-	ctx->keys[0] = CRC32(ctx->keys[0], c);
-	ctx->keys[1] = (ctx->keys[1] + (ctx->keys[0] & 0xff)) * 134775813L + 1;
-	t = (ctx->keys[1] >> 24) & 0xff;
-	ctx->keys[2] = CRC32(ctx->keys[2], t);
-#undef CRC32
-}
-
-static uint8_t
-trad_enc_decrypt_byte(struct trad_enc_ctx *ctx)
-{
-	unsigned temp = ctx->keys[2] | 2;
-	return (uint8_t)((temp * (temp ^ 1)) >> 8) & 0xff;
-}
-
 static unsigned
 trad_enc_encrypt_update(struct trad_enc_ctx *ctx, const uint8_t *in,
     size_t in_len, uint8_t *out, size_t out_len)
 {
-	unsigned i, max;
+	unsigned max;
 
 	max = (unsigned)((in_len < out_len)? in_len: out_len);
-
-	for (i = 0; i < max; i++) {
-		uint8_t t = in[i];
-		out[i] = t ^ trad_enc_decrypt_byte(ctx);
-		trad_enc_update_keys(ctx, t);
-	}
-	return i;
+	__archive_zipcrypto_encrypt(ctx, in, out, max);
+	return max;
 }
 
 static int
 trad_enc_init(struct trad_enc_ctx *ctx, const char *pw, size_t pw_len)
 {
-
-	ctx->keys[0] = 305419896L;
-	ctx->keys[1] = 591751049L;
-	ctx->keys[2] = 878082192L;
-
-	for (;pw_len; --pw_len)
-		trad_enc_update_keys(ctx, *pw++);
+	__archive_zipcrypto_init(ctx, pw, pw_len);
 	return 0;
 }
 
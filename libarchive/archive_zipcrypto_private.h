@@ -0,0 +1,55 @@
+/*-
+ * Copyright (c) 2026 The libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARCHIVE_ZIPCRYPTO_PRIVATE_H_INCLUDED
+#define ARCHIVE_ZIPCRYPTO_PRIVATE_H_INCLUDED
+
+#ifndef __LIBARCHIVE_BUILD
+#error This header is only to be used internally to libarchive.
+#endif
+
+#include <stddef.h>
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#endif
+
+/*
+ * Traditional PKWARE encryption ("ZipCrypto") shared by the zip
+ * reader and writer.
+ */
+struct trad_enc_ctx {
+	uint32_t	keys[3];
+};
+
+/* Set up the keys from a passphrase. */
+void	__archive_zipcrypto_init(struct trad_enc_ctx *, const char *,
+	    size_t);
+/* Decrypt or encrypt `len' bytes; `in' and `out' may be the same. */
+void	__archive_zipcrypto_decrypt(struct trad_enc_ctx *, const uint8_t *,
+	    uint8_t *, size_t);
+void	__archive_zipcrypto_encrypt(struct trad_enc_ctx *, const uint8_t *,
+	    uint8_t *, size_t);
+
+#endif /* ARCHIVE_ZIPCRYPTO_PRIVATE_H_INCLUDED */
@@ -428,6 +428,116 @@ test_exclusion_and_inclusion(void)
 	archive_match_free(m);
 }
 
+/*
+ * Long pattern lists are matched through a hash table of the literal
+ * patterns; check that it agrees with matching the patterns one by one.
+ */
+static int
+excluded_by(const char *pattern, int exclude, int fillers,
+    int recursion, const char *path)
+{
+	struct archive_entry *ae;
+	struct archive *m;
+	char buff[32];
+	int i, r;
+
+	if (!assert((m = archive_match_new()) != NULL))
+		return (-1);
+	if (!assert((ae = archive_entry_new()) != NULL)) {
+		archive_match_free(m);
+		return (-1);
+	}
+
+	archive_match_set_inclusion_recursion(m, recursion);
+	for (i = 0; i < fillers; i++) {
+		snprintf(buff, sizeof(buff), "filler%d/x", i);
+		if (exclude)
+			archive_match_exclude_pattern(m, buff);
+		else
+			archive_match_include_pattern(m, buff);
+	}
+	if (exclude)
+		archive_match_exclude_pattern(m, pattern);
+	else
+		archive_match_include_pattern(m, pattern);
+	archive_entry_copy_pathname(ae, path);
+	r = archive_match_path_excluded(m, ae);
+	archive_entry_free(ae);
+	archive_match_free(m);
+	return (r);
+}
+
+static void
+test_many_patterns(void)
+{
+	static const char *patterns[] = {
+		"a", "a/b", "b/c", "abc", "a.b", "a$b", ".", "..",
+		"a/.b", "a/", "b", "a*", "a/./b", "./a", "^a", "/a", "a$",
+		NULL
+	};
+	static const char *paths[] = {
+		"a", "a/", "a/b", "a/b/c", "x/a", "x/a/b", "x/a/b/y", "ab",
+		"xa", "abc", "x/abc/y", "a.b", "a$b", ".", "x/.", "a/.",
+		"..", "x/../a", "a/.b", "./a", "./a/b", "a//b", "x//a",
+		"a/./b", "/a", "/a/b", "b/c/d", "x/b/c", "", NULL
+	};
+	struct archive_entry *ae;
+	struct archive *m;
+	const char *mp;
+	char buff[32];
+	int i, j, k, n;
+
+	for (i = 0; patterns[i] != NULL; i++) {
+		for (j = 0; paths[j] != NULL; j++) {
+			for (k = 0; k < 3; k++) {
+				failure("pattern '%s', path '%s', %s",
+				    patterns[i], paths[j], k == 0 ? "exclusion" :
+				    k == 1 ? "recursive inclusion" : "inclusion");
+				assertEqualInt(
+				    excluded_by(patterns[i], k == 0, 0,
+				      k == 1, paths[j]),
+				    excluded_by(patterns[i], k == 0, 40,
+				      k == 1, paths[j]));
+			}
+		}
+	}
+
+	/* Unmatched inclusions are still reported. */
+	if (!assert((m = archive_match_new()) != NULL))
+		return;
+	if (!assert((ae = archive_entry_new()) != NULL)) {
+		archive_match_free(m);
+		return;
+	}
+	for (i = 0; i < 100; i++) {
+		snprintf(buff, sizeof(buff), "dir%d", i);
+		assertEqualIntA(m, 0, archive_match_include_pattern(m, buff));
+	}
+	assertEqualIntA(m, 0, archive_match_include_pattern(m, "dir1*"));
+	assertEqualIntA(m, 0, archive_match_exclude_pattern(m, "dir2"));
+	archive_entry_copy_pathname(ae, "dir5/file");
+	assertEqualInt(0, archive_match_path_excluded(m, ae));
+	archive_entry_copy_pathname(ae, "dir10");
+	assertEqualInt(0, archive_match_path_excluded(m, ae));
+	archive_entry_copy_pathname(ae, "dir2/file");
+	assertEqualInt(1, archive_match_path_excluded(m, ae));
+	archive_entry_copy_pathname(ae, "dir200");
+	assertEqualInt(1, archive_match_path_excluded(m, ae));
+	assertEqualInt(97, archive_match_path_unmatched_inclusions(m));
+	n = 0;
+	while (archive_match_path_unmatched_inclusions_next(m, &mp)
+	    == ARCHIVE_OK) {
+		assert(strcmp(mp, "dir5") != 0);
+		assert(strcmp(mp, "dir10") != 0);
+		assert(strcmp(mp, "dir2") != 0);
+		n++;
+	}
+	assertEqualInt(97, n);
+
+	archive_entry_free(ae);
+	archive_match_free(m);
+}
+
 DEFINE_TEST(test_archive_match_path)
 {
 	/* Make exclusion sample files which contain exclusion patterns. */
@@ -446,4 +556,5 @@ DEFINE_TEST(test_archive_match_path)
 	test_inclusion_from_file_mbs();
 	test_inclusion_from_file_wcs();
 	test_exclusion_and_inclusion();
+	test_many_patterns();
 }
@@ -850,6 +850,50 @@ test_archive_string_set_get(void)
 
 }
 
+/*
+ * ASCII strings are copied between forms without being converted; make
+ * sure that is still the case in the "C" locale, and that non-ASCII
+ * strings still go through (and fail) the real conversion.
+ */
+static void
+test_archive_string_set_get_c_locale(void)
+{
+	struct archive *a;
+	struct archive_mstring mstr;
+	struct archive_string_conv *sc;
+	const char *p;
+
+	if (NULL == setlocale(LC_ALL, "C")) {
+		skipping("Can't set \"C\" locale");
+		return;
+	}
+
+	assert((a = archive_read_new()) != NULL);
+	memset(&mstr, 0, sizeof(mstr));
+
+	assertA(NULL != (sc =
+	    archive_string_conversion_from_charset(a, "UTF-8", 1)));
+
+	assertEqualInt(0, archive_mstring_copy_mbs(&mstr, "AAA"));
+	check_string(a, &mstr, sc, "AAA", L"AAA");
+	assertEqualInt(5, archive_mstring_copy_utf8(&mstr, "BB/BB"));
+	check_string(a, &mstr, sc, "BB/BB", L"BB/BB");
+	assertEqualInt(0, archive_mstring_copy_wcs(&mstr, L"CCC12"));
+	check_string(a, &mstr, sc, "CCC12", L"CCC12");
+	assertEqualInt(0, archive_mstring_copy_mbs_len_l(&mstr, "DDDD-l", 6,
+	    sc));
+	check_string(a, &mstr, sc, "DDDD-l", L"DDDD-l");
+
+	/* "\xC3\xA9" is U+00E9, which the "C" locale can't represent. */
+	assertEqualInt(-1, archive_mstring_copy_mbs_len_l(&mstr,
+	    "caf\xC3\xA9", 5, sc));
+	archive_mstring_copy_utf8(&mstr, "caf\xC3\xA9");
+	assertEqualInt(-1, archive_mstring_get_mbs(a, &mstr, &p));
+
+	archive_mstring_clean(&mstr);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+}
+
 DEFINE_TEST(test_archive_string_conversion)
 {
 	static const char reffile[] = "test_archive_string_conversion.txt.Z";
@@ -881,4 +925,5 @@ DEFINE_TEST(test_archive_string_conversion)
 	test_archive_string_normalization_mac_nfd(testdata);
 	test_archive_string_canonicalization();
 	test_archive_string_set_get();
+	test_archive_string_set_get_c_locale();
 }
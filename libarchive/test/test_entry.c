@@ -971,3 +971,73 @@ DEFINE_TEST(test_entry)
 	/* Release the experimental entry. */
 	archive_entry_free(e);
 }
+
+/*
+ * archive_entry_clear() keeps buffers and list nodes for reuse; make sure
+ * nothing from the previous contents leaks into a refilled entry.
+ */
+DEFINE_TEST(test_entry_clear_reuse)
+{
+	struct archive_entry *e;
+	const char *xname;
+	const void *xval;
+	size_t xsize;
+	la_int64_t offset, length;
+	int i;
+
+	assert((e = archive_entry_new()) != NULL);
+	for (i = 0; i < 3; i++) {
+		archive_entry_clear(e);
+		assertEqualString(archive_entry_pathname(e), NULL);
+		assertEqualWString(archive_entry_pathname_w(e), NULL);
+		assertEqualString(archive_entry_uname(e), NULL);
+		assertEqualString(archive_entry_symlink(e), NULL);
+		assertEqualInt(0, archive_entry_xattr_count(e));
+		assertEqualInt(0, archive_entry_sparse_count(e));
+
+		archive_entry_set_size(e, 1000);
+		if (i == 1) {
+			/* Shorter values than before. */
+			archive_entry_copy_pathname(e, "p");
+			archive_entry_copy_uname(e, "u");
+			archive_entry_xattr_add_entry(e, "x", "v", 1);
+			archive_entry_sparse_add_entry(e, 10, 5);
+			assertEqualString(archive_entry_pathname(e), "p");
+			assertEqualWString(archive_entry_pathname_w(e), L"p");
+			assertEqualString(archive_entry_uname(e), "u");
+			assertEqualInt(1, archive_entry_xattr_reset(e));
+			assertEqualInt(0, archive_entry_xattr_next(e, &xname,
+			    &xval, &xsize));
+			assertEqualString(xname, "x");
+			assertEqualInt(1, (int)xsize);
+			assertEqualMem(xval, "v", 1);
+			assertEqualInt(1, archive_entry_sparse_reset(e));
+			assertEqualInt(0, archive_entry_sparse_next(e, &offset,
+			    &length));
+			assertEqualInt(10, (int)offset);
+			assertEqualInt(5, (int)length);
+		} else {
+			archive_entry_copy_pathname(e, "a/much/longer/path");
+			archive_entry_copy_uname(e, "username");
+			archive_entry_copy_symlink(e, "target");
+			archive_entry_xattr_add_entry(e, "user.one", "value1", 6);
+			archive_entry_xattr_add_entry(e, "user.two",
+			    "a longer value", 14);
+			archive_entry_sparse_add_entry(e, 0, 100);
+			archive_entry_sparse_add_entry(e, 200, 100);
+			assertEqualString(archive_entry_pathname(e),
+			    "a/much/longer/path");
+			assertEqualString(archive_entry_uname(e), "username");
+			assertEqualString(archive_entry_symlink(e), "target");
+			assertEqualInt(2, archive_entry_xattr_reset(e));
+			assertEqualInt(0, archive_entry_xattr_next(e, &xname,
+			    &xval, &xsize));
+			assertEqualString(xname, "user.two");
+			assertEqualInt(14, (int)xsize);
+			assertEqualMem(xval, "a longer value", 14);
+			assertEqualInt(2, archive_entry_sparse_count(e));
+		}
+		assertEqualInt(1000, archive_entry_size(e));
+	}
+	archive_entry_free(e);
+}
@@ -196,9 +196,220 @@ static void test_linkify_new_cpio(void)
 	archive_entry_linkresolver_free(resolver);
 }
 
+/*
+ * Enough links to grow the table, with a memory limit small enough that
+ * most pathnames end up in the spill file.
+ */
+#define	MANY_LINKS	5000
+
+static void
+many_entry(struct archive_entry *entry, const char *prefix, int i,
+    int nlink)
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "%s%d", prefix, i);
+	archive_entry_clear(entry);
+	archive_entry_set_pathname(entry, name);
+	archive_entry_set_filetype(entry, AE_IFREG);
+	archive_entry_set_ino(entry, i / 3);
+	archive_entry_set_dev(entry, i % 3);
+	archive_entry_set_nlink(entry, nlink);
+	archive_entry_set_size(entry, 10);
+}
+
+static void test_linkify_many(void)
+{
+	struct archive_entry *entry, *e2;
+	struct archive_entry_linkresolver *resolver;
+	char name[32];
+	int i, seen[MANY_LINKS];
+
+	assert(NULL != (resolver = archive_entry_linkresolver_new()));
+	archive_entry_linkresolver_set_strategy(resolver,
+	    ARCHIVE_FORMAT_TAR_USTAR);
+	archive_entry_linkresolver_set_memory_limit(resolver, 64 * 1024);
+	assert(NULL != (entry = archive_entry_new()));
+
+	/* First link of each file is stored with its body. */
+	for (i = 0; i < MANY_LINKS; i++) {
+		many_entry(entry, "a", i, 3);
+		archive_entry_linkify(resolver, &entry, &e2);
+		assert(e2 == NULL);
+		assertEqualString(NULL, archive_entry_hardlink(entry));
+		assertEqualInt(10, archive_entry_size(entry));
+	}
+	/* Second link refers back to the first. */
+	for (i = MANY_LINKS - 1; i >= 0; i--) {
+		many_entry(entry, "b", i, 3);
+		archive_entry_linkify(resolver, &entry, &e2);
+		snprintf(name, sizeof(name), "a%d", i);
+		assertEqualString(name, archive_entry_hardlink(entry));
+		assertEqualInt(0, archive_entry_size(entry));
+	}
+	/* Third link completes the even files and drops them. */
+	for (i = 0; i < MANY_LINKS; i += 2) {
+		many_entry(entry, "c", i, 3);
+		archive_entry_linkify(resolver, &entry, &e2);
+		snprintf(name, sizeof(name), "a%d", i);
+		assertEqualString(name, archive_entry_hardlink(entry));
+	}
+	/* Dropped files are not matched again; the others still are. */
+	for (i = 0; i < MANY_LINKS; i++) {
+		many_entry(entry, "d", i, 3);
+		archive_entry_linkify(resolver, &entry, &e2);
+		if (i % 2 == 0) {
+			assertEqualString(NULL,
+			    archive_entry_hardlink(entry));
+		} else {
+			snprintf(name, sizeof(name), "a%d", i);
+			assertEqualString(name,
+			    archive_entry_hardlink(entry));
+		}
+	}
+	archive_entry_free(entry);
+	archive_entry_linkresolver_free(resolver);
+
+	/* New cpio holds every entry back until it is flushed. */
+	assert(NULL != (resolver = archive_entry_linkresolver_new()));
+	archive_entry_linkresolver_set_strategy(resolver,
+	    ARCHIVE_FORMAT_CPIO_SVR4_NOCRC);
+	archive_entry_linkresolver_set_memory_limit(resolver, 64 * 1024);
+	memset(seen, 0, sizeof(seen));
+	for (i = 0; i < MANY_LINKS; i++) {
+		assert(NULL != (entry = archive_entry_new()));
+		many_entry(entry, "a", i, 2);
+		archive_entry_linkify(resolver, &entry, &e2);
+		assert(entry == NULL);
+		assert(e2 == NULL);
+	}
+	for (;;) {
+		entry = NULL;
+		archive_entry_linkify(resolver, &entry, &e2);
+		if (entry == NULL)
+			break;
+		assert(e2 == NULL);
+		i = atoi(archive_entry_pathname(entry) + 1);
+		assert(i >= 0 && i < MANY_LINKS);
+		if (i >= 0 && i < MANY_LINKS)
+			seen[i]++;
+		archive_entry_free(entry);
+	}
+	for (i = 0; i < MANY_LINKS; i++)
+		assertEqualInt(1, seen[i]);
+	archive_entry_linkresolver_free(resolver);
+}
+
+/*
+ * Files with links missing are handed back whole, whether the first link
+ * was kept in memory or written to the spill file.
+ */
+static void test_partial_links(void)
+{
+	struct archive_entry *entry, *e2;
+	struct archive_entry_linkresolver *resolver;
+	unsigned int links;
+	char *acl;
+
+	assert(NULL != (resolver = archive_entry_linkresolver_new()));
+	archive_entry_linkresolver_set_strategy(resolver,
+	    ARCHIVE_FORMAT_TAR_USTAR);
+	assert(NULL != (entry = archive_entry_new()));
+	archive_entry_set_pathname(entry, "test1");
+	archive_entry_set_ino(entry, 1);
+	archive_entry_set_dev(entry, 2);
+	archive_entry_set_nlink(entry, 3);
+	archive_entry_set_mode(entry, AE_IFREG | 0640);
+	archive_entry_set_size(entry, 10);
+	archive_entry_set_mtime(entry, 12345, 0);
+	archive_entry_copy_uname(entry, "user");
+	archive_entry_linkify(resolver, &entry, &e2);
+	archive_entry_free(entry);
+
+	assert(NULL != (entry = archive_entry_partial_links(resolver, &links)));
+	assertEqualInt(2, links);
+	assertEqualString("test1", archive_entry_pathname(entry));
+	assertEqualInt(10, archive_entry_size(entry));
+	assertEqualInt(12345, archive_entry_mtime(entry));
+	assertEqualString("user", archive_entry_uname(entry));
+	archive_entry_free(entry);
+	assert(NULL == archive_entry_partial_links(resolver, &links));
+	assertEqualInt(0, links);
+	archive_entry_linkresolver_free(resolver);
+
+	/* Past the memory limit the first link goes to the spill file. */
+	assert(NULL != (resolver = archive_entry_linkresolver_new()));
+	archive_entry_linkresolver_set_strategy(resolver,
+	    ARCHIVE_FORMAT_TAR_USTAR);
+	archive_entry_linkresolver_set_memory_limit(resolver, 1);
+	assert(NULL != (entry = archive_entry_new()));
+	archive_entry_set_pathname(entry, "test2");
+	archive_entry_set_ino(entry, 1);
+	archive_entry_set_dev(entry, 2);
+	archive_entry_set_nlink(entry, 2);
+	archive_entry_set_mode(entry, AE_IFREG | 0640);
+	archive_entry_set_size(entry, 10);
+	archive_entry_set_mtime(entry, 12345, 678);
+	archive_entry_set_uid(entry, 1000);
+	archive_entry_copy_uname(entry, "user");
+	archive_entry_copy_gname(entry, "group");
+	archive_entry_copy_sourcepath(entry, "/src/test2");
+	archive_entry_copy_fflags_text(entry, "nodump");
+	archive_entry_xattr_add_entry(entry, "user.foo", "bar", 3);
+	assertEqualInt(ARCHIVE_OK, archive_entry_acl_add_entry(entry,
+	    ARCHIVE_ENTRY_ACL_TYPE_ACCESS, ARCHIVE_ENTRY_ACL_READ,
+	    ARCHIVE_ENTRY_ACL_USER, 77, "luser"));
+	archive_entry_sparse_add_entry(entry, 4, 6);
+	archive_entry_linkify(resolver, &entry, &e2);
+	archive_entry_free(entry);
+
+	assert(NULL != (entry = archive_entry_partial_links(resolver, &links)));
+	assertEqualInt(1, links);
+	assertEqualString("test2", archive_entry_pathname(entry));
+	assertEqualInt(1, archive_entry_ino64(entry));
+	assertEqualInt(2, archive_entry_dev(entry));
+	assertEqualInt(2, archive_entry_nlink(entry));
+	assertEqualInt(AE_IFREG | 0640, archive_entry_mode(entry));
+	assertEqualInt(10, archive_entry_size(entry));
+	assertEqualInt(12345, archive_entry_mtime(entry));
+	assertEqualInt(678, archive_entry_mtime_nsec(entry));
+	assert(!archive_entry_atime_is_set(entry));
+	assertEqualInt(1000, archive_entry_uid(entry));
+	assertEqualString("user", archive_entry_uname(entry));
+	assertEqualWString(L"user", archive_entry_uname_w(entry));
+	assertEqualString("group", archive_entry_gname(entry));
+	assertEqualString("/src/test2", archive_entry_sourcepath(entry));
+	assertEqualString("nodump", archive_entry_fflags_text(entry));
+	assertEqualInt(1, archive_entry_xattr_reset(entry));
+	{
+		const char *xname;
+		const void *xval;
+		size_t xsize;
+
+		assertEqualInt(ARCHIVE_OK,
+		    archive_entry_xattr_next(entry, &xname, &xval, &xsize));
+		assertEqualString("user.foo", xname);
+		assertEqualInt(3, xsize);
+		assertEqualMem("bar", xval, 3);
+	}
+	acl = archive_entry_acl_to_text(entry, NULL,
+	    ARCHIVE_ENTRY_ACL_TYPE_ACCESS | ARCHIVE_ENTRY_ACL_STYLE_EXTRA_ID |
+	    ARCHIVE_ENTRY_ACL_STYLE_SEPARATOR_COMMA);
+	assertEqualString("user::rw-,group::r--,other::---,user:luser:r--:77",
+	    acl);
+	free(acl);
+	assertEqualInt(1, archive_entry_sparse_count(entry));
+	archive_entry_free(entry);
+	assert(NULL == archive_entry_partial_links(resolver, &links));
+	assertEqualInt(0, links);
+	archive_entry_linkresolver_free(resolver);
+}
+
 DEFINE_TEST(test_link_resolver)
 {
 	test_linkify_tar();
 	test_linkify_old_cpio();
 	test_linkify_new_cpio();
+	test_linkify_many();
+	test_partial_links();
 }
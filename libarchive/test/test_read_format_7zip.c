@@ -31,6 +31,7 @@
 
 #define __LIBARCHIVE_BUILD
 #include <archive_crc32.h>
+#include <archive_digest_private.h>
 
 /*
  * Extract a non-encoded file.
@@ -1257,3 +1258,122 @@ DEFINE_TEST(test_read_format_7zip_win_attrib)
 
 	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
 }
+
+/*
+ * Read members of a solid folder through the shared solid cache from
+ * several read handles; the second pass is served from the cache.
+ */
+static void
+test_solid_cache_pass(const char *refname, const char *options)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char buff[128];
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_set_options(a, options));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_filename(a, refname, 10240));
+
+	/* Skip file1, read file2, skip file3 and read file4. */
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("dir1/file1", archive_entry_pathname(ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("file2", archive_entry_pathname(ae));
+	assertEqualInt(26, archive_read_data(a, buff, sizeof(buff)));
+	assertEqualMem(buff, "aaaaaaaaaaaa\nbbbbbbbbbbbb\n", 26);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("file3", archive_entry_pathname(ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("file4", archive_entry_pathname(ae));
+	assertEqualInt(52, archive_read_data(a, buff, sizeof(buff)));
+	assertEqualMem(buff,
+	    "aaaaaaaaaaaa\nbbbbbbbbbbbb\ncccccccccccc\ndddddddddddd\n", 52);
+
+	assertEqualInt(ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+}
+
+static int
+can_sha256(void)
+{
+	archive_sha256_ctx ctx;
+	unsigned char md[32];
+
+	if (ARCHIVE_OK != archive_sha256_init(&ctx))
+		return (0);
+	archive_sha256_final(&ctx, md);
+	return (1);
+}
+
+DEFINE_TEST(test_read_format_7zip_solid_cache)
+{
+	const char *refname = "test_read_format_7zip_lzma1_2.7z";
+	struct archive *a;
+	la_int64_t limit, used, used2, hits, hits2;
+
+	assert((a = archive_read_new()) != NULL);
+	if (ARCHIVE_OK != archive_read_support_filter_xz(a)) {
+		skipping("7zip:lzma decoding is not supported on this "
+		    "platform");
+		assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+		return;
+	}
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	extract_reference_file(refname);
+	if (!can_sha256()) {
+		/* The cache is not used, but reading must still work. */
+		skipping("The solid cache requires SHA256 support");
+		test_solid_cache_pass(refname, "7zip:solid-cache=1m");
+		return;
+	}
+
+	archive_solid_cache_stats(&limit, NULL, &hits);
+	test_solid_cache_pass(refname, "7zip:solid-cache=1m");
+	test_solid_cache_pass(refname, "7zip:solid-cache=1m");
+	archive_solid_cache_stats(NULL, &used, &hits2);
+	failure("The second pass should be served from the cache");
+	assert(hits2 > hits);
+	assert(used > 0);
+	test_extract_last_file(refname);
+
+	/* Turning the cache off for one handle leaves the others alone. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_7zip(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_set_options(a, "7zip:solid-cache=0"));
+	archive_solid_cache_stats(NULL, &used2, &hits);
+	assertEqualInt(used, used2);
+	test_solid_cache_pass(refname, "7zip:solid-cache=1m");
+	archive_solid_cache_stats(NULL, NULL, &hits2);
+	assert(hits2 > hits);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* Handles without the cache, or with a limit below the size of
+	 * the folder, don't look it up. */
+	test_solid_cache_pass(refname, "7zip:!solid-cache");
+	test_solid_cache_pass(refname, "7zip:solid-cache=16");
+	archive_solid_cache_stats(NULL, NULL, &hits);
+	assertEqualInt(hits2, hits);
+
+	/* Sizes that don't fit in 64 bits are rejected. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_7zip(a));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_set_options(a, "7zip:solid-cache=99999999999999G"));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_set_options(a, "7zip:solid-cache=18014398509481984k"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_set_options(a, "7zip:solid-cache=16777215g"));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* A limit of zero empties the shared cache. */
+	assertEqualInt(ARCHIVE_FAILED, archive_solid_cache_set_limit(-1));
+	assertEqualInt(ARCHIVE_OK, archive_solid_cache_set_limit(0));
+	archive_solid_cache_stats(NULL, &used, NULL);
+	assertEqualInt(0, used);
+	assertEqualInt(ARCHIVE_OK, archive_solid_cache_set_limit(limit));
+}
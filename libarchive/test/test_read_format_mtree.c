@@ -808,6 +808,10 @@ DEFINE_TEST(test_read_format_mtree_noprint)
 	assertEqualIntA(a, ARCHIVE_OK,
 	    archive_read_open_filename(a, reffile, 11));
 
+	/* Entries are returned as they are read, up to the bad line. */
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("dir_ok", archive_entry_pathname(ae));
+	assertEqualInt(AE_IFDIR, archive_entry_filetype(ae));
 	assertEqualIntA(a, ARCHIVE_FATAL, archive_read_next_header(a, &ae));
 	assertEqualString("Can't parse line 3", archive_error_string(a));
 
@@ -815,6 +819,54 @@ DEFINE_TEST(test_read_format_mtree_noprint)
 	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
 }
 
+/*
+ * Global options are applied in the order they were set, and keywords
+ * on an entry's line from the last one back, so that of two aliases
+ * the last global one and the first one on a line win.
+ */
+DEFINE_TEST(test_read_format_mtree_alias_order)
+{
+	static char archive[] =
+	    "#mtree\n"
+	    "/set type=file"
+	    " sha256=aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+	    " sha256digest=bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb\n"
+	    "a\n"
+	    "/set sha256=cccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccc\n"
+	    "b\n"
+	    "c sha256=dddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddd"
+	    " sha256digest=eeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeee\n";
+	struct archive_entry *ae;
+	struct archive *a;
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_memory(a, archive, sizeof(archive)));
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString(archive_entry_pathname(ae), "a");
+	assertMemoryFilledWith(archive_entry_digest(ae,
+	    ARCHIVE_ENTRY_DIGEST_SHA256), 32, 0xbb);
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString(archive_entry_pathname(ae), "b");
+	assertMemoryFilledWith(archive_entry_digest(ae,
+	    ARCHIVE_ENTRY_DIGEST_SHA256), 32, 0xcc);
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString(archive_entry_pathname(ae), "c");
+	assertMemoryFilledWith(archive_entry_digest(ae,
+	    ARCHIVE_ENTRY_DIGEST_SHA256), 32, 0xdd);
+
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualInt(ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+}
+
 /*
  * Check mtree file with tab characters, which are supported but not printable
  */
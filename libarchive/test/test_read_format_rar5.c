@@ -29,6 +29,7 @@
 #define __LIBARCHIVE_BUILD
 #include <archive_crc32.h>
 #include <archive_endian.h>
+#include <archive_digest_private.h>
 
 #define PROLOGUE(reffile) \
 	struct archive_entry *ae; \
@@ -254,6 +255,110 @@ DEFINE_TEST(test_read_format_rar5_multiple_files_solid)
 	EPILOGUE();
 }
 
+/* Skip to a member of a solid archive using the shared solid cache. The
+ * first pass stores the decoder state after each member, the following
+ * passes restore it instead of unpacking the skipped members again. */
+
+static void
+solid_cache_pass(const char* options, int read_second)
+{
+	const char* reffile = "test_read_format_rar5_multiple_files_solid.rar";
+	const int DATA_SIZE = 4096;
+	uint8_t buff[4096];
+	struct archive_entry *ae;
+	struct archive *a;
+
+	extract_reference_file(reffile);
+	assert((a = archive_read_new()) != NULL);
+	assertA(0 == archive_read_support_filter_all(a));
+	assertA(0 == archive_read_support_format_all(a));
+	assertA(0 == archive_read_set_options(a, options));
+	assertA(0 == archive_read_open_filename(a, reffile, 10240));
+
+	assertA(0 == archive_read_next_header(a, &ae));
+	assertEqualString("test1.bin", archive_entry_pathname(ae));
+	assertA(0 == archive_read_next_header(a, &ae));
+	assertEqualString("test2.bin", archive_entry_pathname(ae));
+	if(read_second) {
+		assertA(DATA_SIZE == archive_read_data(a, buff, DATA_SIZE));
+		assertA(1 == verify_data(buff, 2, DATA_SIZE));
+	}
+	assertA(0 == archive_read_next_header(a, &ae));
+	assertEqualString("test3.bin", archive_entry_pathname(ae));
+	assertA(0 == archive_read_next_header(a, &ae));
+	assertEqualString("test4.bin", archive_entry_pathname(ae));
+	assertA(DATA_SIZE == archive_read_data(a, buff, DATA_SIZE));
+	assertA(1 == verify_data(buff, 4, DATA_SIZE));
+
+	assertA(ARCHIVE_EOF == archive_read_next_header(a, &ae));
+	EPILOGUE();
+}
+
+static int
+can_sha256(void)
+{
+	archive_sha256_ctx ctx;
+	unsigned char md[32];
+
+	if (ARCHIVE_OK != archive_sha256_init(&ctx))
+		return 0;
+	archive_sha256_final(&ctx, md);
+	return 1;
+}
+
+DEFINE_TEST(test_read_format_rar5_solid_cache)
+{
+	struct archive *a;
+	la_int64_t limit, used, used2, hits, hits2;
+
+	if(!can_sha256()) {
+		/* The cache is not used, but reading must still work. */
+		skipping("The solid cache requires SHA256 support");
+		solid_cache_pass("rar5:solid-cache=16m", 0);
+		return;
+	}
+
+	archive_solid_cache_stats(&limit, NULL, &hits);
+	solid_cache_pass("rar5:solid-cache=16m", 0);
+	solid_cache_pass("rar5:solid-cache=16m", 0);
+	archive_solid_cache_stats(NULL, &used, &hits2);
+	failure("The second pass should skip members through the cache");
+	assert(hits2 > hits);
+	assert(used > 0);
+	solid_cache_pass("rar5:solid-cache=16m", 1);
+	solid_cache_pass("rar5:solid-cache=16m", 0);
+
+	/* Turning the cache off for one handle leaves the others alone. */
+	assert((a = archive_read_new()) != NULL);
+	assertA(0 == archive_read_support_format_rar5(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_set_options(a, "rar5:solid-cache=0"));
+	archive_solid_cache_stats(NULL, &used2, &hits);
+	assertEqualInt(used, used2);
+	solid_cache_pass("rar5:solid-cache=16m", 0);
+	archive_solid_cache_stats(NULL, NULL, &hits2);
+	assert(hits2 > hits);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* A handle without the cache doesn't look it up. */
+	solid_cache_pass("rar5:!solid-cache", 0);
+	archive_solid_cache_stats(NULL, NULL, &hits);
+	assertEqualInt(hits2, hits);
+
+	/* Sizes that don't fit in 64 bits are rejected. */
+	assert((a = archive_read_new()) != NULL);
+	assertA(0 == archive_read_support_format_rar5(a));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_set_options(a, "rar5:solid-cache=99999999999999G"));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* A limit of zero empties the shared cache. */
+	assertEqualInt(ARCHIVE_OK, archive_solid_cache_set_limit(0));
+	archive_solid_cache_stats(NULL, &used, NULL);
+	assertEqualInt(0, used);
+	assertEqualInt(ARCHIVE_OK, archive_solid_cache_set_limit(limit));
+}
+
 DEFINE_TEST(test_read_format_rar5_multiarchive_skip_all)
 {
 	const char* reffiles[] = {
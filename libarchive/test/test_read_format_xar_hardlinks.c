@@ -0,0 +1,107 @@
+/*-
+ * Copyright (c) 2026 The libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Write enough hardlink groups that the reader has to grow its
+ * hardlink table several times, then verify every link is resolved
+ * to its original.
+ */
+#define GROUPS	600
+
+DEFINE_TEST(test_read_format_xar_hardlinks)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char name[32], target[32];
+	char *buff;
+	size_t buffsize = 4 * 1024 * 1024;
+	size_t used;
+	int i, links, originals;
+
+	/* Create a new archive in memory. */
+	assert((a = archive_write_new()) != NULL);
+	if (archive_write_set_format_xar(a) != ARCHIVE_OK) {
+		skipping("xar is not supported on this platform");
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_free(a));
+		return;
+	}
+	assert((buff = malloc(buffsize)) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+
+	assert((ae = archive_entry_new()) != NULL);
+	for (i = 0; i < GROUPS; i++) {
+		snprintf(name, sizeof(name), "file%d", i);
+		archive_entry_clear(ae);
+		archive_entry_copy_pathname(ae, name);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, 4);
+		archive_entry_set_nlink(ae, 2);
+		archive_entry_set_ino(ae, i + 1);
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		assertEqualIntA(a, 4, archive_write_data(a, "abcd", 4));
+
+		snprintf(name, sizeof(name), "link%d", i);
+		snprintf(target, sizeof(target), "file%d", i);
+		archive_entry_clear(ae);
+		archive_entry_copy_pathname(ae, name);
+		archive_entry_copy_hardlink(ae, target);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, 0);
+		archive_entry_set_nlink(ae, 2);
+		archive_entry_set_ino(ae, i + 1);
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	}
+	archive_entry_free(ae);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_free(a));
+
+	/* Read it back; every link must name its own original. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_xar(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	links = originals = 0;
+	while (archive_read_next_header(a, &ae) == ARCHIVE_OK) {
+		const char *p = archive_entry_pathname(ae);
+
+		assertEqualInt(2, archive_entry_nlink(ae));
+		if (strncmp(p, "link", 4) == 0) {
+			snprintf(target, sizeof(target), "file%s", p + 4);
+			assertEqualString(target, archive_entry_hardlink(ae));
+			links++;
+		} else {
+			assert(archive_entry_hardlink(ae) == NULL);
+			originals++;
+		}
+	}
+	assertEqualInt(GROUPS, links);
+	assertEqualInt(GROUPS, originals);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_close(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+	free(buff);
+}
@@ -474,6 +474,62 @@ verify_sparse_file2(struct archive *a, const char *path,
 	archive_entry_free(ae);
 }
 
+/*
+ * ARCHIVE_READDISK_NO_SPARSE_SYNC only drops the FIEMAP sync; the
+ * sparse map must be the same as without it.  The file is created
+ * afresh and read without the sync first, so that nothing has flushed
+ * it yet.
+ */
+static void
+verify_sparse_file_nosync(const char *path, const struct sparse *sparse,
+    int blocks)
+{
+	struct archive *a;
+	struct archive_entry *ae, *ae_sync;
+	la_int64_t offset, length, offset_sync, length_sync;
+	int i;
+
+	create_sparse_file(path, sparse);
+
+	assert((a = archive_read_disk_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_disk_set_behavior(a,
+		ARCHIVE_READDISK_NO_SPARSE_SYNC));
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_set_pathname(ae, path);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_disk_entry_from_file(a, ae, -1, NULL));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	assert((a = archive_read_disk_new()) != NULL);
+	assert((ae_sync = archive_entry_new()) != NULL);
+	archive_entry_set_pathname(ae_sync, path);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_disk_entry_from_file(a, ae_sync, -1, NULL));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	failure("%s", path);
+	assertEqualInt(blocks, archive_entry_sparse_count(ae));
+	failure("%s", path);
+	assertEqualInt(archive_entry_sparse_count(ae_sync),
+	    archive_entry_sparse_count(ae));
+	archive_entry_sparse_reset(ae);
+	archive_entry_sparse_reset(ae_sync);
+	for (i = 0; i < archive_entry_sparse_count(ae); i++) {
+		if (!assertEqualInt(ARCHIVE_OK,
+		    archive_entry_sparse_next(ae_sync, &offset_sync,
+		    &length_sync)))
+			break;
+		assertEqualInt(ARCHIVE_OK,
+		    archive_entry_sparse_next(ae, &offset, &length));
+		failure("%s: block %d", path, i);
+		assertEqualInt(offset_sync, offset);
+		failure("%s: block %d", path, i);
+		assertEqualInt(length_sync, length);
+	}
+	archive_entry_free(ae);
+	archive_entry_free(ae_sync);
+}
+
 static void
 test_sparse_whole_file_data(void)
 {
@@ -645,6 +701,16 @@ DEFINE_TEST(test_sparse_basic)
 	verify_sparse_file2(a, "file0", sparse_file0, 0, 1);
 
 	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/*
+	 * Test that setting ARCHIVE_READDISK_NO_SPARSE_SYNC
+	 * yields the same sparse map.
+	 */
+	verify_sparse_file_nosync("nosync0", sparse_file0, 5);
+	verify_sparse_file_nosync("nosync2", sparse_file2, 20);
+	verify_sparse_file_nosync("nosync3", sparse_file3, 0);
+	verify_sparse_file_nosync("nosync4", sparse_file4, 2);
+
 	free(cwd);
 }
 
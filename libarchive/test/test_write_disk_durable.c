@@ -0,0 +1,189 @@
+/*-
+ * Copyright (c) 2026 The libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+static void
+write_file(struct archive *ad, const char *name, const char *data)
+{
+	struct archive_entry *ae;
+
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, name);
+	archive_entry_set_mode(ae, S_IFREG | 0644);
+	archive_entry_set_size(ae, strlen(data));
+	assertEqualIntA(ad, ARCHIVE_OK, archive_write_header(ad, ae));
+	assertEqualInt(strlen(data), archive_write_data(ad, data, strlen(data)));
+	assertEqualIntA(ad, ARCHIVE_OK, archive_write_finish_entry(ad));
+	archive_entry_free(ae);
+}
+
+#if !defined(_WIN32) || defined(__CYGWIN__)
+/* Temporary files are named after their target plus a random suffix;
+ * none of the names extracted here has a dot in it. */
+static void
+check_no_temporary_files(const char *dirname)
+{
+	struct dirent *de;
+	DIR *d;
+
+	assert((d = opendir(dirname)) != NULL);
+	if (d == NULL)
+		return;
+	while ((de = readdir(d)) != NULL) {
+		if (strcmp(de->d_name, ".") == 0 ||
+		    strcmp(de->d_name, "..") == 0)
+			continue;
+		failure("Leftover file %s/%s", dirname, de->d_name);
+		assert(strchr(de->d_name, '.') == NULL);
+	}
+	closedir(d);
+}
+#endif
+
+/*
+ * Extract with ARCHIVE_EXTRACT_DURABLE: files show up under their
+ * names only once their batch is flushed, entries that replace or
+ * hard link a queued file still see it, and no temporary files are
+ * left behind.
+ */
+DEFINE_TEST(test_write_disk_durable)
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+	skipping("ARCHIVE_EXTRACT_DURABLE batching is not implemented on Windows");
+#else
+	struct archive *ad;
+	struct archive_entry *ae;
+	char buff[32];
+	int i;
+
+	assertUmask(022);
+	assertMakeDir("durable", 0755);
+	assertChdir("durable");
+	assertMakeFile("old", 0644, "previous contents");
+
+	assert((ad = archive_write_disk_new()) != NULL);
+	assertEqualIntA(ad, ARCHIVE_OK,
+	    archive_write_disk_set_options(ad, ARCHIVE_EXTRACT_DURABLE));
+	assertEqualIntA(ad, ARCHIVE_OK,
+	    archive_write_disk_set_durable_batch(ad, 4, 1024 * 1024));
+
+	/* The first three files wait for the batch to fill up. */
+	for (i = 0; i < 3; i++) {
+		snprintf(buff, sizeof(buff), "f%d", i);
+		write_file(ad, buff, buff);
+	}
+	assertFileNotExists("f0");
+	assertFileNotExists("f2");
+
+	/* Replacing a queued file flushes the batch first. */
+	write_file(ad, "f1", "replaced");
+	assertFileContents("f0", 2, "f0");
+	assertFileContents("f2", 2, "f2");
+
+	/* A hard link to a queued file flushes the batch too. */
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "link");
+	archive_entry_copy_hardlink(ae, "f1");
+	archive_entry_set_mode(ae, S_IFREG | 0644);
+	archive_entry_set_size(ae, 0);
+	assertEqualIntA(ad, ARCHIVE_OK, archive_write_header(ad, ae));
+	assertEqualIntA(ad, ARCHIVE_OK, archive_write_finish_entry(ad));
+	archive_entry_free(ae);
+	assertFileContents("replaced", 8, "f1");
+
+	/* Existing files are replaced, and directories are not queued. */
+	write_file(ad, "old", "new contents");
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "dir");
+	archive_entry_set_mode(ae, S_IFDIR | 0755);
+	assertEqualIntA(ad, ARCHIVE_OK, archive_write_header(ad, ae));
+	assertEqualIntA(ad, ARCHIVE_OK, archive_write_finish_entry(ad));
+	archive_entry_free(ae);
+	assertIsDir("dir", -1);
+	write_file(ad, "dir/f3", "f3");
+
+	/* A hard link to a file that isn't queued leaves the batch alone. */
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "link2");
+	archive_entry_copy_hardlink(ae, "f0");
+	archive_entry_set_mode(ae, S_IFREG | 0644);
+	archive_entry_set_size(ae, 0);
+	assertEqualIntA(ad, ARCHIVE_OK, archive_write_header(ad, ae));
+	assertEqualIntA(ad, ARCHIVE_OK, archive_write_finish_entry(ad));
+	archive_entry_free(ae);
+	assertFileNotExists("dir/f3");
+	assertIsHardlink("f0", "link2");
+
+	/* Reaching the batch size flushes it. */
+	write_file(ad, "f4", "f4");
+	write_file(ad, "f5", "f5");
+	assertFileContents("new contents", 12, "old");
+	assertFileContents("f5", 2, "f5");
+
+	/* Closing flushes whatever is left. */
+	write_file(ad, "f6", "f6");
+	write_file(ad, "f7", "f7");
+	assertFileNotExists("f6");
+	assertFileNotExists("f7");
+	assertEqualIntA(ad, ARCHIVE_OK, archive_write_close(ad));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(ad));
+
+	assertFileContents("f7", 2, "f7");
+	assertFileContents("f3", 2, "dir/f3");
+	assertIsHardlink("f1", "link");
+	assertFileMode("f0", 0644);
+
+	/* Everything is in place and no temporary file is left over. */
+	for (i = 0; i < 8; i++) {
+		snprintf(buff, sizeof(buff), "f%d", i);
+		if (i == 3)
+			assertFileNotExists(buff);
+		else
+			assertFileExists(buff);
+	}
+	assertFileExists("old");
+	assertFileExists("link");
+	assertFileExists("dir/f3");
+	check_no_temporary_files(".");
+	check_no_temporary_files("dir");
+
+	/*
+	 * A file that can't be renamed into place is lost; the flush
+	 * fails and names it.
+	 */
+	assert((ad = archive_write_disk_new()) != NULL);
+	assertEqualIntA(ad, ARCHIVE_OK,
+	    archive_write_disk_set_options(ad, ARCHIVE_EXTRACT_DURABLE));
+	write_file(ad, "blocked", "blocked");
+	assertMakeDir("blocked", 0755);
+	assertMakeFile("blocked/keep", 0644, "keep");
+	assertEqualIntA(ad, ARCHIVE_FAILED, archive_write_close(ad));
+	assert(strstr(archive_error_string(ad), "blocked") != NULL);
+	assertEqualInt(ARCHIVE_OK, archive_write_free(ad));
+	assertIsDir("blocked", -1);
+	check_no_temporary_files(".");
+	assertChdir("..");
+#endif
+}
@@ -127,6 +127,27 @@ DEFINE_TEST(test_write_disk_lookup)
 		assertEqualInt(8, id);
 #else
 		assertEqualInt(0, id);
+
+		/* Unknown names are cached, but still map to the
+		 * id the caller provided. */
+		assertEqualInt(8,
+		    archive_write_disk_uid(a, "no such user", 8));
+		assertEqualInt(9,
+		    archive_write_disk_uid(a, "no such user", 9));
+		assertEqualInt(0, archive_write_disk_uid(a, "root", 8));
+
+		/* The shared cache can be shrunk or turned off. */
+		assertEqualInt(ARCHIVE_FAILED,
+		    archive_name_cache_set_limits(16, -1));
+		assertEqualInt(ARCHIVE_OK, archive_name_cache_set_limits(1, 1));
+		assertEqualInt(0, archive_write_disk_uid(a, "root", 8));
+		assertEqualInt(8,
+		    archive_write_disk_uid(a, "no such user", 8));
+		assertEqualInt(0, archive_write_disk_uid(a, "root", 8));
+		assertEqualInt(ARCHIVE_OK, archive_name_cache_set_limits(0, 0));
+		assertEqualInt(0, archive_write_disk_uid(a, "root", 8));
+		assertEqualInt(ARCHIVE_OK,
+		    archive_name_cache_set_limits(4096, 600));
 #endif
 	}
 
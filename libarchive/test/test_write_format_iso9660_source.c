@@ -0,0 +1,219 @@
+/*-
+ * Copyright (c) 2026 The libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Check that the "source-files" option reads file contents from
+ * their source paths when the image is written.
+ */
+
+static void
+add_file(struct archive *a, const char *name, const char *source,
+    const char *data, size_t size)
+{
+	struct archive_entry *ae;
+
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, name);
+	if (source != NULL)
+		archive_entry_copy_sourcepath(ae, source);
+	archive_entry_set_mode(ae, S_IFREG | 0644);
+	archive_entry_set_mtime(ae, 1, 0);
+	archive_entry_set_size(ae, size);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	/* Data handed to a file read from its source is ignored. */
+	if (data != NULL)
+		assertEqualIntA(a, size, archive_write_data(a, data, size));
+}
+
+struct expect {
+	const char	*name;
+	const char	*data;
+	size_t		 size;
+	size_t		 skip;
+	int		 found;
+};
+
+static void
+verify_file(struct archive *a, struct archive_entry *ae, struct expect *e)
+{
+	char *buff;
+
+	buff = malloc(e->size + 1);
+	assert(buff != NULL);
+	failure("%s", e->name);
+	assertEqualInt(e->size, archive_entry_size(ae));
+	failure("%s", e->name);
+	assertEqualIntA(a, e->size, archive_read_data(a, buff, e->size + 1));
+	failure("%s", e->name);
+	assertEqualMem(buff + e->skip, e->data + e->skip, e->size - e->skip);
+	free(buff);
+	e->found++;
+}
+
+DEFINE_TEST(test_write_format_iso9660_source)
+{
+	struct archive *a;
+	struct archive_entry *ae;
+	char *big, *boot, *buff;
+	size_t buffsize = 200 * 2048;
+	size_t used, i;
+	int r;
+
+	big = malloc(100000);
+	boot = malloc(10 * 1024);
+	buff = malloc(buffsize);
+	assert(big != NULL && boot != NULL && buff != NULL);
+	for (i = 0; i < 100000; i++)
+		big[i] = (char)(i * 7 + i / 1000);
+	for (i = 0; i < 10 * 1024; i++)
+		boot[i] = (char)(i * 13);
+	assertMakeFile("small", 0644, "source contents");
+	assertMakeBinFile("big", 0644, 100000, big);
+	assertMakeBinFile("boot.img", 0644, 10 * 1024, boot);
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_iso9660(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_option(a, NULL, "source-files", "1"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_option(a, NULL, "boot", "boot.img"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_option(a, NULL, "boot-info-table", "1"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_option(a, NULL, "pad", NULL));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	add_file(a, "boot.img", "boot.img", NULL, 10 * 1024);
+	add_file(a, "file1", "small", "SOURCE CONTENTS", 15);
+	/* Without a source path the data goes to the temporary file. */
+	add_file(a, "file2", NULL, "temporary", 9);
+	add_file(a, "file3", "big", NULL, 100000);
+	/* A source whose size does not match is not used either. */
+	add_file(a, "file4", "small", "mismatch", 8);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_free(a));
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_memory(a, buff, used));
+	{
+		struct expect files[] = {
+			/* The boot-info-table takes bytes 8 through 63. */
+			{ "boot.img", boot, 10 * 1024, 64, 0 },
+			{ "file1", "source contents", 15, 0, 0 },
+			{ "file2", "temporary", 9, 0, 0 },
+			{ "file3", big, 100000, 0, 0 },
+			{ "file4", "mismatch", 8, 0, 0 },
+		};
+
+		while ((r = archive_read_next_header(a, &ae)) == ARCHIVE_OK) {
+			for (i = 0; i < sizeof(files)/sizeof(files[0]); i++)
+				if (strcmp(files[i].name,
+				    archive_entry_pathname(ae)) == 0)
+					verify_file(a, ae, &files[i]);
+		}
+		assertEqualIntA(a, ARCHIVE_EOF, r);
+		for (i = 0; i < sizeof(files)/sizeof(files[0]); i++) {
+			failure("%s", files[i].name);
+			assertEqualInt(1, files[i].found);
+		}
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+
+	free(big);
+	free(boot);
+	free(buff);
+}
+
+/*
+ * A relative source path is resolved when the header is written, so
+ * changing the current directory before the image is written does
+ * not matter, but a source that changes in the meantime is an error.
+ */
+DEFINE_TEST(test_write_format_iso9660_source_changed)
+{
+	struct archive *a;
+	struct archive_entry *ae;
+	char *buff;
+	size_t buffsize = 200 * 2048;
+	size_t used;
+	char data[16];
+
+	buff = malloc(buffsize);
+	assert(buff != NULL);
+	assertMakeFile("stay", 0644, "source contents");
+	assertMakeFile("change", 0644, "source contents");
+	assertMakeDir("elsewhere", 0755);
+
+	/* Change the current directory before closing. */
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_iso9660(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_option(a, NULL, "source-files", "1"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	add_file(a, "file1", "stay", NULL, 15);
+	assertChdir("elsewhere");
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_free(a));
+	assertChdir("..");
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_memory(a, buff, used));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString(".", archive_entry_pathname(ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("file1", archive_entry_pathname(ae));
+	assertEqualIntA(a, 15, archive_read_data(a, data, sizeof(data)));
+	assertEqualMem(data, "source contents", 15);
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+
+	/* Change the size of the source before closing. */
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_iso9660(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_option(a, NULL, "source-files", "1"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	add_file(a, "file1", "change", NULL, 15);
+	assertMakeFile("change", 0644, "source contents, grown");
+	assertEqualIntA(a, ARCHIVE_FATAL, archive_write_close(a));
+	assert(strstr(archive_error_string(a),
+	    "/change'' has changed since its header was written") != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_free(a));
+
+	free(buff);
+}
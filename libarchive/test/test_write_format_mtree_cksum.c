@@ -0,0 +1,89 @@
+/*-
+ * Copyright (c) 2026 The libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test.h"
+
+/*
+ * Check the POSIX cksum values written by the mtree writer against
+ * those of cksum(1), including data written in uneven pieces.
+ */
+
+static char buff[4096];
+static struct {
+	const char	*path;
+	size_t		 size;
+	const char	*cksum;
+} entries[] = {
+	{ "./f0",	0,	"cksum=4294967295" },
+	{ "./f1",	1,	"cksum=2312486299" },
+	{ "./f7",	7,	"cksum=2683505172" },
+	{ "./f8",	8,	"cksum=1002360118" },
+	{ "./f9",	9,	"cksum=2425606739" },
+	{ "./f64",	64,	"cksum=2491981790" },
+	{ "./f1000",	1000,	"cksum=3299097258" },
+	{ NULL, 0, NULL }
+};
+
+DEFINE_TEST(test_write_format_mtree_cksum)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char data[1000], line[64];
+	size_t used, i, off, n;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = (char)(i * 7 + 3);
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_mtree(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_options(a, "!all,cksum"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, sizeof(buff)-1, &used));
+	for (i = 0; entries[i].path != NULL; i++) {
+		assert((ae = archive_entry_new()) != NULL);
+		archive_entry_copy_pathname(ae, entries[i].path);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, entries[i].size);
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		archive_entry_free(ae);
+		/* Write in pieces that straddle eight-byte boundaries. */
+		for (off = 0, n = 3; off < entries[i].size; off += n, n += 5) {
+			if (n > entries[i].size - off)
+				n = entries[i].size - off;
+			assertEqualIntA(a, (int)n,
+			    (int)archive_write_data(a, data + off, n));
+		}
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	buff[used] = '\0';
+
+	for (i = 0; entries[i].path != NULL; i++) {
+		snprintf(line, sizeof(line), "\n%s %s\n", entries[i].path,
+		    entries[i].cksum);
+		assert(strstr(buff, line) != NULL);
+	}
+}
@@ -0,0 +1,102 @@
+/*-
+ * Copyright (c) 2026 The libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test.h"
+
+/*
+ * Check that the sums computed on threads are the same as those
+ * computed by the writing thread alone.
+ */
+
+static const size_t sizes[] = { 0, 100, 16 * 1024 - 1, 16 * 1024,
+    200000, 1000000 };
+
+static size_t
+write_mtree(const char *options, const char *data, char *buff, size_t size)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char path[16];
+	size_t used, i, off, n;
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_mtree(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_options(a,
+	    "!all,cksum,md5,rmd160,sha1,sha256,sha384,sha512"));
+	if (options != NULL)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_set_options(a, options));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, size, &used));
+	for (i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+		assert((ae = archive_entry_new()) != NULL);
+		snprintf(path, sizeof(path), "./f%d", (int)i);
+		archive_entry_copy_pathname(ae, path);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, sizes[i]);
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		archive_entry_free(ae);
+		/* Both small pieces and ones large enough to share out. */
+		for (off = 0, n = 1000; off < sizes[i]; off += n, n *= 3) {
+			if (n > sizes[i] - off)
+				n = sizes[i] - off;
+			assertEqualIntA(a, (int)n,
+			    (int)archive_write_data(a, data + off, n));
+		}
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_free(a));
+	return (used);
+}
+
+DEFINE_TEST(test_write_format_mtree_threads)
+{
+	char *data, *serial, *threaded;
+	size_t size = 64 * 1024, used, tused, i;
+	static const char *options[] = {
+		"threads=2", "threads=4", "threads=16", "threads=0"
+	};
+
+	data = malloc(1000000);
+	serial = malloc(size);
+	threaded = malloc(size);
+	assert(data != NULL && serial != NULL && threaded != NULL);
+	for (i = 0; i < 1000000; i++)
+		data[i] = (char)(i * 7 + i / 4099);
+
+	used = write_mtree(NULL, data, serial, size);
+	assert(used > 0);
+	for (i = 0; i < sizeof(options)/sizeof(options[0]); i++) {
+		tused = write_mtree(options[i], data, threaded, size);
+		failure("%s", options[i]);
+		assertEqualMem(threaded, serial, used);
+		failure("%s", options[i]);
+		assertEqualInt(tused, used);
+	}
+
+	free(data);
+	free(serial);
+	free(threaded);
+}
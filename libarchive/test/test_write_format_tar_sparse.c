@@ -25,6 +25,8 @@
  */
 #include "test.h"
 
+#include <locale.h>
+
 static char buff[1000000];
 
 static void
@@ -295,10 +297,278 @@ test_2(void)
 	free(buff2);
 }
 
+/* Sparse entries are returned one block at a time. */
+static size_t
+read_all(struct archive *a, char *p, size_t size)
+{
+	size_t total = 0;
+	la_ssize_t bytes;
+
+	while (total < size &&
+	    (bytes = archive_read_data(a, p + total, size - total)) > 0)
+		total += bytes;
+	return (total);
+}
+
+/*
+ * Test for the "detect-sparse" option, which turns runs of zero
+ * blocks in the body of a dense entry into holes.
+ */
+static void
+test_3(void)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	size_t used;
+	int64_t offset, length;
+	char *data, *buff2;
+	size_t data_size = 0x81000;
+	size_t chunk = 0x1234;
+	size_t i;
+
+	assert((data = calloc(1, data_size)) != NULL);
+	assert((buff2 = malloc(data_size)) != NULL);
+	memset(data + 0x10000, 'a', 0x1000);
+	memset(data + 0x80000, 'a', 0x1000);
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_pax(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_format_option(a, "pax", "detect-sparse", "1"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, sizeof(buff), &used));
+
+	/* A file with two data blocks written in odd-sized pieces. */
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "file");
+	archive_entry_set_mode(ae, S_IFREG | 0644);
+	archive_entry_set_size(ae, data_size);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	for (i = 0; i < data_size; i += chunk) {
+		size_t ws = chunk;
+		if (i + ws > data_size)
+			ws = data_size - i;
+		assertEqualInt(ws, archive_write_data(a, data + i, ws));
+	}
+
+	/* A file without zero blocks is stored as usual. */
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "dense");
+	archive_entry_set_mode(ae, S_IFREG | 0644);
+	archive_entry_set_size(ae, 0x3000);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	for (i = 0; i < 3; i++)
+		assertEqualInt(0x1000,
+		    archive_write_data(a, data + 0x10000, 0x1000));
+	/* Data beyond the declared size is not taken. */
+	assertEqualInt(0, archive_write_data(a, data + 0x10000, 0x1000));
+
+	/* A short body leaves a trailing hole. */
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "short");
+	archive_entry_set_mode(ae, S_IFREG | 0644);
+	archive_entry_set_size(ae, 0x20000);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	assertEqualInt(0x1000, archive_write_data(a, data + 0x10000, 0x1000));
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	/* Only the non-zero blocks take space in the archive. */
+	failure("used=%zu", used);
+	assert(used < 0x10000);
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("file", archive_entry_pathname(ae));
+	assertEqualInt(data_size, archive_entry_size(ae));
+	assertEqualInt(2, archive_entry_sparse_reset(ae));
+	assertEqualInt(0, archive_entry_sparse_next(ae, &offset, &length));
+	assertEqualInt(0x10000, offset);
+	assertEqualInt(0x1000, length);
+	assertEqualInt(0, archive_entry_sparse_next(ae, &offset, &length));
+	assertEqualInt(0x80000, offset);
+	assertEqualInt(0x1000, length);
+	assertEqualInt(data_size, read_all(a, buff2, data_size));
+	assertEqualMem(buff2, data, data_size);
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("dense", archive_entry_pathname(ae));
+	assertEqualInt(0x3000, archive_entry_size(ae));
+	assertEqualInt(0, archive_entry_sparse_count(ae));
+	assertEqualInt(0x3000, read_all(a, buff2, 0x3000));
+	for (i = 0; i < 0x3000; i++)
+		if (buff2[i] != 'a')
+			break;
+	assertEqualInt(0x3000, i);
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("short", archive_entry_pathname(ae));
+	assertEqualInt(0x20000, archive_entry_size(ae));
+	assertEqualInt(2, archive_entry_sparse_reset(ae));
+	assertEqualInt(0, archive_entry_sparse_next(ae, &offset, &length));
+	assertEqualInt(0, offset);
+	assertEqualInt(0x1000, length);
+	assertEqualInt(0, archive_entry_sparse_next(ae, &offset, &length));
+	assertEqualInt(0x20000, offset);
+	assertEqualInt(0, length);
+	assertEqualInt(0x20000, read_all(a, buff2, 0x20000));
+	assertEqualMem(buff2, data + 0x10000, 0x1000);
+	assertEqualMem(buff2 + 0x1000, data + 0x11000, 0x1f000);
+
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(buff2);
+	free(data);
+}
+
+/*
+ * With "detect-sparse" the header is written when the entry is
+ * finished, but a problem with it is still reported by
+ * archive_write_header() for that entry, not for the next one.
+ */
+static void
+test_4(void)
+{
+	/* \374 is invalid in UTF-8. */
+	char badname[] = "abc\314\214mno\374xyz";
+	struct archive_entry *ae;
+	struct archive *a;
+	size_t used;
+	char *data;
+	size_t data_size = 0x3000;
+
+	if (setlocale(LC_ALL, "en_US.UTF-8") == NULL &&
+	    setlocale(LC_ALL, "C.UTF-8") == NULL) {
+		skipping("invalid encoding tests require a suitable locale;"
+		    " en_US.UTF-8 not available on this system");
+		return;
+	}
+	assert((data = calloc(1, data_size)) != NULL);
+	memset(data, 'a', 0x1000);
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_pax(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_format_option(a, "pax", "detect-sparse", "1"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, sizeof(buff), &used));
+
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, badname);
+	archive_entry_set_mode(ae, S_IFREG | 0644);
+	archive_entry_set_size(ae, data_size);
+	failure("The untranslatable name is reported for its own entry");
+	assertEqualIntA(a, ARCHIVE_WARN, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	assertEqualInt(data_size, archive_write_data(a, data, data_size));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_finish_entry(a));
+
+	/* The next entry is not blamed for it, and is written. */
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "next");
+	archive_entry_set_mode(ae, S_IFREG | 0644);
+	archive_entry_set_size(ae, data_size);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	assertEqualInt(data_size, archive_write_data(a, data, data_size));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString(badname, archive_entry_pathname(ae));
+	assertEqualInt(2, archive_entry_sparse_count(ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("next", archive_entry_pathname(ae));
+	assertEqualInt(2, archive_entry_sparse_count(ae));
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(data);
+}
+
+/*
+ * A file on disk with a block allocated for every byte is not
+ * scanned for holes, even if it holds zeros.
+ */
+static void
+test_5(void)
+{
+#ifdef HAVE_STRUCT_STAT_ST_BLOCKS
+	struct archive_entry *ae;
+	struct archive *a;
+	struct stat st;
+	size_t used;
+	char *data;
+	size_t data_size = 0x3000;
+	FILE *f;
+
+	assert((data = calloc(1, data_size)) != NULL);
+	assert((f = fopen("allocated", "wb")) != NULL);
+	assertEqualInt(data_size, fwrite(data, 1, data_size, f));
+	assertEqualInt(0, fclose(f));
+	assertEqualInt(0, stat("allocated", &st));
+	if (st.st_blocks < (st.st_size + 511) / 512) {
+		skipping("The file system did not allocate the zero blocks");
+		free(data);
+		return;
+	}
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_pax(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_format_option(a, "pax", "detect-sparse", "1"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, sizeof(buff), &used));
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "allocated");
+	archive_entry_copy_sourcepath(ae, "allocated");
+	archive_entry_set_mode(ae, S_IFREG | 0644);
+	archive_entry_set_size(ae, data_size);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	assertEqualInt(data_size, archive_write_data(a, data, data_size));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	/* The zeros are stored as data. */
+	assert(used > data_size);
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("allocated", archive_entry_pathname(ae));
+	assertEqualInt(0, archive_entry_sparse_count(ae));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(data);
+#else
+	skipping("st_blocks is not available on this platform");
+#endif
+}
+
 DEFINE_TEST(test_write_format_tar_sparse)
 {
 	/* Test1: archiving sparse files. */
 	test_1();
 	/* Test2: incompletely archiving sparse files. */
 	test_2();
+	/* Test3: detecting holes in dense files. */
+	test_3();
+	/* Test4: header warnings of a detect-sparse entry. */
+	test_4();
+	/* Test5: fully allocated files are not scanned. */
+	test_5();
 }
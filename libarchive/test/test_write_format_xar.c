@@ -311,4 +311,5 @@ DEFINE_TEST(test_write_format_xar)
 	test_xar("compression=xz");
 	test_xar("compression=xz,compression-level=1");
 	test_xar("compression=xz,compression-level=9");
+	test_xar("compression=xz,threads=2");
 }
@@ -0,0 +1,180 @@
+/*-
+ * Copyright (c) 2026 The libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Write a tar archive together with its index, then use the index
+ * to jump straight to members in the middle of the archive.
+ */
+
+#define	NMEMBERS	50
+
+static void
+write_archive(int (*set_format)(struct archive *), const char *name)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char path[128], data[64];
+	int i;
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, set_format(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_format_option(a, NULL, "index", "test.idx"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_open_filename(a, name));
+
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "dir/");
+	archive_entry_set_mode(ae, AE_IFDIR | 0755);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	for (i = 0; i < NMEMBERS; i++) {
+		snprintf(path, sizeof(path), "dir/file%d", i);
+		/* Long names force pax and GNU tar to add extra headers. */
+		if (i % 7 == 3)
+			snprintf(path, sizeof(path), "dir/%0100d", i);
+		snprintf(data, sizeof(data), "contents of member %d", i);
+		archive_entry_clear(ae);
+		archive_entry_copy_pathname(ae, path);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, strlen(data));
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		assertEqualInt(strlen(data),
+		    archive_write_data(a, data, strlen(data)));
+	}
+	/* A later member replaces an earlier one of the same name. */
+	archive_entry_clear(ae);
+	archive_entry_copy_pathname(ae, "dir/file10");
+	archive_entry_set_mode(ae, AE_IFREG | 0644);
+	archive_entry_set_size(ae, 7);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	assertEqualInt(7, archive_write_data(a, "updated", 7));
+	archive_entry_free(ae);
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+}
+
+static void
+seek_and_check(struct archive *a, const char *path, const char *data)
+{
+	struct archive_entry *ae;
+	char buff[128];
+	size_t len = strlen(data);
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_tar_seek_entry(a, path));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString(path, archive_entry_pathname(ae));
+	assertEqualInt(len, archive_entry_size(ae));
+	assertEqualInt(len, archive_read_data(a, buff, sizeof(buff)));
+	assertEqualMem(buff, data, len);
+}
+
+static void
+test_format(int (*set_format)(struct archive *))
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char path[128];
+
+	write_archive(set_format, "test.tar");
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_set_format_option(a, "tar", "index", "test.idx"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_filename(a, "test.tar", 10240));
+
+	seek_and_check(a, "dir/file42", "contents of member 42");
+	/* Seeking backwards, also from the middle of a member's data. */
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_tar_seek_entry(a, "dir/file5"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	seek_and_check(a, "dir/file10", "updated");
+	snprintf(path, sizeof(path), "dir/%0100d", 24);
+	seek_and_check(a, path, "contents of member 24");
+
+	/* Directories are found with or without the trailing slash. */
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_tar_seek_entry(a, "dir"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("dir/", archive_entry_pathname(ae));
+
+	/* Names that are not in the archive. */
+	assertEqualIntA(a, ARCHIVE_WARN,
+	    archive_read_tar_seek_entry(a, "dir/file99"));
+	assertEqualIntA(a, ARCHIVE_WARN,
+	    archive_read_tar_seek_entry(a, "file1"));
+
+	/* Reading on continues with the member after the one found. */
+	seek_and_check(a, "dir/file48", "contents of member 48");
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("dir/file49", archive_entry_pathname(ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("dir/file10", archive_entry_pathname(ae));
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+
+	/* A NULL name rewinds, even after the end of the archive. */
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_tar_seek_entry(a, NULL));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("dir/", archive_entry_pathname(ae));
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+}
+
+DEFINE_TEST(test_write_read_format_tar_index)
+{
+	struct archive *a;
+	static const char bad[] = "#tar-index 1\n512 1024 5\n";
+
+	test_format(archive_write_set_format_pax);
+	test_format(archive_write_set_format_pax_restricted);
+	test_format(archive_write_set_format_ustar);
+	test_format(archive_write_set_format_gnutar);
+
+	/* Without an index there is nothing to look up. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_filename(a, "test.tar", 10240));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_tar_seek_entry(a, "dir/file1"));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* Malformed index files are rejected. */
+	assertMakeFile("bad.idx", 0644, bad);
+	assertMakeFile("empty.idx", 0644, "");
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_set_format_option(a, "tar", "index", "bad.idx"));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_set_format_option(a, "tar", "index", "empty.idx"));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_set_format_option(a, "tar", "index", "missing.idx"));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+}
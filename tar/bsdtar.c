@@ -463,6 +463,9 @@ main(int argc, char **argv)
 				    "Failed to add %s to inclusion list",
 				    bsdtar->argument);
 			break;
+		case OPTION_INDEX:
+			bsdtar->index_file = bsdtar->argument;
+			break;
 		case 'j': /* GNU tar */
 			if (compression != '\0')
 				lafe_errc(1, 0,
@@ -969,6 +972,8 @@ main(int argc, char **argv)
 	}
 	if (cset_get_format(bsdtar->cset) != NULL)
 		only_mode(bsdtar, "--format", "cru");
+	if (bsdtar->index_file != NULL)
+		only_mode(bsdtar, "--index", "cxt");
 	if (bsdtar->symlink_mode != '\0') {
 		strcpy(buff, "-?");
 		buff[1] = bsdtar->symlink_mode;
@@ -63,6 +63,7 @@ struct bsdtar {
 	char		  mode; /* Program mode: 'c', 't', 'r', 'u', 'x' */
 	char		  symlink_mode; /* H or L, per BSD conventions */
 	const char	 *option_options; /* --options */
+	const char	 *index_file; /* --index */
 	char		  day_first; /* show day before month in -tv output */
 	struct creation_set *cset;
 
@@ -149,6 +150,7 @@ enum {
 	OPTION_HFS_COMPRESSION,
 	OPTION_IGNORE_ZEROS,
 	OPTION_INCLUDE,
+	OPTION_INDEX,
 	OPTION_KEEP_NEWER_FILES,
 	OPTION_LRZIP,
 	OPTION_LZ4,
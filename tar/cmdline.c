@@ -101,6 +101,7 @@ static const struct bsdtar_option {
 	{ "hfsCompression",       0, OPTION_HFS_COMPRESSION },
 	{ "ignore-zeros",         0, OPTION_IGNORE_ZEROS },
 	{ "include",              1, OPTION_INCLUDE },
+	{ "index",                1, OPTION_INDEX },
 	{ "insecure",             0, 'P' },
 	{ "interactive",          0, 'w' },
 	{ "keep-newer-files",     0, OPTION_KEEP_NEWER_FILES },
@@ -84,6 +84,7 @@ struct progress_data {
 };
 
 static void	read_archive(struct bsdtar *bsdtar, char mode, struct archive *);
+static int	use_index(struct bsdtar *, struct archive *, char **);
 static int unmatched_inclusions_warn(struct archive *matching, const char *);
 
 
@@ -152,6 +153,41 @@ progress_func(void *cookie)
 	}
 }
 
+/*
+ * With --index, the members named on the command line can be found
+ * through the tar index instead of by reading the archive from the
+ * start.  That selects the same members as the inclusion patterns only
+ * if every name is in the index and none of them is a directory whose
+ * contents would be selected too; probe the named members, and if any
+ * of them does not qualify, rewind and read the whole archive.
+ */
+static int
+use_index(struct bsdtar *bsdtar, struct archive *a, char **names)
+{
+	struct archive_entry *entry;
+	char **p;
+	int moved = 0;
+
+	if (*names == NULL || bsdtar->names_from_file != NULL)
+		return (0);
+	for (p = names; *p != NULL; p++) {
+		if (archive_read_tar_seek_entry(a, *p) != ARCHIVE_OK)
+			break;
+		moved = 1;
+		if (archive_read_next_header(a, &entry) < ARCHIVE_WARN)
+			break;
+		if (archive_entry_filetype(entry) == AE_IFDIR &&
+		    (bsdtar->flags & OPTFLAG_NO_SUBDIRS) == 0)
+			break;
+	}
+	if (*p == NULL)
+		return (1);
+	archive_clear_error(a);
+	if (moved && archive_read_tar_seek_entry(a, NULL) != ARCHIVE_OK)
+		lafe_errc(1, 0, "%s", archive_error_string(a));
+	return (0);
+}
+
 /*
  * Handle 'x' and 't' modes.
  */
@@ -163,8 +199,10 @@ read_archive(struct bsdtar *bsdtar, char mode, struct archive *writer)
 	struct archive		 *a;
 	struct archive_entry	 *entry;
 	const char		 *reader_options;
-	int			  r;
+	char			**names;
+	int			  indexed, r;
 
+	names = bsdtar->argv;
 	while (*bsdtar->argv) {
 		if (archive_match_include_pattern(bsdtar->matching,
 		    *bsdtar->argv) != ARCHIVE_OK)
@@ -211,6 +249,10 @@ read_archive(struct bsdtar *bsdtar, char mode, struct archive *writer)
 		if (archive_read_set_options(a,
 		    "read_concatenated_archives") != ARCHIVE_OK)
 			lafe_errc(1, 0, "%s", archive_error_string(a));
+	if (bsdtar->index_file != NULL &&
+	    archive_read_set_format_option(a, "tar", "index",
+	    bsdtar->index_file) != ARCHIVE_OK)
+		lafe_errc(1, 0, "--index: %s", archive_error_string(a));
 	if (bsdtar->passphrase != NULL)
 		r = archive_read_add_passphrase(a, bsdtar->passphrase);
 	else
@@ -249,6 +291,9 @@ read_archive(struct bsdtar *bsdtar, char mode, struct archive *writer)
 	}
 #endif
 
+	indexed = bsdtar->index_file != NULL &&
+	    use_index(bsdtar, a, names);
+
 	for (;;) {
 		/* Support --fast-read option */
 		const char *p;
@@ -256,6 +301,15 @@ read_archive(struct bsdtar *bsdtar, char mode, struct archive *writer)
 		    archive_match_path_unmatched_inclusions(bsdtar->matching) == 0)
 			break;
 
+		/* Support --index option: jump to the next named member. */
+		if (indexed) {
+			if (*names == NULL)
+				break;
+			if (archive_read_tar_seek_entry(a, *names++)
+			    != ARCHIVE_OK)
+				lafe_errc(1, 0, "%s", archive_error_string(a));
+		}
+
 		r = archive_read_next_header(a, &entry);
 		progress_data.entry = entry;
 		if (r == ARCHIVE_EOF)
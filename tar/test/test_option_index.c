@@ -0,0 +1,76 @@
+/*-
+ * Copyright (c) 2026 The libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+DEFINE_TEST(test_option_index)
+{
+	assertMakeDir("in", 0755);
+	assertMakeDir("in/d", 0755);
+	assertMakeFile("in/a", 0644, "a");
+	assertMakeFile("in/b", 0644, "b");
+	assertMakeFile("in/d/c", 0644, "c");
+
+	/* Create an archive and its index. */
+	assertEqualInt(0,
+	    systemf("%s -cf test.tar --index test.idx in >c.out 2>c.err",
+	    testprog));
+	assertEmptyFile("c.out");
+	assertEmptyFile("c.err");
+	assertFileExists("test.idx");
+
+	/* List members through the index, in the order they are named. */
+	assertEqualInt(0,
+	    systemf("%s -tf test.tar --index test.idx in/d/c in/a >t.out 2>t.err",
+	    testprog));
+	assertTextFileContents("in/d/c\nin/a\n", "t.out");
+	assertEmptyFile("t.err");
+
+	/* Extract through the index. */
+	assertMakeDir("x", 0755);
+	assertEqualInt(0,
+	    systemf("%s -xf test.tar -C x --index test.idx in/b >x.out 2>x.err",
+	    testprog));
+	assertFileContents("b", 1, "x/in/b");
+	assertFileNotExists("x/in/a");
+	assertEmptyFile("x.out");
+	assertEmptyFile("x.err");
+
+	/* A directory falls back to scanning the whole archive. */
+	assertEqualInt(0,
+	    systemf("%s -tf test.tar --index test.idx in/d >d.out 2>d.err",
+	    testprog));
+	assertTextFileContents("in/d/\nin/d/c\n", "d.out");
+	assertEmptyFile("d.err");
+
+	/* Names missing from the archive are still reported. */
+	assert(0 != systemf("%s -tf test.tar --index test.idx in/zz "
+	    ">m.out 2>m.err", testprog));
+	assertEmptyFile("m.out");
+	assertNonEmptyFile("m.err");
+
+	/* --index is rejected in other modes. */
+	assert(0 != systemf("%s -rf test.tar --index test.idx in/a "
+	    ">r.out 2>r.err", testprog));
+}
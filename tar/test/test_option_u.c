@@ -0,0 +1,61 @@
+/*-
+ * Copyright (c) 2026 The libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+DEFINE_TEST(test_option_u)
+{
+	assertMakeFile("f1", 0644, "f1");
+	assertMakeFile("f2", 0644, "f2");
+	assertUtimes("f1", 100000, 0, 100000, 0);
+	assertUtimes("f2", 100000, 0, 100000, 0);
+	assertEqualInt(0,
+	    systemf("%s -cf archive.tar f1 f2 >c.out 2>c.err", testprog));
+	assertEmptyFile("c.out");
+	assertEmptyFile("c.err");
+
+	/* Nothing has changed; nothing is appended. */
+	assertEqualInt(0,
+	    systemf("%s -uf archive.tar f1 f2 >u1.out 2>u1.err", testprog));
+	assertEmptyFile("u1.err");
+	assertEqualInt(0, systemf("%s -tf archive.tar >t1.out", testprog));
+	assertTextFileContents("f1\nf2\n", "t1.out");
+
+	/* A newer file is appended; older and equal ones are not. */
+	assertUtimes("f1", 100000, 0, 200000, 0);
+	assertUtimes("f2", 100000, 0, 50000, 0);
+	assertEqualInt(0,
+	    systemf("%s -uf archive.tar f1 f2 >u2.out 2>u2.err", testprog));
+	assertEmptyFile("u2.err");
+	assertEqualInt(0, systemf("%s -tf archive.tar >t2.out", testprog));
+	assertTextFileContents("f1\nf2\nf1\n", "t2.out");
+
+	/* The last copy of f1 in the archive is the one compared against. */
+	assertUtimes("f1", 100000, 0, 150000, 0);
+	assertEqualInt(0,
+	    systemf("%s -uf archive.tar f1 f2 >u3.out 2>u3.err", testprog));
+	assertEmptyFile("u3.err");
+	assertEqualInt(0, systemf("%s -tf archive.tar >t3.out", testprog));
+	assertTextFileContents("f1\nf2\nf1\n", "t3.out");
+}
@@ -81,21 +81,35 @@
 #define	O_BINARY 0
 #endif
 
+/*
+ * The pathnames and modification times of the members of an archive
+ * being updated with -u, hashed by pathname.
+ */
 struct archive_dir_entry {
 	struct archive_dir_entry	*next;
 	time_t			 mtime_sec;
-	int			 mtime_nsec;
+	long			 mtime_nsec;
+	unsigned		 hash;
 	char			*name;
 };
 
 struct archive_dir {
-	struct archive_dir_entry *head, *tail;
+	struct archive_dir_entry **buckets;
+	size_t			 nbuckets;
+	size_t			 count;
 };
 
+#define	ARCHIVE_DIR_MIN_BUCKETS	1024
+
 static int		 append_archive(struct bsdtar *, struct archive *,
 			     struct archive *ina);
 static int		 append_archive_filename(struct bsdtar *,
 			     struct archive *, const char *fname);
+static void		 archive_dir_add(struct archive_dir *,
+			     struct archive_entry *);
+static void		 archive_dir_free(struct archive_dir *);
+static int		 archive_dir_newer(struct archive_dir *,
+			     struct archive_entry *);
 static void		 archive_names_from_file(struct bsdtar *bsdtar,
 			     struct archive *a);
 static int		 copy_file_data_block(struct bsdtar *,
@@ -238,6 +252,10 @@ tar_mode_c(struct bsdtar *bsdtar)
 	}
 
 	set_writer_options(bsdtar, a);
+	if (bsdtar->index_file != NULL &&
+	    archive_write_set_format_option(a, NULL, "index",
+	    bsdtar->index_file) != ARCHIVE_OK)
+		lafe_errc(1, 0, "--index: %s", archive_error_string(a));
 	if (bsdtar->passphrase != NULL)
 		r = archive_write_set_passphrase(a, bsdtar->passphrase);
 	else
@@ -352,7 +370,6 @@ tar_mode_u(struct bsdtar *bsdtar)
 	struct archive		*a;
 	struct archive_entry	*entry;
 	int			 format;
-	struct archive_dir_entry	*p;
 	struct archive_dir	 archive_dir;
 
 	bsdtar->archive_dir = &archive_dir;
@@ -388,11 +405,7 @@ tar_mode_u(struct bsdtar *bsdtar)
 			lafe_errc(1, 0,
 			    "Cannot append to compressed archive.");
 		}
-		if (archive_match_exclude_entry(bsdtar->matching,
-		    ARCHIVE_MATCH_MTIME | ARCHIVE_MATCH_OLDER |
-		    ARCHIVE_MATCH_EQUAL, entry) != ARCHIVE_OK)
-			lafe_errc(1, 0, "Error : %s",
-			    archive_error_string(bsdtar->matching));
+		archive_dir_add(bsdtar->archive_dir, entry);
 		/* Record the last format determination we see */
 		format = archive_format(a);
 		/* Keep going until we hit end-of-archive */
@@ -421,13 +434,125 @@ tar_mode_u(struct bsdtar *bsdtar)
 	close(bsdtar->fd);
 	bsdtar->fd = -1;
 
-	while (bsdtar->archive_dir->head != NULL) {
-		p = bsdtar->archive_dir->head->next;
-		free(bsdtar->archive_dir->head->name);
-		free(bsdtar->archive_dir->head);
-		bsdtar->archive_dir->head = p;
+	archive_dir_free(bsdtar->archive_dir);
+	bsdtar->archive_dir = NULL;
+}
+
+static unsigned
+archive_dir_hash(const char *name)
+{
+	unsigned h = 2166136261U;
+
+	while (*name != '\0')
+		h = (h ^ (unsigned char)*name++) * 16777619U;
+	return (h);
+}
+
+static struct archive_dir_entry *
+archive_dir_lookup(struct archive_dir *dir, const char *name, unsigned hash)
+{
+	struct archive_dir_entry *p;
+
+	if (dir->nbuckets == 0)
+		return (NULL);
+	for (p = dir->buckets[hash & (dir->nbuckets - 1)]; p != NULL;
+	    p = p->next) {
+		if (p->hash == hash && strcmp(p->name, name) == 0)
+			return (p);
+	}
+	return (NULL);
+}
+
+/*
+ * Record the modification time of an archive member.  A later member
+ * with the same name supersedes an earlier one.
+ */
+static void
+archive_dir_add(struct archive_dir *dir, struct archive_entry *entry)
+{
+	struct archive_dir_entry **buckets, *p, *next;
+	const char *name;
+	size_t i, len, n;
+	unsigned hash;
+
+	name = archive_entry_pathname(entry);
+	if (name == NULL)
+		return;
+	hash = archive_dir_hash(name);
+	p = archive_dir_lookup(dir, name, hash);
+	if (p == NULL) {
+		if (dir->count >= dir->nbuckets) {
+			/* Keep the load factor at or below one. */
+			n = dir->nbuckets * 2;
+			if (n < ARCHIVE_DIR_MIN_BUCKETS)
+				n = ARCHIVE_DIR_MIN_BUCKETS;
+			buckets = calloc(n, sizeof(*buckets));
+			if (buckets == NULL)
+				lafe_errc(1, ENOMEM, "Out of memory");
+			for (i = 0; i < dir->nbuckets; i++) {
+				for (p = dir->buckets[i]; p != NULL; p = next) {
+					next = p->next;
+					p->next = buckets[p->hash & (n - 1)];
+					buckets[p->hash & (n - 1)] = p;
+				}
+			}
+			free(dir->buckets);
+			dir->buckets = buckets;
+			dir->nbuckets = n;
+		}
+		len = strlen(name);
+		p = malloc(sizeof(*p) + len + 1);
+		if (p == NULL)
+			lafe_errc(1, ENOMEM, "Out of memory");
+		p->name = (char *)(p + 1);
+		memcpy(p->name, name, len + 1);
+		p->hash = hash;
+		p->next = dir->buckets[hash & (dir->nbuckets - 1)];
+		dir->buckets[hash & (dir->nbuckets - 1)] = p;
+		dir->count++;
+	}
+	p->mtime_sec = archive_entry_mtime(entry);
+	p->mtime_nsec = archive_entry_mtime_nsec(entry);
+}
+
+/*
+ * Return non-zero unless the archive already holds a member of the
+ * same name that is at least as new as `entry'.
+ */
+static int
+archive_dir_newer(struct archive_dir *dir, struct archive_entry *entry)
+{
+	struct archive_dir_entry *p;
+	const char *name;
+	time_t sec;
+
+	name = archive_entry_pathname(entry);
+	if (name == NULL)
+		return (1);
+	p = archive_dir_lookup(dir, name, archive_dir_hash(name));
+	if (p == NULL)
+		return (1);
+	sec = archive_entry_mtime(entry);
+	if (sec != p->mtime_sec)
+		return (sec > p->mtime_sec);
+	return (archive_entry_mtime_nsec(entry) > p->mtime_nsec);
+}
+
+static void
+archive_dir_free(struct archive_dir *dir)
+{
+	struct archive_dir_entry *p, *next;
+	size_t i;
+
+	for (i = 0; i < dir->nbuckets; i++) {
+		for (p = dir->buckets[i]; p != NULL; p = next) {
+			next = p->next;
+			free(p);
+		}
 	}
-	bsdtar->archive_dir->tail = NULL;
+	free(dir->buckets);
+	dir->buckets = NULL;
+	dir->nbuckets = dir->count = 0;
 }
 
 
@@ -693,6 +818,9 @@ append_archive(struct bsdtar *bsdtar, struct archive *a, struct archive *ina)
 	while (ARCHIVE_OK == (e = archive_read_next_header(ina, &in_entry))) {
 		if (archive_match_excluded(bsdtar->matching, in_entry))
 			continue;
+		if (bsdtar->archive_dir != NULL &&
+		    !archive_dir_newer(bsdtar->archive_dir, in_entry))
+			continue;
 		if(edit_pathname(bsdtar, in_entry))
 			continue;
 		if ((bsdtar->flags & OPTFLAG_INTERACTIVE) &&
@@ -829,6 +957,13 @@ metadata_filter(struct archive *a, void *_data, struct archive_entry *entry)
 {
 	struct bsdtar *bsdtar = (struct bsdtar *)_data;
 
+	/* With -u, skip files that are no newer than the archived copy. */
+	if (bsdtar->archive_dir != NULL &&
+	    !archive_dir_newer(bsdtar->archive_dir, entry)) {
+		excluded_callback(a, _data, entry);
+		return (0);
+	}
+
 	/* XXX TODO: check whether this filesystem is
 	 * synthetic and/or local.  Add a new
 	 * --local-only option to skip non-local